@@ -1,7 +1,13 @@
 // bluedot.cpp
 // Copyright Laurence Emms 2017
 
+#include <algorithm>
+#include <cctype>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
 #include <string>
 #include <fstream>
 #include <boost/filesystem.hpp>
@@ -16,23 +22,46 @@
 
 #include "../generator/alphablendop.h"
 #include "../generator/alphatocolorop.h"
+#include "../generator/blurop.h"
+#include "../generator/boxblurop.h"
+#include "../generator/colorrampop.h"
 #include "../generator/colortoalphaop.h"
+#include "../generator/copyop.h"
+#include "../generator/distancetransformop.h"
+#include "../generator/equalizeop.h"
+#include "../generator/execution.h"
+#include "../generator/expressionop.h"
 #include "../generator/fbmop.h"
 #include "../generator/fillop.h"
 #include "../generator/gradientop.h"
 #include "../generator/greaterthanop.h"
+#include "../generator/laplacianop.h"
 #include "../generator/lessthanop.h"
+#include "../generator/loadlayerop.h"
 #include "../generator/maddop.h"
 #include "../generator/multiplyop.h"
 #include "../generator/noiseop.h"
 #include "../generator/normalizeop.h"
+#include "../generator/output.h"
+#include "../generator/percentilenormalizeop.h"
+#include "../generator/savelayerop.h"
+#include "../generator/sobelop.h"
 #include "../generator/swapop.h"
 #include "../generator/generator.h"
+#include "emitter.h"
 
 namespace po = boost::program_options;
 namespace pt = boost::property_tree;
 namespace fs = boost::filesystem;
 
+// A rectangle of the map, whose columns wrap around the seam when x + width passes the width of the map
+struct Region {
+    size_t x;
+    size_t y;
+    size_t width;
+    size_t height;
+};
+
 auto parse_properties(pt::ptree& property_tree, size_t& width, size_t& height, size_t& seed) -> bool
 {
     try
@@ -100,8 +129,45 @@ auto parse_properties(pt::ptree& property_tree, size_t& width, size_t& height, s
     return true;
 }
 
-template <typename Real>
-auto create_layers(pt::ptree& property_tree, bluedot::Generator<Real>& generator, size_t width, size_t height) -> bool
+// Whether an operator sets every sample of a layer without reading it
+auto overwrites(const pt::ptree::value_type& v, const std::string& name) -> bool
+{
+    std::string type{v.second.get<std::string>("type", "")};
+    bool overwrites{type == "FillOperator" || type == "NoiseOperator" || type == "FBMOperator" || type == "LoadLayerOperator"};
+    if (type == "CopyOperator")
+        return !v.second.get_optional<std::string>("mask") && v.second.get<std::string>("layer0", "") == name && v.second.get<std::string>("layer1", "") != name;
+    return overwrites && !v.second.get_optional<std::string>("mask") && v.second.get<std::string>("layer", "") == name;
+}
+
+// Whether the first operator to use a layer overwrites every sample of it without reading it,
+// in which case the layer does not need to be zeroed when it is created
+auto overwritten_before_read(pt::ptree& property_tree, const std::string& name) -> bool
+{
+    boost::optional<pt::ptree&> pt_operators = property_tree.get_child_optional("map.operators");
+    if (!pt_operators)
+        return false;
+    BOOST_FOREACH(pt::ptree::value_type &v, *pt_operators)
+    {
+        bool uses_layer{false};
+        for (const char* key : {"layer", "layer0", "layer1", "mask"})
+        {
+            boost::optional<std::string> pt_layer = v.second.get_optional<std::string>(key);
+            if (pt_layer && *pt_layer == name)
+                uses_layer = true;
+        }
+        // Expressions may name any layer, so any mention of the name counts as a use
+        if (v.second.get<std::string>("expression", "").find(name) != std::string::npos)
+            uses_layer = true;
+        if (!uses_layer)
+            continue;
+        return overwrites(v, name);
+    }
+    return false;
+}
+
+// Layers are created in the generator when rendering, or declared in the emitter when emitting C++, and reported to log
+template <typename Target>
+auto create_layers(pt::ptree& property_tree, Target& generator, size_t width, size_t height, std::ostream& log) -> bool
 {
     bool base_layer_found = false;
     try
@@ -132,6 +198,19 @@ auto create_layers(pt::ptree& property_tree, bluedot::Generator<Real>& generator
                 continue;
             }
 
+            // Masks hold a single weight per sample, as a bit or a byte
+            boost::optional<std::string> pt_format = v.second.get_optional<std::string>("format");
+            if (pt_format && (*pt_format == "Bit" || *pt_format == "Byte"))
+            {
+                generator.create_mask(name, width, height, *pt_format == "Bit" ? bluedot::MaskFormat::bit : bluedot::MaskFormat::byte);
+                log << "Created " << *pt_format << " mask " << name << ".\n";
+                continue;
+            }
+            else if (pt_format && *pt_format != "Real")
+            {
+                std::cerr << "Unknown layer format " << *pt_format << ", defaulting to Real.\n";
+            }
+
             try
             {
                 size_t pt_channels = v.second.get<size_t>("channels");
@@ -147,8 +226,9 @@ auto create_layers(pt::ptree& property_tree, bluedot::Generator<Real>& generator
                 std::cerr << "Unable to read channels in configuration file, defaulting to " << channels << ".\n";
                 std::cerr << e.what() << "\n";
             }
-            generator.create_layer(name, width, height, channels);
-            std::cout << "Created layer " << name << " with " << channels << " channels.\n";
+            bluedot::Allocator allocator{64, true, !overwritten_before_read(property_tree, name)};
+            generator.create_layer(name, width, height, channels, allocator);
+            log << "Created layer " << name << " with " << channels << " channels.\n";
         }
     }
     catch (pt::ptree_bad_path& e)
@@ -178,28 +258,35 @@ auto create_layers(pt::ptree& property_tree, bluedot::Generator<Real>& generator
     return true;
 }
 
-template <typename Real>
-auto apply_unary_operator(const std::string& type, pt::ptree::value_type &v, bluedot::Generator<Real>& generator, bluedot::UnaryOperator<Real>& unary_operator) -> bool
+auto read_operator_layer(pt::ptree::value_type &v, const std::string& key, std::string& layer) -> bool
 {
-    // read layer
-    std::string layer;
     try
     {
-        std::string pt_layer = v.second.get<std::string>("layer");
+        std::string pt_layer = v.second.get<std::string>(key);
         layer = pt_layer;
     }
     catch (pt::ptree_bad_path& e)
     {
-        std::cerr << "Unable to find operator layer in configuration file.\n";
+        std::cerr << "Unable to find operator " << key << " in configuration file.\n";
         std::cerr << e.what() << "\n";
         return false;
     }
     catch (pt::ptree_bad_data& e)
     {
-        std::cerr << "Unable to read operator layer in configuration file.\n";
+        std::cerr << "Unable to read operator " << key << " in configuration file.\n";
         std::cerr << e.what() << "\n";
         return false;
     }
+    return true;
+}
+
+template <typename Real>
+auto apply_unary_operator(const std::string& type, pt::ptree::value_type &v, bluedot::Generator<Real>& generator, bluedot::UnaryOperator<Real>& unary_operator, std::ostream& log) -> bool
+{
+    // read layer
+    std::string layer;
+    if (!read_operator_layer(v, "layer", layer))
+        return false;
 
     // search for mask
     boost::optional<std::string> pt_mask{v.second.get_optional<std::string>("mask")};
@@ -213,223 +300,809 @@ auto apply_unary_operator(const std::string& type, pt::ptree::value_type &v, blu
         result = generator.apply_unary_operator(layer, unary_operator);
     }
 
-    std::cout << "Applied " << type << " operator to layer " << layer << "\n";
+    log << "Applied " << type << " operator to layer " << layer << "\n";
     return result;
 }
 
 template <typename Real>
-auto apply_binary_operator(const std::string& type, pt::ptree::value_type &v, bluedot::Generator<Real>& generator, bluedot::BinaryOperator<Real>& binary_operator) -> bool
+auto apply_binary_operator(const std::string& type, pt::ptree::value_type &v, bluedot::Generator<Real>& generator, bluedot::BinaryOperator<Real>& binary_operator, std::ostream& log) -> bool
 {
     // read layers
     std::string layer0;
-    try
+    if (!read_operator_layer(v, "layer0", layer0))
+        return false;
+
+    std::string layer1;
+    if (!read_operator_layer(v, "layer1", layer1))
+        return false;
+
+    // search for mask
+    boost::optional<std::string> pt_mask{v.second.get_optional<std::string>("mask")};
+    bool result{true};
+    if (pt_mask)
     {
-        std::string pt_layer0 = v.second.get<std::string>("layer0");
-        layer0 = pt_layer0;
+        result = generator.apply_binary_operator(layer0, layer1, binary_operator, *pt_mask);
     }
-    catch (pt::ptree_bad_path& e)
+    else
     {
-        std::cerr << "Unable to find operator layer0 in configuration file.\n";
-        std::cerr << e.what() << "\n";
-        return false;
+        result = generator.apply_binary_operator(layer0, layer1, binary_operator);
     }
-    catch (pt::ptree_bad_data& e)
+
+    log << "Applied " << type << " operator to layers " << layer0 << " and " << layer1 << "\n";
+    return result;
+}
+
+// Threshold operators write a mask when an output is given, otherwise they change the layer in place
+template <typename Real>
+auto apply_threshold_operator(const std::string& type, pt::ptree::value_type &v, bluedot::Generator<Real>& generator, bluedot::UnaryOperator<Real>& unary_operator, bluedot::MaskOperator<Real>& mask_operator,
+                              std::ostream& log) -> bool
+{
+    boost::optional<std::string> pt_output{v.second.get_optional<std::string>("output")};
+    if (!pt_output)
     {
-        std::cerr << "Unable to read operator layer0 in configuration file.\n";
-        std::cerr << e.what() << "\n";
-        return false;
+        return apply_unary_operator(type, v, generator, unary_operator, log);
     }
 
-    std::string layer1;
-    try
+    boost::optional<std::string> pt_layer{v.second.get_optional<std::string>("layer")};
+    if (!pt_layer)
     {
-        std::string pt_layer1 = v.second.get<std::string>("layer1");
-        layer1 = pt_layer1;
+        std::cerr << "Unable to find operator layer in configuration file.\n";
+        return false;
     }
-    catch (pt::ptree_bad_path& e)
+
+    bool result{generator.apply_mask_operator(*pt_layer, mask_operator, *pt_output)};
+    log << "Applied " << type << " operator to layer " << *pt_layer << " writing mask " << *pt_output << "\n";
+    return result;
+}
+
+auto parse_region(const std::string& text, size_t width, size_t height, Region& region) -> bool
+{
+    std::istringstream in{text};
+    char separators[3]{};
+    in >> region.x >> separators[0] >> region.y >> separators[1] >> region.width >> separators[2] >> region.height;
+    if (!in || separators[0] != ',' || separators[1] != ',' || separators[2] != ',')
     {
-        std::cerr << "Unable to find operator layer1 in configuration file.\n";
-        std::cerr << e.what() << "\n";
+        std::cerr << "Unable to read region " << text << ", expected x0,y0,w,h.\n";
         return false;
     }
-    catch (pt::ptree_bad_data& e)
+    if (region.width == 0 || region.height == 0 || region.x + region.width > width || region.y + region.height > height)
     {
-        std::cerr << "Unable to read operator layer1 in configuration file.\n";
-        std::cerr << e.what() << "\n";
+        std::cerr << "Region " << text << " does not fit in the " << width << " by " << height << " map.\n";
         return false;
     }
+    return true;
+}
 
-    // search for mask
+// A generator to render with, and the stream its progress is reported to,
+// so renders running side by side each keep their own messages
+template <typename Real>
+struct Rendering {
+    bluedot::Generator<Real>& generator;
+    std::ostream& log;
+};
+
+// Operators are built from their arguments and applied when rendering,
+// and written out as source with the same arguments when emitting C++
+template <typename Operator, typename Real, typename... Args>
+auto apply_unary(const std::string& type, pt::ptree::value_type &v, Rendering<Real>& rendering, Args&... args) -> bool
+{
+    Operator unary_operator{args...};
+    return apply_unary_operator(type, v, rendering.generator, unary_operator, rendering.log);
+}
+
+template <typename Operator, typename Real, typename... Args>
+auto apply_unary(const std::string& type, pt::ptree::value_type &v, bluedot::Emitter<Real>& emitter, Args&... args) -> bool
+{
+    std::string layer;
+    if (!read_operator_layer(v, "layer", layer))
+        return false;
     boost::optional<std::string> pt_mask{v.second.get_optional<std::string>("mask")};
-    bool result{true};
-    if (pt_mask)
-    {
-        result = generator.apply_binary_operator(layer0, layer1, binary_operator, *pt_mask);
-    }
-    else
+    bool result{emitter.template emit_unary_operator<Operator>(type, layer, pt_mask ? *pt_mask : "", args...)};
+    std::cout << "Emitted " << type << " operator on layer " << layer << "\n";
+    return result;
+}
+
+template <typename Operator, typename Real, typename... Args>
+auto apply_binary(const std::string& type, pt::ptree::value_type &v, Rendering<Real>& rendering, Args&... args) -> bool
+{
+    Operator binary_operator{args...};
+    return apply_binary_operator(type, v, rendering.generator, binary_operator, rendering.log);
+}
+
+template <typename Operator, typename Real, typename... Args>
+auto apply_binary(const std::string& type, pt::ptree::value_type &v, bluedot::Emitter<Real>& emitter, Args&... args) -> bool
+{
+    std::string layer0;
+    if (!read_operator_layer(v, "layer0", layer0))
+        return false;
+    std::string layer1;
+    if (!read_operator_layer(v, "layer1", layer1))
+        return false;
+    boost::optional<std::string> pt_mask{v.second.get_optional<std::string>("mask")};
+    bool result{emitter.template emit_binary_operator<Operator>(type, layer0, layer1, pt_mask ? *pt_mask : "", args...)};
+    std::cout << "Emitted " << type << " operator on layers " << layer0 << " and " << layer1 << "\n";
+    return result;
+}
+
+template <typename Operator, typename Real, typename... Args>
+auto apply_threshold(const std::string& type, pt::ptree::value_type &v, Rendering<Real>& rendering, Args&... args) -> bool
+{
+    Operator threshold_operator{args...};
+    return apply_threshold_operator(type, v, rendering.generator, threshold_operator, threshold_operator, rendering.log);
+}
+
+template <typename Operator, typename Real, typename... Args>
+auto apply_threshold(const std::string& type, pt::ptree::value_type &v, bluedot::Emitter<Real>& emitter, Args&... args) -> bool
+{
+    boost::optional<std::string> pt_output{v.second.get_optional<std::string>("output")};
+    if (!pt_output)
     {
-        result = generator.apply_binary_operator(layer0, layer1, binary_operator);
+        return apply_unary<Operator>(type, v, emitter, args...);
     }
 
-    std::cout << "Applied " << type << " operator to layers " << layer0 << " and " << layer1 << "\n";
+    std::string layer;
+    if (!read_operator_layer(v, "layer", layer))
+        return false;
+    bool result{emitter.template emit_mask_operator<Operator>(type, layer, *pt_output, args...)};
+    std::cout << "Emitted " << type << " operator on layer " << layer << " writing mask " << *pt_output << "\n";
     return result;
 }
 
-enum Format
+template <typename Real>
+auto apply_expression(const std::string& type, pt::ptree::value_type &v, Rendering<Real>& rendering, const std::string& expression) -> bool
 {
-    FormatReal, FormatChar, FormatPercent
-};
+    bluedot::ExpressionOperator<Real> expression_operator{expression};
+    if (!expression_operator.valid())
+    {
+        std::cerr << "Unable to compile expression: " << expression_operator.error() << "\n";
+        return false;
+    }
+
+    boost::optional<std::string> pt_mask{v.second.get_optional<std::string>("mask")};
+    bool result{rendering.generator.apply_nary_operator(expression_operator.layers(), expression_operator, pt_mask ? *pt_mask : "")};
+    rendering.log << "Applied " << type << " operator to layers";
+    for (const std::string& layer : expression_operator.layers())
+    {
+        rendering.log << " " << layer;
+    }
+    rendering.log << "\n";
+    return result;
+}
 
 template <typename Real>
-auto parse_multiplier_scale_and_offset(pt::ptree::value_type &v, std::vector<Real>& multiplier, Real& scale, Real& offset) -> void
+auto apply_expression(const std::string& type, pt::ptree::value_type &v, bluedot::Emitter<Real>& emitter, const std::string& expression) -> bool
 {
-    multiplier.clear();
-    Format format{FormatReal};
-    boost::optional<std::string> pt_format = v.second.get_optional<std::string>("multiplier.format");
-    if (pt_format)
+    // Compile the formula here as well, so errors show up before the generated source is built
+    bluedot::Expression<Real> compiled{expression};
+    if (!compiled.valid())
     {
-        if (*pt_format == "Real")
-        {
-            format = FormatReal;
-        }
-        else if (*pt_format == "Char")
-        {
-            format = FormatChar;
-        }
-        else if (*pt_format == "Percent")
-        {
-            format = FormatPercent;
-        }
-        else
-        {
-            std::cerr << "Unknown multiplier format.\n";
-        }
+        std::cerr << "Unable to compile expression: " << compiled.error() << "\n";
+        return false;
     }
 
-    boost::optional<Real> pt_a = v.second.get_optional<Real>("multiplier.a");
-    if (pt_a)
+    boost::optional<std::string> pt_mask{v.second.get_optional<std::string>("mask")};
+    bool result{emitter.template emit_nary_operator<bluedot::ExpressionOperator<Real>>(type, compiled.layers(), pt_mask ? *pt_mask : "", expression)};
+    std::cout << "Emitted " << type << " operator on layers";
+    for (const std::string& layer : compiled.layers())
     {
-        if (format == FormatReal)
-        {
-            multiplier.push_back(*pt_a);
-        }
-        else if (format == FormatChar)
-        {
-            multiplier.push_back(*pt_a / static_cast<Real>(256));
-        }
-        else if (format == FormatPercent)
-        {
-            multiplier.push_back(*pt_a / static_cast<Real>(100));
-        }
+        std::cout << " " << layer;
     }
-    else
-        multiplier.push_back(static_cast<Real>(1.0));
+    std::cout << "\n";
+    return result;
+}
 
-    boost::optional<Real> pt_r = v.second.get_optional<Real>("multiplier.r");
-    if (pt_r)
+// Collects how far the operators read around each sample, so that a region of the map can be rendered
+// on layers covering the region and the halo the operators need around it
+class Planner {
+public:
+    auto add(const bluedot::Footprint& footprint) -> void
     {
-        if (format == FormatReal)
-        {
-            multiplier.push_back(*pt_r);
-        }
-        else if (format == FormatChar)
-        {
-            multiplier.push_back(*pt_r / static_cast<Real>(256));
-        }
-        else if (format == FormatPercent)
-        {
-            multiplier.push_back(*pt_r / static_cast<Real>(100));
-        }
+        // Stencils are applied one after another, so their radii add up
+        _radius += footprint.radius;
+        _clamped = _clamped || (footprint.radius > 0 && !footprint.spherical);
+        _whole = _whole || footprint.whole;
     }
-    else
-        multiplier.push_back(static_cast<Real>(1.0));
 
-    boost::optional<Real> pt_g = v.second.get_optional<Real>("multiplier.g");
-    if (pt_g)
+    // The part of the map the layers must cover to render the region exactly.
+    // Samples the operators compute wrongly at the edges of the layers stay within the halo,
+    // except for the edges of the map, where the layers end as the map does.
+    auto crop(const Region& region, size_t width, size_t height) const -> Region
     {
-        if (format == FormatReal)
-        {
-            multiplier.push_back(*pt_g);
-        }
-        else if (format == FormatChar)
+        if (_whole)
+            return Region{0, 0, width, height};
+        const size_t top{region.y > _radius ? region.y - _radius : 0};
+        const size_t bottom{std::min(height, region.y + region.height + _radius)};
+        Region crop{0, top, width, bottom - top};
+        if (region.width + 2 * _radius >= width)
+            return crop;
+        if (region.x >= _radius && region.x + region.width + _radius <= width)
         {
-            multiplier.push_back(*pt_g / static_cast<Real>(256));
+            crop.x = region.x - _radius;
+            crop.width = region.width + 2 * _radius;
         }
-        else if (format == FormatPercent)
+        else if (!_clamped)
         {
-            multiplier.push_back(*pt_g / static_cast<Real>(100));
+            // The halo wraps around the seam, which only stencils wrapping in x agree with
+            crop.x = (region.x + width - _radius) % width;
+            crop.width = region.width + 2 * _radius;
         }
+        return crop;
     }
-    else
-        multiplier.push_back(static_cast<Real>(1.0));
 
-    boost::optional<Real> pt_b = v.second.get_optional<Real>("multiplier.b");
-    if (pt_b)
+    auto whole() const -> bool
     {
-        if (format == FormatReal)
-        {
-            multiplier.push_back(*pt_b);
-        }
-        else if (format == FormatChar)
-        {
-            multiplier.push_back(*pt_b / static_cast<Real>(256));
-        }
-        else if (format == FormatPercent)
-        {
-            multiplier.push_back(*pt_b / static_cast<Real>(100));
-        }
+        return _whole;
     }
-    else
-        multiplier.push_back(static_cast<Real>(1.0));
 
-    boost::optional<Real> pt_scale = v.second.get_optional<Real>("scale");
-    if (pt_scale)
-        scale = *pt_scale;
+    // Plans for the operators of another configuration as well, as for the points of a sweep rendered on the same layers
+    auto merge(const Planner& planner) -> void
+    {
+        _radius = std::max(_radius, planner._radius);
+        _clamped = _clamped || planner._clamped;
+        _whole = _whole || planner._whole;
+    }
+private:
+    size_t _radius{0};
+    bool _clamped{false};
+    bool _whole{false};
+};
 
-    boost::optional<Real> pt_offset = v.second.get_optional<Real>("offset");
-    if (pt_offset)
-        offset = *pt_offset;
+template <typename Operator, typename... Args>
+auto apply_unary(const std::string&, pt::ptree::value_type&, Planner& planner, Args&... args) -> bool
+{
+    Operator unary_operator{args...};
+    planner.add(unary_operator.footprint());
+    return true;
+}
+
+template <typename Operator, typename... Args>
+auto apply_binary(const std::string&, pt::ptree::value_type&, Planner& planner, Args&... args) -> bool
+{
+    Operator binary_operator{args...};
+    planner.add(binary_operator.footprint());
+    return true;
+}
+
+template <typename Operator, typename... Args>
+auto apply_threshold(const std::string& type, pt::ptree::value_type &v, Planner& planner, Args&... args) -> bool
+{
+    return apply_unary<Operator>(type, v, planner, args...);
 }
 
+// Expressions only read the samples they write
 template <typename Real>
-auto parse_level(pt::ptree::value_type &v, std::vector<Real>& level) -> void
+auto apply_expression(const std::string&, pt::ptree::value_type&, Planner&, const std::string&) -> bool
 {
-    level.clear();
+    return true;
+}
 
-    Format format{FormatReal};
-    boost::optional<std::string> pt_format = v.second.get_optional<std::string>("level.format");
-    if (pt_format)
+// Follows an edited rectangle of a layer through the operators, to find the part of each layer that changes.
+// A layer an operator writes changes wherever the layers it reads do, grown by the radius of its stencil,
+// and operators reading whole layers spread any change over the whole map.
+// Changes are kept as bounds in map coordinates, which may run past the seam in x.
+class DirtyRegions {
+public:
+    DirtyRegions(const std::string& layer, const Region& edit) : _layer(layer),
+        _edit{static_cast<int64_t>(edit.x), static_cast<int64_t>(edit.y), static_cast<int64_t>(edit.x + edit.width), static_cast<int64_t>(edit.y + edit.height)}
     {
-        if (*pt_format == "Real")
-        {
-            format = FormatReal;
-        }
-        else if (*pt_format == "Char")
+        _dirty[_layer] = _edit;
+    }
+
+    // layers lists the layers an expression names, which it may read and write
+    auto add(const pt::ptree::value_type& v, const bluedot::Footprint& footprint, const std::vector<std::string>& layers = {}) -> void
+    {
+        const std::string type{v.second.get<std::string>("type", "")};
+        std::vector<std::string> read{layers};
+        std::vector<std::string> written{layers};
+        for (const char* key : {"layer", "layer0", "layer1", "mask"})
         {
-            format = FormatChar;
+            boost::optional<std::string> pt_layer{v.second.get_optional<std::string>(key)};
+            if (pt_layer && !overwrites(v, *pt_layer))
+                read.push_back(*pt_layer);
         }
-        else if (*pt_format == "Percent")
+        // Thresholds with an output write a mask rather than their layer
+        boost::optional<std::string> pt_output{v.second.get_optional<std::string>("output")};
+        if (pt_output)
         {
-            format = FormatPercent;
+            written.push_back(*pt_output);
+            if (v.second.get_optional<std::string>("mask"))
+                read.push_back(*pt_output);
         }
         else
         {
-            std::cerr << "Unknown level format.\n";
+            for (const char* key : {"layer", "layer0"})
+            {
+                boost::optional<std::string> pt_layer{v.second.get_optional<std::string>(key)};
+                if (pt_layer)
+                    written.push_back(*pt_layer);
+            }
+            if (type == "SwapOperator")
+                written.push_back(v.second.get<std::string>("layer1", ""));
         }
-    }
 
-    boost::optional<Real> pt_a = v.second.get_optional<Real>("level.a");
-    if (pt_a)
-    {
-        if (format == FormatReal)
+        Bounds changed{};
+        for (const std::string& layer : read)
         {
-            level.push_back(*pt_a);
+            changed = merge(changed, bounds(layer));
         }
-        else if (format == FormatChar)
+        if (!empty(changed))
         {
-            level.push_back(*pt_a / static_cast<Real>(256));
+            _whole = _whole || footprint.whole;
+            const int64_t radius{static_cast<int64_t>(footprint.radius)};
+            changed = Bounds{changed.x0 - radius, changed.y0 - radius, changed.x1 + radius, changed.y1 + radius};
         }
-        else if (format == FormatPercent)
+        // The edit is in the samples the layer is loaded from
+        if (type == "LoadLayerOperator" && v.second.get<std::string>("layer", "") == _layer)
+            changed = merge(changed, _edit);
+        for (const std::string& layer : written)
+        {
+            _dirty[layer] = changed;
+        }
+    }
+
+    // Whether an operator reading whole layers read a change, which changes every sample it writes
+    auto whole() const -> bool
+    {
+        return _whole;
+    }
+
+    // Adds the changes the operators of another configuration make, as for the points of a sweep rendered on the same layers
+    auto merge(const DirtyRegions& dirty) -> void
+    {
+        _whole = _whole || dirty._whole;
+        for (const auto& l : dirty._dirty)
+        {
+            _dirty[l.first] = merge(bounds(l.first), l.second);
+        }
+    }
+
+    // The part of the width by height map covering the changes to any of the layers, fails if none of them changes
+    auto region(const std::vector<std::string>& layers, size_t width, size_t height, Region& region) const -> bool
+    {
+        Bounds changed{};
+        for (const std::string& layer : layers)
+        {
+            changed = merge(changed, bounds(layer));
+        }
+        const int64_t top{std::max<int64_t>(changed.y0, 0)};
+        const int64_t bottom{std::min<int64_t>(changed.y1, static_cast<int64_t>(height))};
+        if (empty(changed) || top >= bottom)
+            return false;
+        const int64_t columns{changed.x1 - changed.x0};
+        region.y = static_cast<size_t>(top);
+        region.height = static_cast<size_t>(bottom - top);
+        region.x = columns >= static_cast<int64_t>(width) ? 0 : static_cast<size_t>((changed.x0 % static_cast<int64_t>(width) + static_cast<int64_t>(width)) % static_cast<int64_t>(width));
+        region.width = std::min(static_cast<size_t>(columns), width);
+        return true;
+    }
+private:
+    // Columns x0 to x1 and rows y0 to y1, excluding x1 and y1
+    struct Bounds {
+        int64_t x0;
+        int64_t y0;
+        int64_t x1;
+        int64_t y1;
+    };
+
+    static auto empty(const Bounds& bounds) -> bool
+    {
+        return bounds.x0 >= bounds.x1 || bounds.y0 >= bounds.y1;
+    }
+
+    static auto merge(const Bounds& a, const Bounds& b) -> Bounds
+    {
+        if (empty(a))
+            return b;
+        if (empty(b))
+            return a;
+        return Bounds{std::min(a.x0, b.x0), std::min(a.y0, b.y0), std::max(a.x1, b.x1), std::max(a.y1, b.y1)};
+    }
+
+    auto bounds(const std::string& layer) const -> Bounds
+    {
+        auto l = _dirty.find(layer);
+        return l != _dirty.end() ? l->second : Bounds{};
+    }
+
+    std::string _layer;
+    Bounds _edit;
+    std::map<std::string, Bounds> _dirty;
+    bool _whole{false};
+};
+
+template <typename Operator, typename... Args>
+auto apply_unary(const std::string&, pt::ptree::value_type &v, DirtyRegions& dirty, Args&... args) -> bool
+{
+    Operator unary_operator{args...};
+    dirty.add(v, unary_operator.footprint());
+    return true;
+}
+
+template <typename Operator, typename... Args>
+auto apply_binary(const std::string&, pt::ptree::value_type &v, DirtyRegions& dirty, Args&... args) -> bool
+{
+    Operator binary_operator{args...};
+    dirty.add(v, binary_operator.footprint());
+    return true;
+}
+
+template <typename Operator, typename... Args>
+auto apply_threshold(const std::string& type, pt::ptree::value_type &v, DirtyRegions& dirty, Args&... args) -> bool
+{
+    return apply_unary<Operator>(type, v, dirty, args...);
+}
+
+// Expressions only read the samples they write
+template <typename Real>
+auto apply_expression(const std::string&, pt::ptree::value_type &v, DirtyRegions& dirty, const std::string& expression) -> bool
+{
+    bluedot::Expression<Real> compiled{expression};
+    dirty.add(v, bluedot::Footprint{0, true, false}, compiled.layers());
+    return true;
+}
+
+// Works out which channels of each layer are read after each operator, so that operators can skip the others.
+// Operators are recorded in configuration order, then the live channels are found walking back from the outputs.
+class Liveness {
+public:
+    Liveness(const bluedot::Generator<float>& generator) : _generator(generator)
+    {
+    }
+
+    // Called before each operator is recorded, so that steps line up with operators that record nothing
+    auto start(size_t index) -> void
+    {
+        _steps.resize(index + 1);
+    }
+
+    auto add_unary(pt::ptree::value_type &v, const bluedot::UnaryOperator<float>& op) -> void
+    {
+        const std::string layer{v.second.get<std::string>("layer", "")};
+        const bluedot::Layer<float>* l{_generator.layer(layer)};
+        if (!l || _steps.empty())
+            return;
+        Step& step{_steps.back()};
+        step.layer = layer;
+        step.writes = op.writes(l->channels());
+        step.mask = v.second.get<std::string>("mask", "");
+        step.reads.push_back(read(layer, l->channels(), [&op](const std::vector<bool>& needed) { return op.reads(needed); }));
+    }
+
+    auto add_binary(pt::ptree::value_type &v, const bluedot::BinaryOperator<float>& op) -> void
+    {
+        const std::string layer0{v.second.get<std::string>("layer0", "")};
+        const std::string layer1{v.second.get<std::string>("layer1", "")};
+        const bluedot::Layer<float>* l0{_generator.layer(layer0)};
+        const bluedot::Layer<float>* l1{_generator.layer(layer1)};
+        if (!l0 || !l1 || _steps.empty())
+            return;
+        if (op.writes_layer1())
+        {
+            add_whole({layer0, layer1});
+            return;
+        }
+        Step& step{_steps.back()};
+        step.layer = layer0;
+        step.writes = op.writes(l0->channels());
+        step.mask = v.second.get<std::string>("mask", "");
+        step.reads.push_back(read(layer0, l0->channels(), [&op](const std::vector<bool>& needed) { return op.reads0(needed); }));
+        step.reads.push_back(read(layer1, l0->channels(), [&op](const std::vector<bool>& needed) { return op.reads1(needed); }));
+    }
+
+    // Operators that read only the first channel of a layer and whose writes are not tracked
+    auto add_first(const std::string& layer) -> void
+    {
+        if (_steps.empty())
+            return;
+        const bluedot::Layer<float>* l{_generator.layer(layer)};
+        if (l)
+            _steps.back().reads.push_back(Read{layer, bluedot::channel_range(l->channels(), 0, 1), {}});
+    }
+
+    // Operators that read every channel of the layers they name and whose writes are not tracked
+    auto add_whole(const std::vector<std::string>& layers) -> void
+    {
+        if (_steps.empty())
+            return;
+        for (const std::string& layer : layers)
+        {
+            const bluedot::Layer<float>* l{_generator.layer(layer)};
+            if (l)
+                _steps.back().reads.push_back(Read{layer, std::vector<bool>(l->channels(), true), {}});
+        }
+    }
+
+    // Live channels of the layer each operator writes, given the channels of each layer read at the end
+    auto solve(std::map<std::string, std::vector<bool>> live) -> std::vector<std::map<std::string, std::vector<bool>>>
+    {
+        std::vector<std::map<std::string, std::vector<bool>>> plan(_steps.size());
+        _written = 0;
+        _skipped = 0;
+        for (size_t i{_steps.size()}; i-- > 0;)
+        {
+            const Step& step{_steps[i]};
+            std::vector<bool> needed;
+            if (!step.layer.empty())
+            {
+                std::vector<bool>& after{channels(live, step.layer)};
+                plan[i][step.layer] = after;
+                needed.resize(after.size());
+                for (size_t c{0}; c < after.size(); ++c)
+                {
+                    const bool writes{c < step.writes.size() && step.writes[c]};
+                    needed[c] = writes && after[c];
+                    _written += writes ? 1 : 0;
+                    _skipped += writes && !after[c] ? 1 : 0;
+                    // Masked operators blend into the channels they write, so they read them as well
+                    after[c] = writes ? needed[c] && !step.mask.empty() : after[c];
+                }
+            }
+            for (const Read& read : step.reads)
+            {
+                std::vector<bool>& before{channels(live, read.layer)};
+                for (size_t c{0}; c < before.size(); ++c)
+                {
+                    bool reads{c < read.always.size() && read.always[c]};
+                    for (size_t n{0}; n < needed.size() && n < read.each.size(); ++n)
+                    {
+                        reads = reads || (needed[n] && c < read.each[n].size() && read.each[n][c]);
+                    }
+                    before[c] = before[c] || reads;
+                }
+            }
+            // Layers used as masks are read through their first channel
+            if (!step.mask.empty() && _generator.layer(step.mask))
+            {
+                channels(live, step.mask)[0] = true;
+            }
+        }
+        return plan;
+    }
+
+    // Channels the operators write, and those of them that nothing reads later
+    auto written() const -> size_t
+    {
+        return _written;
+    }
+
+    auto skipped() const -> size_t
+    {
+        return _skipped;
+    }
+private:
+    // Channels read from a layer whatever is needed, and to compute each channel of the written layer
+    struct Read {
+        std::string layer;
+        std::vector<bool> always;
+        std::vector<std::vector<bool>> each;
+    };
+
+    struct Step {
+        // Layer the operator writes, or empty if it writes none that is tracked
+        std::string layer;
+        std::vector<bool> writes;
+        std::string mask;
+        std::vector<Read> reads;
+    };
+
+    template <typename Reads>
+    auto read(const std::string& layer, size_t channels, Reads reads) const -> Read
+    {
+        Read read{layer, reads(std::vector<bool>(channels, false)), {}};
+        for (size_t c{0}; c < channels; ++c)
+        {
+            read.each.push_back(reads(bluedot::channel_range(channels, c, c + 1)));
+        }
+        return read;
+    }
+
+    auto channels(std::map<std::string, std::vector<bool>>& live, const std::string& layer) const -> std::vector<bool>&
+    {
+        std::vector<bool>& channels{live[layer]};
+        const bluedot::Layer<float>* l{_generator.layer(layer)};
+        channels.resize(l ? l->channels() : 1, false);
+        return channels;
+    }
+
+    const bluedot::Generator<float>& _generator;
+    std::vector<Step> _steps;
+    size_t _written{0};
+    size_t _skipped{0};
+};
+
+template <typename Operator, typename... Args>
+auto apply_unary(const std::string&, pt::ptree::value_type &v, Liveness& liveness, Args&... args) -> bool
+{
+    Operator unary_operator{args...};
+    liveness.add_unary(v, unary_operator);
+    return true;
+}
+
+template <typename Operator, typename... Args>
+auto apply_binary(const std::string&, pt::ptree::value_type &v, Liveness& liveness, Args&... args) -> bool
+{
+    Operator binary_operator{args...};
+    liveness.add_binary(v, binary_operator);
+    return true;
+}
+
+// Thresholds writing a mask only compare the first channel of the layer with the first level
+template <typename Operator, typename... Args>
+auto apply_threshold(const std::string& type, pt::ptree::value_type &v, Liveness& liveness, Args&... args) -> bool
+{
+    if (!v.second.get_optional<std::string>("output"))
+        return apply_unary<Operator>(type, v, liveness, args...);
+    liveness.add_first(v.second.get<std::string>("layer", ""));
+    return true;
+}
+
+// Expressions are taken to read every channel of the layers they name
+template <typename Real>
+auto apply_expression(const std::string&, pt::ptree::value_type &v, Liveness& liveness, const std::string& expression) -> bool
+{
+    bluedot::Expression<Real> compiled{expression};
+    liveness.add_whole(compiled.layers());
+    boost::optional<std::string> pt_mask{v.second.get_optional<std::string>("mask")};
+    if (pt_mask)
+        liveness.add_whole({*pt_mask});
+    return true;
+}
+
+enum Format
+{
+    FormatReal, FormatChar, FormatPercent
+};
+
+template <typename Real>
+auto parse_multiplier_scale_and_offset(pt::ptree::value_type &v, std::vector<Real>& multiplier, Real& scale, Real& offset) -> void
+{
+    multiplier.clear();
+    Format format{FormatReal};
+    boost::optional<std::string> pt_format = v.second.get_optional<std::string>("multiplier.format");
+    if (pt_format)
+    {
+        if (*pt_format == "Real")
+        {
+            format = FormatReal;
+        }
+        else if (*pt_format == "Char")
+        {
+            format = FormatChar;
+        }
+        else if (*pt_format == "Percent")
+        {
+            format = FormatPercent;
+        }
+        else
+        {
+            std::cerr << "Unknown multiplier format.\n";
+        }
+    }
+
+    boost::optional<Real> pt_a = v.second.get_optional<Real>("multiplier.a");
+    if (pt_a)
+    {
+        if (format == FormatReal)
+        {
+            multiplier.push_back(*pt_a);
+        }
+        else if (format == FormatChar)
+        {
+            multiplier.push_back(*pt_a / static_cast<Real>(256));
+        }
+        else if (format == FormatPercent)
+        {
+            multiplier.push_back(*pt_a / static_cast<Real>(100));
+        }
+    }
+    else
+        multiplier.push_back(static_cast<Real>(1.0));
+
+    boost::optional<Real> pt_r = v.second.get_optional<Real>("multiplier.r");
+    if (pt_r)
+    {
+        if (format == FormatReal)
+        {
+            multiplier.push_back(*pt_r);
+        }
+        else if (format == FormatChar)
+        {
+            multiplier.push_back(*pt_r / static_cast<Real>(256));
+        }
+        else if (format == FormatPercent)
+        {
+            multiplier.push_back(*pt_r / static_cast<Real>(100));
+        }
+    }
+    else
+        multiplier.push_back(static_cast<Real>(1.0));
+
+    boost::optional<Real> pt_g = v.second.get_optional<Real>("multiplier.g");
+    if (pt_g)
+    {
+        if (format == FormatReal)
+        {
+            multiplier.push_back(*pt_g);
+        }
+        else if (format == FormatChar)
+        {
+            multiplier.push_back(*pt_g / static_cast<Real>(256));
+        }
+        else if (format == FormatPercent)
+        {
+            multiplier.push_back(*pt_g / static_cast<Real>(100));
+        }
+    }
+    else
+        multiplier.push_back(static_cast<Real>(1.0));
+
+    boost::optional<Real> pt_b = v.second.get_optional<Real>("multiplier.b");
+    if (pt_b)
+    {
+        if (format == FormatReal)
+        {
+            multiplier.push_back(*pt_b);
+        }
+        else if (format == FormatChar)
+        {
+            multiplier.push_back(*pt_b / static_cast<Real>(256));
+        }
+        else if (format == FormatPercent)
+        {
+            multiplier.push_back(*pt_b / static_cast<Real>(100));
+        }
+    }
+    else
+        multiplier.push_back(static_cast<Real>(1.0));
+
+    boost::optional<Real> pt_scale = v.second.get_optional<Real>("scale");
+    if (pt_scale)
+        scale = *pt_scale;
+
+    boost::optional<Real> pt_offset = v.second.get_optional<Real>("offset");
+    if (pt_offset)
+        offset = *pt_offset;
+}
+
+template <typename Real>
+auto parse_level(pt::ptree::value_type &v, std::vector<Real>& level) -> void
+{
+    level.clear();
+
+    Format format{FormatReal};
+    boost::optional<std::string> pt_format = v.second.get_optional<std::string>("level.format");
+    if (pt_format)
+    {
+        if (*pt_format == "Real")
+        {
+            format = FormatReal;
+        }
+        else if (*pt_format == "Char")
+        {
+            format = FormatChar;
+        }
+        else if (*pt_format == "Percent")
+        {
+            format = FormatPercent;
+        }
+        else
+        {
+            std::cerr << "Unknown level format.\n";
+        }
+    }
+
+    boost::optional<Real> pt_a = v.second.get_optional<Real>("level.a");
+    if (pt_a)
+    {
+        if (format == FormatReal)
+        {
+            level.push_back(*pt_a);
+        }
+        else if (format == FormatChar)
+        {
+            level.push_back(*pt_a / static_cast<Real>(256));
+        }
+        else if (format == FormatPercent)
         {
             level.push_back(*pt_a / static_cast<Real>(100));
         }
@@ -488,25 +1161,119 @@ auto parse_level(pt::ptree::value_type &v, std::vector<Real>& level) -> void
         }
         else if (format == FormatPercent)
         {
-            level.push_back(*pt_b / static_cast<Real>(100));
+            level.push_back(*pt_b / static_cast<Real>(100));
+        }
+    }
+    else
+        level.push_back(static_cast<Real>(0.0));
+}
+
+template <typename Real>
+auto parse_color(const pt::ptree& node, std::vector<Real>& color) -> void
+{
+    color.clear();
+    Format format{FormatReal};
+    boost::optional<std::string> pt_format = node.get_optional<std::string>("format");
+    if (pt_format)
+    {
+        if (*pt_format == "Real")
+        {
+            format = FormatReal;
+        }
+        else if (*pt_format == "Char")
+        {
+            format = FormatChar;
+        }
+        else if (*pt_format == "Percent")
+        {
+            format = FormatPercent;
+        }
+        else
+        {
+            std::cerr << "Unknown color format.\n";
+        }
+    }
+
+    for (const char* channel : {"a", "r", "g", "b"})
+    {
+        Real value{node.get<Real>(channel, static_cast<Real>(0.0))};
+        if (format == FormatChar)
+        {
+            value /= static_cast<Real>(256);
+        }
+        else if (format == FormatPercent)
+        {
+            value /= static_cast<Real>(100);
+        }
+        color.push_back(value);
+    }
+}
+
+template <typename Real>
+auto parse_stops(pt::ptree::value_type &v, std::vector<Real>& positions, std::vector<std::vector<Real>>& colors) -> bool
+{
+    positions.clear();
+    colors.clear();
+    boost::optional<pt::ptree&> pt_stops = v.second.get_child_optional("stops");
+    if (!pt_stops)
+    {
+        std::cerr << "Unable to find stops in configuration file.\n";
+        return false;
+    }
+    BOOST_FOREACH(pt::ptree::value_type &stop, *pt_stops)
+    {
+        boost::optional<Real> pt_position = stop.second.get_optional<Real>("position");
+        if (!pt_position)
+        {
+            std::cerr << "Unable to find stop position in configuration file.\n";
+            return false;
         }
+        std::vector<Real> color;
+        parse_color(stop.second, color);
+        positions.push_back(*pt_position);
+        colors.push_back(color);
     }
-    else
-        level.push_back(static_cast<Real>(0.0));
+    return !positions.empty();
 }
 
-template <typename Real>
-auto apply_operators(pt::ptree& property_tree, bluedot::Generator<Real>& generator, size_t seed) -> bool
+auto parse_spherical(pt::ptree::value_type &v, bool& spherical) -> void
+{
+    boost::optional<bool> pt_spherical = v.second.get_optional<bool>("spherical");
+    if (pt_spherical)
+        spherical = *pt_spherical;
+}
+
+using random_generator_type = boost::variate_generator<boost::mt19937, boost::uniform_real<>>;
+
+// Random numbers the operators of a configuration draw from, with the given seed
+auto random_numbers(size_t seed) -> random_generator_type
 {
-    using generator_type = boost::variate_generator<boost::mt19937, boost::uniform_real<>>;
-    boost::mt19937 rng{seed};
+    boost::mt19937 rng{static_cast<uint32_t>(seed)};
     boost::uniform_real<> range{-1.0, 1.0};
-    generator_type random_number_generator{rng, range};
+    return random_generator_type{rng, range};
+}
+
+// Applies the operators from index begin up to end, drawing from random_number_generator where the operators before begin left it
+// window places the layers within the map, for the operators that depend on where a sample is in the map
+// starting is called with the index of each operator before it is read, and applied once it has run
+template <typename Real, typename Target>
+auto apply_operators(pt::ptree& property_tree, Target& generator, random_generator_type& random_number_generator, const bluedot::Window& window,
+                     size_t begin, size_t end, const std::function<void(size_t)>& starting = nullptr, const std::function<void(size_t)>& applied = nullptr) -> bool
+{
+    using generator_type = random_generator_type;
 
     try
     {
+        size_t index{0};
         BOOST_FOREACH(pt::ptree::value_type &v, property_tree.get_child("map.operators"))
         {
+            const size_t operator_index{index++};
+            if (operator_index < begin || operator_index >= end)
+                continue;
+            if (starting)
+            {
+                starting(operator_index);
+            }
             std::string type;
             try
             {
@@ -535,8 +1302,7 @@ auto apply_operators(pt::ptree& property_tree, bluedot::Generator<Real>& generat
 
                 parse_multiplier_scale_and_offset(v, multiplier, scale, offset);
 
-                bluedot::AlphaBlendOperator<Real> alpha_blend_operator{multiplier, scale, offset};
-                result = apply_binary_operator(type, v, generator, alpha_blend_operator);
+                result = apply_binary<bluedot::AlphaBlendOperator<Real>>(type, v, generator, multiplier, scale, offset);
             }
             else if (type == "AlphaToColorOperator")
             {
@@ -546,8 +1312,88 @@ auto apply_operators(pt::ptree& property_tree, bluedot::Generator<Real>& generat
 
                 parse_multiplier_scale_and_offset(v, multiplier, scale, offset);
 
-                bluedot::AlphaToColorOperator<Real> alpha_to_color_operator{multiplier, scale, offset};
-                result = apply_unary_operator(type, v, generator, alpha_to_color_operator);
+                result = apply_unary<bluedot::AlphaToColorOperator<Real>>(type, v, generator, multiplier, scale, offset);
+            }
+            else if (type == "BlurOperator")
+            {
+                size_t radius{1};
+                std::vector<Real> multiplier;
+                Real scale{static_cast<Real>(1.0)};
+                Real offset{static_cast<Real>(0.0)};
+                bool spherical{true};
+
+                boost::optional<size_t> pt_radius = v.second.get_optional<size_t>("radius");
+                if (pt_radius)
+                    radius = *pt_radius;
+
+                Real sigma{std::max(static_cast<Real>(radius) / static_cast<Real>(2.0), static_cast<Real>(0.5))};
+                boost::optional<Real> pt_sigma = v.second.get_optional<Real>("sigma");
+                if (pt_sigma)
+                    sigma = *pt_sigma;
+
+                parse_multiplier_scale_and_offset(v, multiplier, scale, offset);
+                parse_spherical(v, spherical);
+
+                result = apply_unary<bluedot::BlurOperator<Real>>(type, v, generator, radius, sigma, multiplier, scale, offset, spherical);
+            }
+            else if (type == "BoxBlurOperator")
+            {
+                size_t radius{1};
+                size_t passes{1};
+                std::vector<Real> multiplier;
+                Real scale{static_cast<Real>(1.0)};
+                Real offset{static_cast<Real>(0.0)};
+                bool spherical{true};
+
+                boost::optional<size_t> pt_radius = v.second.get_optional<size_t>("radius");
+                if (pt_radius)
+                    radius = *pt_radius;
+
+                boost::optional<Real> pt_sigma = v.second.get_optional<Real>("sigma");
+                if (pt_sigma)
+                    passes = 3;
+
+                boost::optional<size_t> pt_passes = v.second.get_optional<size_t>("passes");
+                if (pt_passes)
+                    passes = std::max(static_cast<size_t>(1), *pt_passes);
+
+                parse_multiplier_scale_and_offset(v, multiplier, scale, offset);
+                parse_spherical(v, spherical);
+
+                std::vector<size_t> radii(passes, radius);
+                if (pt_sigma)
+                    radii = bluedot::BoxFilter<Real>::gaussian_radii(*pt_sigma, passes);
+
+                result = apply_unary<bluedot::BoxBlurOperator<Real>>(type, v, generator, radii, multiplier, scale, offset, spherical);
+            }
+            else if (type == "ColorRampOperator")
+            {
+                std::vector<Real> positions;
+                std::vector<std::vector<Real>> colors;
+                size_t channel{0};
+                bool alpha{false};
+                size_t resolution{1024};
+
+                boost::optional<size_t> pt_channel = v.second.get_optional<size_t>("channel");
+                if (pt_channel)
+                    channel = *pt_channel;
+
+                boost::optional<bool> pt_alpha = v.second.get_optional<bool>("alpha");
+                if (pt_alpha)
+                    alpha = *pt_alpha;
+
+                boost::optional<size_t> pt_resolution = v.second.get_optional<size_t>("resolution");
+                if (pt_resolution)
+                    resolution = *pt_resolution;
+
+                if (parse_stops(v, positions, colors))
+                {
+                    result = apply_unary<bluedot::ColorRampOperator<Real>>(type, v, generator, positions, colors, channel, alpha, resolution);
+                }
+                else
+                {
+                    result = false;
+                }
             }
             else if (type == "ColorToAlphaOperator")
             {
@@ -557,8 +1403,48 @@ auto apply_operators(pt::ptree& property_tree, bluedot::Generator<Real>& generat
 
                 parse_multiplier_scale_and_offset(v, multiplier, scale, offset);
 
-                bluedot::ColorToAlphaOperator<Real> color_to_alpha_operator{multiplier, scale, offset};
-                result = apply_unary_operator(type, v, generator, color_to_alpha_operator);
+                result = apply_unary<bluedot::ColorToAlphaOperator<Real>>(type, v, generator, multiplier, scale, offset);
+            }
+            else if (type == "CopyOperator")
+            {
+                result = apply_binary<bluedot::CopyOperator<Real>>(type, v, generator);
+            }
+            else if (type == "DistanceTransformOperator")
+            {
+                size_t channel{0};
+                Real level{static_cast<Real>(0.0)};
+                std::vector<Real> multiplier;
+                Real scale{static_cast<Real>(1.0)};
+                Real offset{static_cast<Real>(0.0)};
+                bool spherical{true};
+
+                boost::optional<size_t> pt_channel = v.second.get_optional<size_t>("channel");
+                if (pt_channel)
+                    channel = *pt_channel;
+
+                boost::optional<Real> pt_level = v.second.get_optional<Real>("level");
+                if (pt_level)
+                    level = *pt_level;
+
+                parse_multiplier_scale_and_offset(v, multiplier, scale, offset);
+                parse_spherical(v, spherical);
+
+                result = apply_unary<bluedot::DistanceTransformOperator<Real>>(type, v, generator, channel, level, multiplier, scale, offset, spherical);
+            }
+            else if (type == "EqualizeOperator")
+            {
+                size_t bins{4096};
+
+                boost::optional<size_t> pt_bins = v.second.get_optional<size_t>("bins");
+                if (pt_bins)
+                    bins = *pt_bins;
+
+                result = apply_unary<bluedot::EqualizeOperator<Real>>(type, v, generator, bins);
+            }
+            else if (type == "ExpressionOperator")
+            {
+                std::string expression{v.second.get<std::string>("expression", "")};
+                result = apply_expression<Real>(type, v, generator, expression);
             }
             else if (type == "FBMOperator")
             {
@@ -567,6 +1453,7 @@ auto apply_operators(pt::ptree& property_tree, bluedot::Generator<Real>& generat
                 std::vector<Real> multiplier;
                 Real scale{static_cast<Real>(1.0)};
                 Real offset{static_cast<Real>(0.0)};
+                bool spherical{true};
 
                 boost::optional<size_t> pt_octaves = v.second.get_optional<size_t>("octaves");
                 if (pt_octaves)
@@ -577,141 +1464,653 @@ auto apply_operators(pt::ptree& property_tree, bluedot::Generator<Real>& generat
                     exponent = *pt_exponent;
 
                 parse_multiplier_scale_and_offset(v, multiplier, scale, offset);
+                parse_spherical(v, spherical);
+
+                result = apply_unary<bluedot::FBMOperator<Real, generator_type>>(type, v, generator, random_number_generator, octaves, exponent, multiplier, scale, offset, spherical, window);
+            }
+            else if (type == "FillOperator")
+            {
+                std::vector<Real> multiplier;
+                Real scale{static_cast<Real>(1.0)};
+                Real offset{static_cast<Real>(0.0)};
+
+                parse_multiplier_scale_and_offset(v, multiplier, scale, offset);
+
+                result = apply_unary<bluedot::FillOperator<Real>>(type, v, generator, multiplier, scale, offset);
+            }
+            else if (type == "GradientOperator")
+            {
+                std::vector<Real> multiplier;
+                Real scale{static_cast<Real>(1.0)};
+                Real offset{static_cast<Real>(0.0)};
+
+                bool spherical{true};
+
+                parse_multiplier_scale_and_offset(v, multiplier, scale, offset);
+                parse_spherical(v, spherical);
+
+                result = apply_unary<bluedot::GradientOperator<Real>>(type, v, generator, multiplier, scale, offset, spherical);
+            }
+            else if (type == "GreaterThanOperator")
+            {
+                std::vector<Real> level{static_cast<Real>(0.0), static_cast<Real>(0.0), static_cast<Real>(0.0), static_cast<Real>(0.0)};
+
+                parse_level(v, level);
+
+                bool clamp{false};
+                boost::optional<std::string> pt_mode = v.second.get_optional<std::string>("mode");
+                if (pt_mode)
+                {
+                    if (*pt_mode == "Clamp")
+                    {
+                        clamp = true;
+                    }
+                }
+
+                result = apply_threshold<bluedot::GreaterThanOperator<Real>>(type, v, generator, level, clamp);
+            }
+            else if (type == "LaplacianOperator")
+            {
+                std::vector<Real> multiplier;
+                Real scale{static_cast<Real>(1.0)};
+                Real offset{static_cast<Real>(0.0)};
+                bool spherical{true};
+
+                parse_multiplier_scale_and_offset(v, multiplier, scale, offset);
+                parse_spherical(v, spherical);
+
+                result = apply_unary<bluedot::LaplacianOperator<Real>>(type, v, generator, multiplier, scale, offset, spherical);
+            }
+            else if (type == "LessThanOperator")
+            {
+                std::vector<Real> level{static_cast<Real>(0.0), static_cast<Real>(0.0), static_cast<Real>(0.0), static_cast<Real>(0.0)};
+
+                parse_level(v, level);
+
+                bool clamp{false};
+                boost::optional<std::string> pt_mode = v.second.get_optional<std::string>("mode");
+                if (pt_mode)
+                {
+                    if (*pt_mode == "Clamp")
+                    {
+                        clamp = true;
+                    }
+                }
+
+                result = apply_threshold<bluedot::LessThanOperator<Real>>(type, v, generator, level, clamp);
+            }
+            else if (type == "LoadLayerOperator")
+            {
+                std::string file{v.second.get<std::string>("file", "")};
+                result = apply_unary<bluedot::LoadLayerOperator<Real>>(type, v, generator, file, window);
+            }
+            else if (type == "MADDOperator")
+            {
+                std::vector<Real> multiplier;
+                Real scale{static_cast<Real>(1.0)};
+                Real offset{static_cast<Real>(0.0)};
+
+                parse_multiplier_scale_and_offset(v, multiplier, scale, offset);
+
+                result = apply_unary<bluedot::MADDOperator<Real>>(type, v, generator, multiplier, scale, offset);
+            }
+            else if (type == "MultiplyOperator")
+            {
+                std::vector<Real> multiplier;
+                Real scale{static_cast<Real>(1.0)};
+                Real offset{static_cast<Real>(0.0)};
+
+                parse_multiplier_scale_and_offset(v, multiplier, scale, offset);
+
+                result = apply_binary<bluedot::MultiplyOperator<Real>>(type, v, generator, multiplier, scale, offset);
+            }
+            else if (type == "NoiseOperator")
+            {
+                std::vector<Real> multiplier;
+                Real scale{static_cast<Real>(1.0)};
+                Real offset{static_cast<Real>(0.0)};
+
+                parse_multiplier_scale_and_offset(v, multiplier, scale, offset);
+
+                result = apply_unary<bluedot::NoiseOperator<Real, generator_type>>(type, v, generator, random_number_generator, multiplier, scale, offset, window);
+            }
+            else if (type == "NormalizeOperator")
+            {
+                result = apply_unary<bluedot::NormalizeOperator<Real>>(type, v, generator);
+            }
+            else if (type == "PercentileNormalizeOperator")
+            {
+                Real low{static_cast<Real>(0.01)};
+                Real high{static_cast<Real>(0.99)};
+                size_t bins{4096};
+
+                boost::optional<Real> pt_low = v.second.get_optional<Real>("low");
+                if (pt_low)
+                    low = *pt_low;
+
+                boost::optional<Real> pt_high = v.second.get_optional<Real>("high");
+                if (pt_high)
+                    high = *pt_high;
+
+                boost::optional<size_t> pt_bins = v.second.get_optional<size_t>("bins");
+                if (pt_bins)
+                    bins = *pt_bins;
+
+                result = apply_unary<bluedot::PercentileNormalizeOperator<Real>>(type, v, generator, low, high, bins);
+            }
+            else if (type == "SaveLayerOperator")
+            {
+                std::string file{v.second.get<std::string>("file", "")};
+                result = apply_unary<bluedot::SaveLayerOperator<Real>>(type, v, generator, file);
+            }
+            else if (type == "SobelOperator")
+            {
+                std::vector<Real> multiplier;
+                Real scale{static_cast<Real>(1.0)};
+                Real offset{static_cast<Real>(0.0)};
+                bool spherical{true};
+
+                parse_multiplier_scale_and_offset(v, multiplier, scale, offset);
+                parse_spherical(v, spherical);
+
+                result = apply_unary<bluedot::SobelOperator<Real>>(type, v, generator, multiplier, scale, offset, spherical);
+            }
+            else if (type == "SwapOperator")
+            {
+                result = apply_binary<bluedot::SwapOperator<Real>>(type, v, generator);
+            }
+            else
+            {
+                std::cerr << "Unknown operator type: " << type << "\n";
+                result = false;
+            }
+            if (!result)
+            {
+                std::cerr << "Failed to apply operator of type: " << type << "\n";
+            }
+            if (applied)
+            {
+                applied(operator_index);
+            }
+        }
+    }
+    catch (pt::ptree_bad_path& e)
+    {
+        std::cerr << "Unable to find operators in configuration file.\n";
+        std::cerr << e.what() << "\n";
+        return false;
+    }
+    catch (pt::ptree_bad_data& e)
+    {
+        std::cerr << "Unable to read operators in configuration file.\n";
+        std::cerr << e.what() << "\n";
+        return false;
+    }
+    catch (...)
+    {
+        std::cerr << "Unhandled exception when reading operators in configuration file.\n";
+        return false;
+    }
+    return true;
+}
+
+template <typename Real, typename Target>
+auto apply_operators(pt::ptree& property_tree, Target& generator, size_t seed, const bluedot::Window& window,
+                     const std::function<void(size_t)>& starting = nullptr, const std::function<void(size_t)>& applied = nullptr) -> bool
+{
+    random_generator_type random_number_generator{random_numbers(seed)};
+    return apply_operators<Real>(property_tree, generator, random_number_generator, window, 0, std::numeric_limits<size_t>::max(), starting, applied);
+}
+
+// A layer to write to a file after the operators, with the channels to write, or every channel when none are listed
+struct Output {
+    std::string file;
+    std::string layer;
+    std::vector<size_t> channels;
+    bluedot::OutputFormat format;
+};
+
+// Channels are listed by name, a, r, g and b, or by number, separated by commas
+auto parse_channels(const std::string& text, std::vector<size_t>& channels) -> bool
+{
+    channels.clear();
+    std::istringstream in{text};
+    std::string name;
+    while (std::getline(in, name, ','))
+    {
+        name.erase(std::remove_if(name.begin(), name.end(), [](char c) { return std::isspace(static_cast<unsigned char>(c)); }), name.end());
+        const std::string names{"argb"};
+        if (name.size() == 1 && names.find(name[0]) != std::string::npos)
+        {
+            channels.push_back(names.find(name[0]));
+        }
+        else if (!name.empty() && std::all_of(name.begin(), name.end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)); }))
+        {
+            channels.push_back(std::stoul(name));
+        }
+        else
+        {
+            std::cerr << "Unknown output channel " << name << ".\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+auto parse_outputs(pt::ptree& property_tree, std::vector<Output>& outputs) -> bool
+{
+    outputs.clear();
+    boost::optional<pt::ptree&> pt_outputs = property_tree.get_child_optional("map.outputs");
+    if (!pt_outputs)
+        return true;
+    BOOST_FOREACH(pt::ptree::value_type &v, *pt_outputs)
+    {
+        boost::optional<std::string> pt_file = v.second.get_optional<std::string>("file");
+        boost::optional<std::string> pt_layer = v.second.get_optional<std::string>("layer");
+        if (!pt_file || !pt_layer)
+        {
+            std::cerr << "Unable to find output file and layer in configuration file.\n";
+            return false;
+        }
+
+        Output output{*pt_file, *pt_layer, {}, bluedot::OutputFormat::eight_bit};
+        boost::optional<std::string> pt_format = v.second.get_optional<std::string>("format");
+        if (pt_format)
+        {
+            if (*pt_format == "Real")
+            {
+                output.format = bluedot::OutputFormat::real;
+            }
+            else if (*pt_format == "Short")
+            {
+                output.format = bluedot::OutputFormat::sixteen_bit;
+            }
+            else if (*pt_format != "Char")
+            {
+                std::cerr << "Unknown output format " << *pt_format << ".\n";
+                return false;
+            }
+        }
+
+        boost::optional<std::string> pt_channels = v.second.get_optional<std::string>("channels");
+        if (pt_channels && !parse_channels(*pt_channels, output.channels))
+        {
+            return false;
+        }
+        outputs.push_back(output);
+    }
+    return true;
+}
 
-                bluedot::FBMOperator<Real, generator_type> fbm_operator{random_number_generator, octaves, exponent, multiplier, scale, offset};
-                result = apply_unary_operator(type, v, generator, fbm_operator);
+// Index of the last operator naming each layer, after which the layer no longer changes
+template <typename Real>
+auto last_operators(pt::ptree& property_tree) -> std::map<std::string, size_t>
+{
+    std::map<std::string, size_t> last;
+    boost::optional<pt::ptree&> pt_operators = property_tree.get_child_optional("map.operators");
+    if (!pt_operators)
+        return last;
+    size_t index{0};
+    BOOST_FOREACH(pt::ptree::value_type &v, *pt_operators)
+    {
+        for (const char* key : {"layer", "layer0", "layer1"})
+        {
+            boost::optional<std::string> pt_layer{v.second.get_optional<std::string>(key)};
+            if (pt_layer)
+                last[*pt_layer] = index;
+        }
+        if (v.second.get<std::string>("type", "") == "ExpressionOperator")
+        {
+            bluedot::Expression<Real> expression{v.second.get<std::string>("expression", "")};
+            for (const std::string& layer : expression.layers())
+            {
+                last[layer] = index;
             }
-            else if (type == "FillOperator")
+        }
+        ++index;
+    }
+    return last;
+}
+
+// Indices of the operators that use each layer, in configuration order
+template <typename Real>
+auto layer_uses(pt::ptree& property_tree) -> std::map<std::string, std::vector<size_t>>
+{
+    std::map<std::string, std::vector<size_t>> uses;
+    boost::optional<pt::ptree&> pt_operators = property_tree.get_child_optional("map.operators");
+    if (!pt_operators)
+        return uses;
+    size_t index{0};
+    BOOST_FOREACH(pt::ptree::value_type &v, *pt_operators)
+    {
+        std::vector<std::string> layers;
+        for (const char* key : {"layer", "layer0", "layer1", "mask", "output"})
+        {
+            boost::optional<std::string> pt_layer{v.second.get_optional<std::string>(key)};
+            if (pt_layer)
+                layers.push_back(*pt_layer);
+        }
+        if (v.second.get<std::string>("type", "") == "ExpressionOperator")
+        {
+            bluedot::Expression<Real> expression{v.second.get<std::string>("expression", "")};
+            for (const std::string& layer : expression.layers())
             {
-                std::vector<Real> multiplier;
-                Real scale{static_cast<Real>(1.0)};
-                Real offset{static_cast<Real>(0.0)};
+                layers.push_back(layer);
+            }
+        }
+        for (const std::string& layer : layers)
+        {
+            std::vector<size_t>& indices{uses[layer]};
+            if (indices.empty() || indices.back() != index)
+                indices.push_back(index);
+        }
+        ++index;
+    }
+    return uses;
+}
 
-                parse_multiplier_scale_and_offset(v, multiplier, scale, offset);
+// Renders the configuration with a seed, writing the output file and the outputs.
+// Everything that does not depend on the seed is worked out once, so that the seeds of an ensemble share it.
+class Render {
+public:
+    // Live channels of the layers after each operator
+    using Plan = std::vector<std::map<std::string, std::vector<bool>>>;
+
+    // patch: write the region over the files of a previous render of the whole map, rather than as files of its own
+    Render(pt::ptree& property_tree, const Region& region, const Region& crop, const bluedot::Window& window, size_t offset_x, size_t offset_y,
+           size_t idle, size_t bits, bool patch = false) :
+        _property_tree(property_tree), _region(region), _crop(crop), _window(window), _offset_x(offset_x), _offset_y(offset_y), _idle(idle), _bits(bits),
+        _patch(patch), _last(last_operators<float>(property_tree)), _uses(layer_uses<float>(property_tree))
+    {
+    }
 
-                bluedot::FillOperator<Real> fill_operator{multiplier, scale, offset};
-                result = apply_unary_operator(type, v, generator, fill_operator);
-            }
-            else if (type == "GradientOperator")
-            {
-                std::vector<Real> multiplier;
-                Real scale{static_cast<Real>(1.0)};
-                Real offset{static_cast<Real>(0.0)};
+    // Returns the exit status, and reports progress to log
+    auto operator()(size_t seed, const std::vector<Output>& outputs, const std::string& output_file, std::ostream& log) const -> int
+    {
+        bluedot::Generator<float> generator;
+        if (!create(generator, outputs, log))
+        {
+            return 1;
+        }
+        Plan live;
+        if (!plan(generator, seed, outputs, live, log))
+        {
+            return 1;
+        }
+        random_generator_type random_number_generator{random_numbers(seed)};
+        return run(generator, random_number_generator, 0, live, outputs, output_file, log);
+    }
 
-                parse_multiplier_scale_and_offset(v, multiplier, scale, offset);
+    // Creates the layers, fails if a layer of an output does not exist
+    auto create(bluedot::Generator<float>& generator, const std::vector<Output>& outputs, std::ostream& log) const -> bool
+    {
+        if (!create_layers(_property_tree, generator, _crop.width, _crop.height, log))
+        {
+            return false;
+        }
 
-                bluedot::GradientOperator<Real> gradient_operator{multiplier, scale, offset};
-                result = apply_unary_operator(type, v, generator, gradient_operator);
-            }
-            else if (type == "GreaterThanOperator")
+        for (const Output& output : outputs)
+        {
+            if (!generator.layer(output.layer))
             {
-                std::vector<Real> level{static_cast<Real>(0.0), static_cast<Real>(0.0), static_cast<Real>(0.0), static_cast<Real>(0.0)};
+                std::cerr << "Unable to find output layer " << output.layer << ".\n";
+                return false;
+            }
+        }
+        return true;
+    }
 
-                parse_level(v, level);
+    // Finds the channels that neither later operators nor the outputs read, which are left uncomputed
+    auto plan(const bluedot::Generator<float>& generator, size_t seed, const std::vector<Output>& outputs, Plan& live, std::ostream& log) const -> bool
+    {
+        Liveness liveness{generator};
+        if (!apply_operators<float>(_property_tree, liveness, seed, _window, [&liveness](size_t index) { liveness.start(index); }))
+        {
+            return false;
+        }
+        std::map<std::string, std::vector<bool>> read_at_end;
+        read_at_end["base"] = bluedot::channel_range(generator.layer("base")->channels(), 1, 4);
+        for (const Output& output : outputs)
+        {
+            std::vector<bool>& channels{read_at_end[output.layer]};
+            const size_t count{generator.layer(output.layer)->channels()};
+            channels.resize(count, false);
+            for (size_t c{0}; c < count; ++c)
+            {
+                channels[c] = channels[c] || output.channels.empty() || std::find(output.channels.begin(), output.channels.end(), c) != output.channels.end();
+            }
+        }
+        live = liveness.solve(read_at_end);
+        if (liveness.skipped() > 0)
+        {
+            log << "Skipping " << liveness.skipped() << " of the " << liveness.written() << " channels written by operators, as nothing reads them.\n";
+        }
+        return true;
+    }
 
-                bool clamp{false};
-                boost::optional<std::string> pt_mode = v.second.get_optional<std::string>("mode");
-                if (pt_mode)
+    // Channels each operator before end computes for every one of several plans, which keeps a layer's channels if any plan does
+    static auto shared(const std::vector<Plan>& plans, size_t end) -> Plan
+    {
+        Plan shared{plans.front()};
+        shared.resize(std::min(shared.size(), end));
+        for (size_t index{0}; index < shared.size(); ++index)
+        {
+            std::map<std::string, std::vector<bool>>& step{shared[index]};
+            for (auto layer = step.begin(); layer != step.end();)
+            {
+                // Layers a plan does not list keep every channel
+                bool listed{true};
+                for (const Plan& plan : plans)
                 {
-                    if (*pt_mode == "Clamp")
+                    const auto l = plan[index].find(layer->first);
+                    listed = listed && l != plan[index].end();
+                    for (size_t c{0}; listed && c < layer->second.size(); ++c)
                     {
-                        clamp = true;
+                        layer->second[c] = layer->second[c] || (c < l->second.size() && l->second[c]);
                     }
                 }
-
-                bluedot::GreaterThanOperator<Real> greater_than_operator{level, clamp};
-                result = apply_unary_operator(type, v, generator, greater_than_operator);
+                layer = listed ? std::next(layer) : step.erase(layer);
             }
-            else if (type == "LessThanOperator")
-            {
-                std::vector<Real> level{static_cast<Real>(0.0), static_cast<Real>(0.0), static_cast<Real>(0.0), static_cast<Real>(0.0)};
+        }
+        return shared;
+    }
 
-                parse_level(v, level);
+    // Applies the operators before end to a generator, as the start of runs that carry on from there
+    auto start(bluedot::Generator<float>& generator, random_generator_type& random_number_generator, size_t end, const Plan& live, std::ostream& log) const -> bool
+    {
+        Rendering<float> rendering{generator, log};
+        return apply_operators<float>(_property_tree, rendering, random_number_generator, _window, 0, end, [&generator, &live](size_t index) {
+            generator.live_channels(index < live.size() ? live[index] : std::map<std::string, std::vector<bool>>{});
+        });
+    }
 
-                bool clamp{false};
-                boost::optional<std::string> pt_mode = v.second.get_optional<std::string>("mode");
-                if (pt_mode)
+    // Applies the operators from begin on and writes the files, returns the exit status
+    auto run(bluedot::Generator<float>& generator, random_generator_type& random_number_generator, size_t begin, const Plan& live,
+             const std::vector<Output>& outputs, const std::string& output_file, std::ostream& log) const -> int
+    {
+        auto set_live = [&generator, &live](size_t index) {
+            generator.live_channels(index < live.size() ? live[index] : std::map<std::string, std::vector<bool>>{});
+        };
+        // Outputs are written in the background as soon as the last operator changing their layer has run
+        bluedot::OutputQueue<float> queue;
+        std::vector<bool> queued(outputs.size(), false);
+        bool patch_failed{false};
+        auto write_outputs = [&](size_t applied) {
+            for (size_t i{0}; i < outputs.size(); ++i)
+            {
+                const auto l = _last.find(outputs[i].layer);
+                if (queued[i] || (l != _last.end() && l->second > applied))
+                    continue;
+                log << (_patch ? "Updating " : "Writing to ") << outputs[i].file << std::endl;
+                generator.materialize(outputs[i].layer);
+                if (_patch)
                 {
-                    if (*pt_mode == "Clamp")
+                    // Patches are small, so they are written in place rather than queued
+                    if (!bluedot::patch_layer(*generator.layer(outputs[i].layer), outputs[i].file, outputs[i].format, outputs[i].channels, _window,
+                                              _offset_x, _offset_y, _region.width, _region.height))
                     {
-                        clamp = true;
+                        std::cerr << "Error: Unable to update " << outputs[i].file << ", which must hold a render of the whole map\n";
+                        patch_failed = true;
                     }
                 }
-
-                bluedot::LessThanOperator<Real> less_than_operator{level, clamp};
-                result = apply_unary_operator(type, v, generator, less_than_operator);
-            }
-            else if (type == "MADDOperator")
-            {
-                std::vector<Real> multiplier;
-                Real scale{static_cast<Real>(1.0)};
-                Real offset{static_cast<Real>(0.0)};
-
-                parse_multiplier_scale_and_offset(v, multiplier, scale, offset);
-
-                bluedot::MADDOperator<Real> madd_operator{multiplier, scale, offset};
-                result = apply_unary_operator(type, v, generator, madd_operator);
+                else
+                {
+                    queue.write(*generator.layer(outputs[i].layer), outputs[i].file, outputs[i].format, outputs[i].channels, _offset_x, _offset_y, _region.width, _region.height);
+                }
+                queued[i] = true;
             }
-            else if (type == "MultiplyOperator")
+        };
+
+        // Layers idle for more than the given number of operators are compressed until the next one that uses them,
+        // and layers that no later operator or output reads are freed. Layers with outputs are left alone for the output queue.
+        size_t compressed_layers{0};
+        size_t uncompressed_bytes{0};
+        size_t compressed_bytes{0};
+        auto compress_idle = [&](size_t applied) {
+            if (_idle == std::numeric_limits<size_t>::max())
+                return;
+            for (const auto& use : _uses)
             {
-                std::vector<Real> multiplier;
-                Real scale{static_cast<Real>(1.0)};
-                Real offset{static_cast<Real>(0.0)};
-
-                parse_multiplier_scale_and_offset(v, multiplier, scale, offset);
-
-                bluedot::MultiplyOperator<Real> multiply_operator{multiplier, scale, offset};
-                result = apply_binary_operator(type, v, generator, multiply_operator);
+                const bluedot::Layer<float>* l{generator.layer(use.first)};
+                if (!l || use.first == "base" || std::any_of(outputs.begin(), outputs.end(), [&use](const Output& output) { return output.layer == use.first; }))
+                    continue;
+                // Layers not used yet may hold nothing worth keeping
+                const auto next = std::upper_bound(use.second.begin(), use.second.end(), applied);
+                if (next == use.second.begin())
+                    continue;
+                if (next == use.second.end())
+                {
+                    generator.release(use.first);
+                }
+                else if (*next - applied > _idle && generator.compress(use.first, _bits))
+                {
+                    ++compressed_layers;
+                    uncompressed_bytes += l->width() * l->height() * l->channels() * sizeof(float);
+                    compressed_bytes += l->compressed_bytes();
+                }
             }
-            else if (type == "NoiseOperator")
-            {
-                std::vector<Real> multiplier;
-                Real scale{static_cast<Real>(1.0)};
-                Real offset{static_cast<Real>(0.0)};
-
-                parse_multiplier_scale_and_offset(v, multiplier, scale, offset);
+        };
+
+        // Apply operators
+        Rendering<float> rendering{generator, log};
+        if (!apply_operators<float>(_property_tree, rendering, random_number_generator, _window, begin, std::numeric_limits<size_t>::max(), set_live, [&](size_t applied) {
+                write_outputs(applied);
+                compress_idle(applied);
+            }))
+        {
+            return 1;
+        }
+        // Operators skipped for a missing type report nothing, so any outputs left over are written now
+        write_outputs(std::numeric_limits<size_t>::max());
+        if (compressed_layers > 0)
+        {
+            log << "Compressed idle layers " << compressed_layers << " times, to " << (100 * compressed_bytes + uncompressed_bytes / 2) / uncompressed_bytes << "% of their size.\n";
+        }
 
-                bluedot::NoiseOperator<Real, generator_type> noise_operator{random_number_generator, multiplier, scale, offset};
-                result = apply_unary_operator(type, v, generator, noise_operator);
-            }
-            else if (type == "NormalizeOperator")
-            {
-                bluedot::NormalizeOperator<Real> normalize_operator;
-                result = apply_unary_operator(type, v, generator, normalize_operator);
-            }
-            else if (type == "SwapOperator")
-            {
-                bluedot::SwapOperator<Real> swap_operator;
-                result = apply_binary_operator(type, v, generator, swap_operator);
-            }
-            else
+        // Write image
+        int status{patch_failed ? 1 : 0};
+        generator.materialize("base");
+        const bluedot::Layer<float>* base{generator.layer("base")};
+        if (_patch)
+        {
+            log << "Updating " << output_file << std::endl;
+            if (!base || !bluedot::patch_layer(*base, output_file, bluedot::OutputFormat::eight_bit, {1, 2, 3}, _window, _offset_x, _offset_y, _region.width, _region.height))
             {
-                std::cerr << "Unknown operator type: " << type << "\n";
-                result = false;
+                std::cerr << "Error: Unable to update " << output_file << ", which must hold a render of the whole map\n";
+                status = 1;
             }
-            if (!result)
+        }
+        else
+        {
+            log << "Writing to " << output_file << std::endl;
+            if (!base || !bluedot::write_layer(*base, output_file, bluedot::OutputFormat::eight_bit, {1, 2, 3}, _offset_x, _offset_y, _region.width, _region.height))
             {
-                std::cerr << "Failed to apply operator of type: " << type << "\n";
+                std::cerr << "Error: Unable to write " << output_file << "\n";
+                status = 1;
             }
         }
+
+        for (const std::string& file : queue.finish())
+        {
+            std::cerr << "Error: Unable to write " << file << "\n";
+            status = 1;
+        }
+
+        return status;
     }
-    catch (pt::ptree_bad_path& e)
+private:
+    pt::ptree& _property_tree;
+    Region _region;
+    Region _crop;
+    bluedot::Window _window;
+    // Position of the region within the layers
+    size_t _offset_x;
+    size_t _offset_y;
+    // Operators a layer must stay unused for to be compressed, and the mantissa bits it keeps
+    size_t _idle;
+    size_t _bits;
+    bool _patch;
+    std::map<std::string, size_t> _last;
+    std::map<std::string, std::vector<size_t>> _uses;
+};
+
+// File name of an output of one seed of an ensemble or one point of a sweep
+auto suffixed_file(const std::string& file, const std::string& suffix) -> std::string
+{
+    const fs::path path{file};
+    return (path.parent_path() / (path.stem().string() + "_" + suffix + path.extension().string())).string();
+}
+
+// A parameter of one operator set to each of several values
+struct Sweep {
+    // Index of the operator, from 0
+    size_t index;
+    // Path of the parameter within the operator, such as scale or multiplier.r
+    std::string key;
+    std::vector<std::string> values;
+};
+
+// Sweeps are written operator:key=value,value,... with operators counted from 1 in configuration order
+auto parse_sweep(const std::string& text, Sweep& sweep) -> bool
+{
+    const size_t colon{text.find(':')};
+    const size_t equals{text.find('=', colon == std::string::npos ? 0 : colon)};
+    size_t position{0};
+    try
     {
-        std::cerr << "Unable to find operators in configuration file.\n";
-        std::cerr << e.what() << "\n";
-        return false;
+        position = colon != std::string::npos ? std::stoul(text.substr(0, colon)) : 0;
     }
-    catch (pt::ptree_bad_data& e)
+    catch (...)
     {
-        std::cerr << "Unable to read operators in configuration file.\n";
-        std::cerr << e.what() << "\n";
+    }
+    if (position == 0 || equals == std::string::npos || equals == colon + 1 || equals + 1 == text.size())
+    {
+        std::cerr << "Unable to read sweep " << text << ", expected operator:key=value,value,...\n";
         return false;
     }
-    catch (...)
+    sweep.index = position - 1;
+    sweep.key = text.substr(colon + 1, equals - colon - 1);
+    sweep.values.clear();
+    std::istringstream in{text.substr(equals + 1)};
+    std::string value;
+    while (std::getline(in, value, ','))
     {
-        std::cerr << "Unhandled exception when reading operators in configuration file.\n";
+        sweep.values.push_back(value);
+    }
+    return true;
+}
+
+// The configuration with the swept parameter set to a value, fails if there are not enough operators
+auto sweep_configuration(const pt::ptree& property_tree, const Sweep& sweep, const std::string& value, pt::ptree& configuration) -> bool
+{
+    configuration = property_tree;
+    boost::optional<pt::ptree&> pt_operators = configuration.get_child_optional("map.operators");
+    if (!pt_operators || sweep.index >= pt_operators->size())
+    {
+        std::cerr << "Unable to find operator " << sweep.index + 1 << " to sweep in configuration file.\n";
         return false;
     }
+    std::next(pt_operators->begin(), static_cast<std::ptrdiff_t>(sweep.index))->second.put(sweep.key, value);
     return true;
 }
 
@@ -723,7 +2122,17 @@ auto main(int argc, char** argv) -> int
     desc.add_options()
         ("help,h", "Produce help message")
         ("input,i", po::value<std::string>()->required(), "Input configuration file")
-        ("output,o", po::value<std::string>()->required(), "Output file");
+        ("output,o", po::value<std::string>()->required(), "Output file")
+        ("region", po::value<std::string>(), "Render only the region x0,y0,w,h of the map")
+        ("update", po::value<std::string>(), "Render only what an edit to the rectangle x0,y0,w,h of a layer changes, given as layer:x0,y0,w,h, and write it over the files of an earlier render")
+        ("threads", po::value<size_t>(), "Number of threads the operators use, defaults to OMP_NUM_THREADS or every processor")
+        ("serial", "Run every operator on the calling thread")
+        ("pin", "Pin each thread to one processor")
+        ("compress-idle", po::value<size_t>(), "Compress layers that the next N operators do not use, and free those no operator uses again")
+        ("compress-bits", po::value<size_t>(), "Mantissa bits compressed layers keep, which makes compression lossy, defaults to every bit")
+        ("seeds", po::value<size_t>(), "Render N seeds from the seed of the configuration on side by side, adding the seed to each file name")
+        ("sweep", po::value<std::string>(), "Render operator:key=value,value,... once for each value of the key of the operator counted from 1, adding the value to each file name")
+        ("emit-cpp", po::value<std::string>(), "Write a standalone C++ renderer for the configuration instead of rendering it");
 
     po::variables_map vm;
     try
@@ -804,41 +2213,252 @@ auto main(int argc, char** argv) -> int
         return 1;
     }
 
-    bluedot::Generator<float> generator;
-
-    // Create layers 
-    if (!create_layers<float>(property_tree, generator, width, height))
+    std::vector<Output> outputs;
+    if (!parse_outputs(property_tree, outputs))
     {
         return 1;
     }
 
-    // Apply operators
-    if (!apply_operators(property_tree, generator, seed))
+    // Seeds of an ensemble and points of a sweep render side by side, each on a thread of its own, so small maps use every thread as well
+    const size_t seeds{vm.count("seeds") ? std::max<size_t>(vm["seeds"].as<size_t>(), 1) : 1};
+    Sweep sweep{0, "", {}};
+    if (vm.count("sweep"))
     {
-        return 1;
+        if (!parse_sweep(vm["sweep"].as<std::string>(), sweep))
+        {
+            return 1;
+        }
+        if (seeds > 1)
+        {
+            std::cerr << "A sweep renders a single seed, and cannot be combined with --seeds.\n";
+            return 1;
+        }
+    }
+    // The points of a sweep render on the same layers, so the region and its halo are planned for every configuration
+    std::vector<pt::ptree> configurations;
+    for (const std::string& value : sweep.values)
+    {
+        configurations.emplace_back();
+        if (!sweep_configuration(property_tree, sweep, value, configurations.back()))
+        {
+            return 1;
+        }
+    }
+    if (configurations.empty())
+    {
+        configurations.push_back(property_tree);
+    }
+
+    // The layers cover the region to render and the halo the operators read around it
+    Region region{0, 0, width, height};
+    Region crop{region};
+    // An update renders the part of the map an edit to a layer changes, and writes it over the files of an earlier render
+    bool patch{false};
+    if (vm.count("update"))
+    {
+        const std::string update{vm["update"].as<std::string>()};
+        const size_t colon{update.find(':')};
+        Region edit{0, 0, width, height};
+        if (vm.count("region") || colon == std::string::npos)
+        {
+            std::cerr << "Unable to read update " << update << ", expected layer:x0,y0,w,h without a region.\n";
+            return 1;
+        }
+        if (!parse_region(update.substr(colon + 1), width, height, edit))
+        {
+            return 1;
+        }
+        DirtyRegions dirty{update.substr(0, colon), edit};
+        for (pt::ptree& configuration : configurations)
+        {
+            DirtyRegions changes{update.substr(0, colon), edit};
+            if (!apply_operators<float>(configuration, changes, seed, bluedot::Window{0, 0, 0, 0}))
+            {
+                return 1;
+            }
+            dirty.merge(changes);
+        }
+        std::vector<std::string> written{"base"};
+        for (const Output& output : outputs)
+        {
+            written.push_back(output.layer);
+        }
+        if (dirty.whole())
+        {
+            std::cout << "Updating the whole map, as an operator reading whole layers reads the edit.\n";
+        }
+        else if (!dirty.region(written, width, height, region))
+        {
+            std::cout << "Nothing to update, as the edit does not reach the output file or the outputs.\n";
+            return 0;
+        }
+        patch = !dirty.whole();
+    }
+
+    if (vm.count("region") || patch)
+    {
+        if (!patch && !parse_region(vm["region"].as<std::string>(), width, height, region))
+        {
+            return 1;
+        }
+        Planner planner;
+        for (pt::ptree& configuration : configurations)
+        {
+            Planner footprints;
+            if (!apply_operators<float>(configuration, footprints, seed, bluedot::Window{0, 0, 0, 0}))
+            {
+                return 1;
+            }
+            planner.merge(footprints);
+        }
+        crop = planner.crop(region, width, height);
+        if (planner.whole())
+        {
+            std::cout << "Rendering the whole map, as some operators read whole layers.\n";
+        }
+        std::cout << (patch ? "Updating region " : "Rendering region ") << region.x << "," << region.y << " " << region.width << "x" << region.height
+                  << " on " << crop.width << "x" << crop.height << " layers.\n";
+    }
+    const bluedot::Window window{crop.x, crop.y, width, height};
+    // Position of the region within the layers
+    const size_t offset_x{(region.x + width - crop.x) % width};
+    const size_t offset_y{region.y - crop.y};
+
+    if (vm.count("emit-cpp"))
+    {
+        const fs::path source_file{vm["emit-cpp"].as<std::string>()};
+        bluedot::Emitter<float> emitter{region.width, region.height, seed, offset_x, offset_y};
+        if (!create_layers(property_tree, emitter, crop.width, crop.height, std::cout))
+        {
+            return 1;
+        }
+        if (!apply_operators<float>(property_tree, emitter, seed, window))
+        {
+            return 1;
+        }
+        for (const Output& output : outputs)
+        {
+            if (!emitter.add_output(output.file, output.layer, output.channels, output.format))
+            {
+                std::cerr << "Unable to find output layer " << output.layer << ".\n";
+                return 1;
+            }
+        }
+
+        std::cout << "Writing to " << source_file.string() << std::endl;
+        std::ofstream source{source_file.string()};
+        source << emitter.source(output_file.string());
+        return source ? 0 : 1;
     }
 
-    // Write image
-    std::vector<std::array<char, 3>> image{width * height, {0, 0, 0}};
-    
-    for (size_t y{0}; y < height; ++y)
-        for (size_t x{0}; x < width; ++x)
+    const size_t renders{vm.count("sweep") ? sweep.values.size() : seeds};
+    const bluedot::Execution execution{vm.count("serial") ? bluedot::Backend::serial : bluedot::Backend::openmp,
+                                       vm.count("threads") ? vm["threads"].as<size_t>() : 0, renders > 1 ? static_cast<size_t>(0) : 128 * 128, vm.count("pin") > 0};
+    const size_t threads{std::min(execution.apply(crop.width, crop.height), renders > 1 ? renders : std::numeric_limits<size_t>::max())};
+    std::cout << "Rendering " << (seeds > 1 ? std::to_string(seeds) + " seeds " : "") << (vm.count("sweep") ? std::to_string(renders) + " sweep points " : "")
+              << "on " << threads << (threads == 1 ? " thread" : " threads") << (execution.pin() && threads > 1 ? ", pinned" : "") << ".\n";
+
+    const size_t idle{vm.count("compress-idle") ? vm["compress-idle"].as<size_t>() : std::numeric_limits<size_t>::max()};
+    const size_t bits{vm.count("compress-bits") ? vm["compress-bits"].as<size_t>() : bluedot::PackedSamples<float>::lossless};
+    if (vm.count("sweep"))
+    {
+        std::vector<Render> points;
+        std::vector<Render::Plan> plans(renders);
+        std::vector<std::string> logs(renders);
+        for (size_t i{0}; i < renders; ++i)
+        {
+            points.emplace_back(configurations[i], region, crop, window, offset_x, offset_y, idle, bits, patch);
+        }
+
+        // The operators before the swept one are the same for every point, so they run once, on every thread,
+        // and each point carries on from a fork of the layers they leave, which copies a layer only when the point writes it
+        bluedot::Generator<float> generator;
+        if (!points.front().create(generator, outputs, std::cout))
+        {
+            return 1;
+        }
+        for (size_t i{0}; i < renders; ++i)
+        {
+            std::ostringstream log;
+            if (!points[i].plan(generator, seed, outputs, plans[i], log))
+            {
+                return 1;
+            }
+            logs[i] = log.str();
+        }
+        random_generator_type random_number_generator{random_numbers(seed)};
+        if (!points.front().start(generator, random_number_generator, sweep.index, Render::shared(plans, sweep.index), std::cout))
+        {
+            return 1;
+        }
+
+        // Once every point has its fork the layers are held by the points alone,
+        // so a layer a point frees or compresses is no longer kept whole for the original
+        std::vector<bluedot::Generator<float>> forks;
+        for (size_t i{0}; i < renders; ++i)
         {
-            image[x + y * width][0] = static_cast<char>(std::max(0.0f, std::min(1.0f, generator("base", x, y, 1))) * 255.0f);
-            image[x + y * width][1] = static_cast<char>(std::max(0.0f, std::min(1.0f, generator("base", x, y, 2))) * 255.0f);
-            image[x + y * width][2] = static_cast<char>(std::max(0.0f, std::min(1.0f, generator("base", x, y, 3))) * 255.0f);
+            forks.push_back(generator.fork());
         }
+        generator = bluedot::Generator<float>{};
 
-    std::cout << "Writing to " << output_file.string() << std::endl;
-    std::ofstream out{output_file.string(), std::ios::out | std::ios::binary};
-    out << "P6\n";
-    out << "# " << output_file.string() << "\n";
-    out << width << " " << height << " 255 ";
-    for (size_t y{0}; y < height; ++y)
-        for (size_t x{0}; x < width; ++x)
+        std::vector<int> statuses(renders, 0);
+        const int64_t count{static_cast<int64_t>(renders)};
+#pragma omp parallel for schedule(dynamic) num_threads(static_cast<int>(threads))
+        for (int64_t i = 0; i < count; ++i)
+        {
+            // The operators of each point run on its thread alone
+            bluedot::Execution{bluedot::Backend::serial}.apply(crop.width, crop.height);
+            const size_t point{static_cast<size_t>(i)};
+            bluedot::Generator<float> fork{std::move(forks[point])};
+            random_generator_type random{random_number_generator};
+            std::vector<Output> point_outputs{outputs};
+            for (Output& output : point_outputs)
+            {
+                output.file = suffixed_file(output.file, sweep.values[point]);
+            }
+            std::ostringstream log;
+            statuses[point] = points[point].run(fork, random, sweep.index, plans[point], point_outputs, suffixed_file(output_file.string(), sweep.values[point]), log);
+            logs[point] += log.str();
+        }
+        int status{0};
+        for (size_t i{0}; i < renders; ++i)
         {
-            out << image[x + y * width][0] << image[x + y * width][1] << image[x + y * width][2];
+            std::cout << sweep.key << " = " << sweep.values[i] << ":\n" << logs[i];
+            status = statuses[i] != 0 ? statuses[i] : status;
         }
+        return status;
+    }
+
+    const Render render{property_tree, region, crop, window, offset_x, offset_y, idle, bits, patch};
+    if (seeds == 1)
+    {
+        return render(seed, outputs, output_file.string(), std::cout);
+    }
 
-    return 0;
+    // The configuration is read and planned once, and each seed writes files of its own
+    std::vector<std::string> logs(seeds);
+    std::vector<int> statuses(seeds, 0);
+    const int64_t count{static_cast<int64_t>(seeds)};
+#pragma omp parallel for schedule(dynamic) num_threads(static_cast<int>(threads))
+    for (int64_t i = 0; i < count; ++i)
+    {
+        // The operators of each seed run on its thread alone
+        bluedot::Execution{bluedot::Backend::serial}.apply(crop.width, crop.height);
+        const size_t variant{seed + static_cast<size_t>(i)};
+        std::vector<Output> variant_outputs{outputs};
+        for (Output& output : variant_outputs)
+        {
+            output.file = suffixed_file(output.file, std::to_string(variant));
+        }
+        std::ostringstream log;
+        statuses[static_cast<size_t>(i)] = render(variant, variant_outputs, suffixed_file(output_file.string(), std::to_string(variant)), log);
+        logs[static_cast<size_t>(i)] = log.str();
+    }
+    int status{0};
+    for (size_t i{0}; i < seeds; ++i)
+    {
+        std::cout << "Seed " << seed + i << ":\n" << logs[i];
+        status = statuses[i] != 0 ? statuses[i] : status;
+    }
+    return status;
 }
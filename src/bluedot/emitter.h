@@ -0,0 +1,92 @@
+// emitter.h
+// Translates a configuration into a standalone C++ renderer
+// The emitter stands in for the generator while the configuration is read: layers become named variables
+// with fixed sizes, and each operator becomes a concrete object built from literal arguments and called directly,
+// in configuration order. Building the source against src gives the same image as running the configuration.
+// Copyright Laurence Emms 2017
+
+#pragma once
+#include <map>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <boost/random.hpp>
+
+#include "../generator/allocator.h"
+#include "../generator/fbmop.h"
+#include "../generator/mask.h"
+#include "../generator/noiseop.h"
+#include "../generator/output.h"
+#include "../generator/window.h"
+
+namespace bluedot {
+    template <typename Real>
+    class Emitter {
+    public:
+        using generator_type = boost::variate_generator<boost::mt19937, boost::uniform_real<>>;
+
+        // The generated renderer writes the width by height image whose top left sample is (x, y) of the base layer
+        Emitter(size_t width, size_t height, size_t seed, size_t x = 0, size_t y = 0);
+        auto create_layer(const std::string& name, size_t width, size_t height, size_t channels, const Allocator& allocator = Allocator{}) -> void;
+        auto create_mask(const std::string& name, size_t width, size_t height, MaskFormat format = MaskFormat::bit) -> void;
+        // Each emit function fails if a layer or mask it names does not exist, and emits nothing in that case
+        template <typename Operator, typename... Args>
+        auto emit_unary_operator(const std::string& type, const std::string& layer, const std::string& mask, const Args&... args) -> bool;
+        template <typename Operator, typename... Args>
+        auto emit_binary_operator(const std::string& type, const std::string& layer0, const std::string& layer1, const std::string& mask, const Args&... args) -> bool;
+        template <typename Operator, typename... Args>
+        auto emit_nary_operator(const std::string& type, const std::vector<std::string>& layers, const std::string& mask, const Args&... args) -> bool;
+        template <typename Operator, typename... Args>
+        auto emit_mask_operator(const std::string& type, const std::string& layer, const std::string& mask, const Args&... args) -> bool;
+        // Writes the channels of a layer to a file after the operators, fails if the layer does not exist
+        auto add_output(const std::string& file, const std::string& layer, const std::vector<size_t>& channels, OutputFormat format) -> bool;
+        // The whole program, which renders the base layer to its first argument or to output
+        auto source(const std::string& output) const -> std::string;
+    private:
+        template <typename Operator>
+        static auto operator_type(const std::string& type) -> std::string;
+        auto arguments() const -> std::string;
+        template <typename First, typename... Rest>
+        auto arguments(const First& first, const Rest&... rest) const -> std::string;
+        static auto literal(Real value) -> std::string;
+        static auto literal(size_t value) -> std::string;
+        static auto literal(bool value) -> std::string;
+        static auto literal(const std::string& value) -> std::string;
+        static auto literal(const std::vector<Real>& value) -> std::string;
+        static auto literal(const std::vector<size_t>& value) -> std::string;
+        static auto literal(const std::vector<std::vector<Real>>& value) -> std::string;
+        static auto literal(const Window& value) -> std::string;
+        static auto literal(const generator_type& value) -> std::string;
+        // Variable holding the mask, which may be a layer or a mask layer as in Generator
+        auto mask_view(const std::string& mask) const -> std::string;
+        // Layers read as masks store their samples first, as in Generator
+        auto prepare_mask(const std::string& mask) -> void;
+        auto begin_operator(const std::string& type, const std::string& construction) -> void;
+        auto end_operator(const std::string& type, const std::string& call, const std::vector<std::string>& written) -> void;
+
+        size_t _width;
+        size_t _height;
+        size_t _seed;
+        size_t _x;
+        size_t _y;
+        // Variable names of the layers and masks
+        std::map<std::string, std::string> _layers;
+        std::map<std::string, std::string> _masks;
+        std::ostringstream _declarations;
+        std::ostringstream _operators;
+        std::ostringstream _outputs;
+    };
+
+    // Operators that draw from the random number generator take its type as a template argument
+    template <typename Operator>
+    struct random_operator : std::false_type {};
+
+    template <typename Real, typename RNG>
+    struct random_operator<NoiseOperator<Real, RNG>> : std::true_type {};
+
+    template <typename Real, typename RNG>
+    struct random_operator<FBMOperator<Real, RNG>> : std::true_type {};
+}
+
+#include "emitter.hpp"
@@ -0,0 +1,380 @@
+// emitter.hpp
+// Copyright Laurence Emms 2017
+
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <limits>
+#include <locale>
+
+namespace bluedot {
+    template <typename Real>
+    Emitter<Real>::Emitter(size_t width, size_t height, size_t seed, size_t x, size_t y) : _width(width), _height(height), _seed(seed), _x(x), _y(y)
+    {
+    }
+
+    template <typename Real>
+    auto Emitter<Real>::create_layer(const std::string& name, size_t width, size_t height, size_t channels, const Allocator& allocator) -> void
+    {
+        // Like the generator, the first layer with a name wins
+        if (_layers.find(name) != _layers.end())
+            return;
+        std::string variable{"layer_" + std::to_string(_layers.size())};
+        _layers.insert(std::make_pair(name, variable));
+        _declarations << "    // " << name << "\n";
+        _declarations << "    bluedot::Layer<Real> " << variable << "{" << width << ", " << height << ", " << channels << ", bluedot::Allocator{"
+                      << allocator.alignment() << ", " << literal(allocator.huge_pages()) << ", " << literal(allocator.initialize()) << "}};\n";
+    }
+
+    template <typename Real>
+    auto Emitter<Real>::create_mask(const std::string& name, size_t width, size_t height, MaskFormat format) -> void
+    {
+        if (_masks.find(name) != _masks.end())
+            return;
+        std::string variable{"mask_" + std::to_string(_masks.size())};
+        _masks.insert(std::make_pair(name, variable));
+        _declarations << "    // " << name << "\n";
+        _declarations << "    bluedot::MaskLayer<Real> " << variable << "{" << width << ", " << height << ", "
+                      << (format == MaskFormat::bit ? "bluedot::MaskFormat::bit" : "bluedot::MaskFormat::byte") << "};\n";
+    }
+
+    template <typename Real>
+    template <typename Operator, typename... Args>
+    auto Emitter<Real>::emit_unary_operator(const std::string& type, const std::string& layer, const std::string& mask, const Args&... args) -> bool
+    {
+        auto l = _layers.find(layer);
+        if (l == _layers.end())
+            return false;
+        std::string view{mask_view(mask)};
+        if (mask != "" && view == "")
+            return false;
+        begin_operator(type, operator_type<Operator>(type) + " op{" + arguments(args...) + "};");
+        _operators << "        bluedot::prepare_layers(" << l->second << ", op, " << literal(mask != "") << ");\n";
+        prepare_mask(mask);
+        end_operator(type, "op(" + l->second + (view == "" ? "" : ", " + view) + ")", {l->second});
+        return true;
+    }
+
+    template <typename Real>
+    template <typename Operator, typename... Args>
+    auto Emitter<Real>::emit_binary_operator(const std::string& type, const std::string& layer0, const std::string& layer1, const std::string& mask, const Args&... args) -> bool
+    {
+        auto l0 = _layers.find(layer0);
+        if (l0 == _layers.end())
+            return false;
+        auto l1 = _layers.find(layer1);
+        if (l1 == _layers.end())
+            return false;
+        std::string view{mask_view(mask)};
+        if (mask != "" && view == "")
+            return false;
+        begin_operator(type, operator_type<Operator>(type) + " op{" + arguments(args...) + "};");
+        _operators << "        bluedot::prepare_layers(" << l0->second << ", " << l1->second << ", op, " << literal(mask != "") << ");\n";
+        prepare_mask(mask);
+        end_operator(type, "op(" + l0->second + ", " + l1->second + (view == "" ? "" : ", " + view) + ")", {l0->second, l1->second});
+        return true;
+    }
+
+    template <typename Real>
+    template <typename Operator, typename... Args>
+    auto Emitter<Real>::emit_nary_operator(const std::string& type, const std::vector<std::string>& layers, const std::string& mask, const Args&... args) -> bool
+    {
+        std::vector<std::string> variables;
+        std::string pointers;
+        for (const std::string& layer : layers)
+        {
+            auto l = _layers.find(layer);
+            if (l == _layers.end())
+                return false;
+            pointers += (variables.empty() ? "&" : ", &") + l->second;
+            variables.push_back(l->second);
+        }
+        std::string view{mask_view(mask)};
+        if (mask != "" && view == "")
+            return false;
+        begin_operator(type, operator_type<Operator>(type) + " op{" + arguments(args...) + "};");
+        _operators << "        std::vector<bluedot::Layer<Real>*> layers{" << pointers << "};\n";
+        for (const std::string& variable : variables)
+        {
+            _operators << "        " << variable << ".detach();\n";
+            _operators << "        " << variable << ".materialize();\n";
+        }
+        prepare_mask(mask);
+        end_operator(type, "op(layers" + (view == "" ? std::string{} : ", " + view) + ")", variables);
+        return true;
+    }
+
+    template <typename Real>
+    template <typename Operator, typename... Args>
+    auto Emitter<Real>::emit_mask_operator(const std::string& type, const std::string& layer, const std::string& mask, const Args&... args) -> bool
+    {
+        auto l = _layers.find(layer);
+        if (l == _layers.end())
+            return false;
+        auto m = _masks.find(mask);
+        if (m == _masks.end())
+            return false;
+        begin_operator(type, operator_type<Operator>(type) + " op{" + arguments(args...) + "};");
+        _operators << "        " << l->second << ".materialize();\n";
+        // Reading the layer through a const reference selects the overload that writes the mask
+        end_operator(type, "op(static_cast<const bluedot::Layer<Real>&>(" + l->second + "), " + m->second + ")", {m->second});
+        return true;
+    }
+
+    template <typename Real>
+    auto Emitter<Real>::source(const std::string& output) const -> std::string
+    {
+        std::string real{std::is_same<Real, float>::value ? "float" : std::is_same<Real, double>::value ? "double" : "long double"};
+        std::ostringstream out;
+        out << "// Generated by bluedot --emit-cpp\n";
+        out << "// Build against the bluedot src directory with OpenMP, for example:\n";
+        out << "// g++ -O3 -fopenmp -I <bluedot>/src renderer.cpp -o renderer\n\n";
+        out << "#include <cstdint>\n";
+        out << "#include <iostream>\n";
+        out << "#include <limits>\n";
+        out << "#include <string>\n";
+        out << "#include <vector>\n";
+        out << "#include <boost/random.hpp>\n\n";
+        for (const char* header : {"alphablendop", "alphatocolorop", "blurop", "boxblurop", "colorrampop", "colortoalphaop", "copyop",
+                                   "distancetransformop", "equalizeop", "execution", "expressionop", "fbmop", "fillop", "gradientop",
+                                   "greaterthanop", "laplacianop", "lessthanop", "loadlayerop", "maddop", "multiplyop", "noiseop",
+                                   "normalizeop", "output", "percentilenormalizeop", "savelayerop", "sobelop", "swapop"})
+        {
+            out << "#include \"generator/" << header << ".h\"\n";
+        }
+        out << "\n";
+        out << "using Real = " << real << ";\n";
+        out << "using generator_type = boost::variate_generator<boost::mt19937, boost::uniform_real<>>;\n\n";
+        out << "constexpr size_t width{" << _width << "};\n";
+        out << "constexpr size_t height{" << _height << "};\n\n";
+        out << "auto main(int argc, char** argv) -> int\n";
+        out << "{\n";
+        out << "    const std::string output_file{argc > 1 ? argv[1] : " << literal(output) << "};\n";
+        out << "    // Small maps run on one thread, as in bluedot\n";
+        out << "    bluedot::Execution{}.apply(width, height);\n\n";
+        out << "    boost::mt19937 rng{static_cast<uint32_t>(" << static_cast<uint32_t>(_seed) << ")};\n";
+        out << "    boost::uniform_real<> range{-1.0, 1.0};\n";
+        out << "    generator_type random_number_generator{rng, range};\n\n";
+        out << _declarations.str() << "\n";
+        out << _operators.str() << "\n";
+
+        // The region is written from the base layer, as bluedot writes it, followed by the outputs
+        auto base = _layers.find("base");
+        if (base == _layers.end())
+        {
+            out << "    std::cerr << \"Error: No base layer found.\\n\";\n";
+            out << "    return 1;\n";
+            out << "}\n";
+            return out.str();
+        }
+        out << "    std::cout << \"Writing to \" << output_file << std::endl;\n";
+        out << "    " << base->second << ".materialize();\n";
+        out << "    if (!bluedot::write_layer(" << base->second << ", output_file, bluedot::OutputFormat::eight_bit, {1, 2, 3}, "
+            << _x << ", " << _y << ", width, height))\n";
+        out << "    {\n";
+        out << "        std::cerr << \"Error: Unable to write \" << output_file << \"\\n\";\n";
+        out << "        return 1;\n";
+        out << "    }\n";
+        out << _outputs.str() << "\n";
+        out << "    return 0;\n";
+        out << "}\n";
+        return out.str();
+    }
+
+    template <typename Real>
+    auto Emitter<Real>::add_output(const std::string& file, const std::string& layer, const std::vector<size_t>& channels, OutputFormat format) -> bool
+    {
+        auto l = _layers.find(layer);
+        if (l == _layers.end())
+            return false;
+        std::string name{format == OutputFormat::real ? "real" : format == OutputFormat::sixteen_bit ? "sixteen_bit" : "eight_bit"};
+        _outputs << "    std::cout << \"Writing to \" << " << literal(file) << " << std::endl;\n";
+        _outputs << "    " << l->second << ".materialize();\n";
+        _outputs << "    if (!bluedot::write_layer(" << l->second << ", " << literal(file) << ", bluedot::OutputFormat::" << name << ", "
+                 << literal(channels) << ", " << _x << ", " << _y << ", width, height))\n";
+        _outputs << "    {\n";
+        _outputs << "        std::cerr << \"Error: Unable to write \" << " << literal(file) << " << \"\\n\";\n";
+        _outputs << "        return 1;\n";
+        _outputs << "    }\n";
+        return true;
+    }
+
+    template <typename Real>
+    template <typename Operator>
+    auto Emitter<Real>::operator_type(const std::string& type) -> std::string
+    {
+        return "bluedot::" + type + (random_operator<Operator>::value ? "<Real, generator_type>" : "<Real>");
+    }
+
+    template <typename Real>
+    auto Emitter<Real>::arguments() const -> std::string
+    {
+        return "";
+    }
+
+    template <typename Real>
+    template <typename First, typename... Rest>
+    auto Emitter<Real>::arguments(const First& first, const Rest&... rest) const -> std::string
+    {
+        std::string result{literal(first)};
+        if (sizeof...(rest) > 0)
+            result += ", " + arguments(rest...);
+        return result;
+    }
+
+    template <typename Real>
+    auto Emitter<Real>::literal(Real value) -> std::string
+    {
+        if (std::isnan(value))
+            return "std::numeric_limits<Real>::quiet_NaN()";
+        if (std::isinf(value))
+            return value > static_cast<Real>(0.0) ? "std::numeric_limits<Real>::infinity()" : "-std::numeric_limits<Real>::infinity()";
+
+        // Enough digits that the literal converts back to exactly the same value
+        std::ostringstream out;
+        out.imbue(std::locale::classic());
+        out << std::setprecision(std::numeric_limits<Real>::max_digits10) << value;
+        std::string text{out.str()};
+        if (text.find_first_of(".e") == std::string::npos)
+            text += ".0";
+        if (std::is_same<Real, float>::value)
+            text += "f";
+        else if (std::is_same<Real, long double>::value)
+            text += "L";
+        return text;
+    }
+
+    template <typename Real>
+    auto Emitter<Real>::literal(size_t value) -> std::string
+    {
+        return std::to_string(value);
+    }
+
+    template <typename Real>
+    auto Emitter<Real>::literal(bool value) -> std::string
+    {
+        return value ? "true" : "false";
+    }
+
+    template <typename Real>
+    auto Emitter<Real>::literal(const std::string& value) -> std::string
+    {
+        std::string text{"\""};
+        for (char c : value)
+        {
+            switch (c)
+            {
+            case '\\':
+                text += "\\\\";
+                break;
+            case '"':
+                text += "\\\"";
+                break;
+            case '\n':
+                text += "\\n";
+                break;
+            case '\r':
+                text += "\\r";
+                break;
+            case '\t':
+                text += "\\t";
+                break;
+            default:
+                text += c;
+                break;
+            }
+        }
+        return text + "\"";
+    }
+
+    template <typename Real>
+    auto Emitter<Real>::literal(const std::vector<Real>& value) -> std::string
+    {
+        std::string text{"std::vector<Real>{"};
+        for (size_t i{0}; i < value.size(); ++i)
+        {
+            text += (i == 0 ? "" : ", ") + literal(value[i]);
+        }
+        return text + "}";
+    }
+
+    template <typename Real>
+    auto Emitter<Real>::literal(const std::vector<size_t>& value) -> std::string
+    {
+        std::string text{"std::vector<size_t>{"};
+        for (size_t i{0}; i < value.size(); ++i)
+        {
+            text += (i == 0 ? "" : ", ") + literal(value[i]);
+        }
+        return text + "}";
+    }
+
+    template <typename Real>
+    auto Emitter<Real>::literal(const std::vector<std::vector<Real>>& value) -> std::string
+    {
+        std::string text{"std::vector<std::vector<Real>>{"};
+        for (size_t i{0}; i < value.size(); ++i)
+        {
+            text += (i == 0 ? "" : ", ") + literal(value[i]);
+        }
+        return text + "}";
+    }
+
+    template <typename Real>
+    auto Emitter<Real>::literal(const Window& value) -> std::string
+    {
+        return "bluedot::Window{" + std::to_string(value.x) + ", " + std::to_string(value.y) + ", " + std::to_string(value.map_width) + ", " + std::to_string(value.map_height) + "}";
+    }
+
+    template <typename Real>
+    auto Emitter<Real>::literal(const generator_type&) -> std::string
+    {
+        // Operators share the one generator, so the draws happen in the same order as in bluedot
+        return "random_number_generator";
+    }
+
+    template <typename Real>
+    auto Emitter<Real>::mask_view(const std::string& mask) const -> std::string
+    {
+        if (mask == "")
+            return "";
+        auto l = _layers.find(mask);
+        if (l != _layers.end())
+            return "bluedot::MaskView<Real>{" + l->second + "}";
+        auto m = _masks.find(mask);
+        if (m != _masks.end())
+            return "bluedot::MaskView<Real>{" + m->second + "}";
+        return "";
+    }
+
+    template <typename Real>
+    auto Emitter<Real>::prepare_mask(const std::string& mask) -> void
+    {
+        auto l = _layers.find(mask);
+        if (l != _layers.end())
+        {
+            _operators << "        " << l->second << ".materialize();\n";
+        }
+    }
+
+    template <typename Real>
+    auto Emitter<Real>::begin_operator(const std::string& type, const std::string& construction) -> void
+    {
+        _operators << "    // " << type << "\n";
+        _operators << "    {\n";
+        _operators << "        " << construction << "\n";
+    }
+
+    template <typename Real>
+    auto Emitter<Real>::end_operator(const std::string& type, const std::string& call, const std::vector<std::string>& written) -> void
+    {
+        _operators << "        if (!" << call << ")\n";
+        _operators << "            std::cerr << \"Failed to apply operator of type: " << type << "\\n\";\n";
+        // Written layers and masks drop their tile summaries, as the generator does
+        for (const std::string& variable : written)
+        {
+            _operators << "        " << variable << ".invalidate();\n";
+        }
+        _operators << "    }\n";
+    }
+}
@@ -0,0 +1,46 @@
+// largemap.cpp
+// Checks that operators reach rows of a layer past 2^31 samples
+// The layer is mapped without reserving memory, and a mask confines the operator to the first and last rows,
+// so only the pages of those rows are ever touched and the check runs on machines with far less than the 8 GB the layer spans
+// Copyright Laurence Emms 2017
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <sys/mman.h>
+#include "../generator/layer.h"
+#include "../generator/mask.h"
+#include "../generator/maddop.h"
+
+int main()
+{
+    // 65536 x 32769 samples, one row more than 2^31
+    const size_t width{65536};
+    const size_t height{32769};
+    const size_t bytes{width * height * sizeof(float)};
+    void* pages{mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0)};
+    if (pages == MAP_FAILED)
+    {
+        std::cerr << "Unable to map " << bytes << " bytes.\n";
+        return 1;
+    }
+    bluedot::Layer<float> layer{width, height, 1, std::unique_ptr<float[], bluedot::Deallocator>{static_cast<float*>(pages), bluedot::Deallocator{0, bytes}}};
+
+    bluedot::MaskLayer<float> mask{width, height, bluedot::MaskFormat::bit};
+    for (size_t x{0}; x < width; ++x)
+    {
+        mask.set(x, 0, 1.0f);
+        mask.set(x, height - 1, 1.0f);
+    }
+    mask.invalidate();
+
+    bluedot::MADDOperator<float> madd{{1.0f}, 1.0f, 1.0f};
+    madd(layer, bluedot::MaskView<float>{mask});
+
+    const bool first{layer(0, 0, 0) == 1.0f && layer(width - 1, 0, 0) == 1.0f};
+    const bool skipped{layer(width - 1, height - 2, 0) == 0.0f};
+    const bool last{layer(0, height - 1, 0) == 1.0f && layer(width - 1, height - 1, 0) == 1.0f};
+    std::cout << "First row " << (first ? "ok" : "wrong") << ", unmasked rows " << (skipped ? "ok" : "wrong")
+              << ", last row " << (last ? "ok" : "wrong") << ".\n";
+    return first && skipped && last ? 0 : 1;
+}
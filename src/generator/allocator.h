@@ -0,0 +1,40 @@
+// allocator.h
+// Allocation policy for layer storage
+// Copyright Laurence Emms 2017
+
+#pragma once
+#include <cstddef>
+
+namespace bluedot {
+    class Allocator {
+    public:
+        // alignment: byte alignment of the storage, at least the size of a cache line for aligned SIMD loads
+        // huge_pages: ask the kernel to back large allocations with transparent huge pages, to cut TLB misses
+        // initialize: zero the storage, which can be skipped when the first operator overwrites every sample
+        Allocator(size_t alignment = 64, bool huge_pages = true, bool initialize = true);
+        template <typename Real>
+        auto allocate(size_t count) const -> Real*;
+        static auto deallocate(void* pointer) -> void;
+        auto alignment() const -> size_t;
+        auto huge_pages() const -> bool;
+        auto initialize() const -> bool;
+    private:
+        auto allocate_bytes(size_t bytes) const -> void*;
+        size_t _alignment;
+        bool _huge_pages;
+        bool _initialize;
+    };
+
+    // Frees storage from an Allocator, or unmaps storage mapped from a file
+    class Deallocator {
+    public:
+        // offset: bytes of the mapping before the storage, length: bytes mapped, zero for allocated storage
+        inline Deallocator(size_t offset = 0, size_t length = 0);
+        inline auto operator()(void* pointer) const -> void;
+    private:
+        size_t _offset;
+        size_t _length;
+    };
+}
+
+#include "allocator.hpp"
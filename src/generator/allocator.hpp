@@ -0,0 +1,106 @@
+// allocator.hpp
+// Copyright Laurence Emms 2017
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#if defined(_WIN32)
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace bluedot {
+    inline Allocator::Allocator(size_t alignment, bool huge_pages, bool initialize) :
+        _alignment(std::max(alignment, sizeof(void*))), _huge_pages(huge_pages), _initialize(initialize)
+    {
+        // Round the alignment up to a power of two
+        size_t power{sizeof(void*)};
+        while (power < _alignment)
+        {
+            power *= 2;
+        }
+        _alignment = power;
+    }
+
+    template <typename Real>
+    auto Allocator::allocate(size_t count) const -> Real*
+    {
+        // Storage is left default initialized, the layer decides whether to zero it
+        return static_cast<Real*>(allocate_bytes(count * sizeof(Real)));
+    }
+
+    inline auto Allocator::allocate_bytes(size_t bytes) const -> void*
+    {
+        const size_t huge_page_size{2 * 1024 * 1024};
+        size_t alignment{_alignment};
+        if (_huge_pages && bytes >= huge_page_size)
+        {
+            // Huge pages can only back whole, aligned 2MB ranges
+            alignment = std::max(alignment, huge_page_size);
+        }
+        bytes = std::max(bytes, alignment);
+
+        void* pointer{nullptr};
+#if defined(_WIN32)
+        pointer = _aligned_malloc(bytes, alignment);
+#else
+        if (posix_memalign(&pointer, alignment, bytes) != 0)
+        {
+            pointer = nullptr;
+        }
+#endif
+        if (!pointer)
+        {
+            throw std::bad_alloc{};
+        }
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        if (_huge_pages && bytes >= huge_page_size)
+        {
+            // Only a hint, the allocation is still valid if transparent huge pages are disabled
+            madvise(pointer, bytes, MADV_HUGEPAGE);
+        }
+#endif
+        return pointer;
+    }
+
+    inline auto Allocator::deallocate(void* pointer) -> void
+    {
+#if defined(_WIN32)
+        _aligned_free(pointer);
+#else
+        free(pointer);
+#endif
+    }
+
+    inline auto Allocator::alignment() const -> size_t
+    {
+        return _alignment;
+    }
+
+    inline auto Allocator::huge_pages() const -> bool
+    {
+        return _huge_pages;
+    }
+
+    inline auto Allocator::initialize() const -> bool
+    {
+        return _initialize;
+    }
+
+    Deallocator::Deallocator(size_t offset, size_t length) : _offset(offset), _length(length)
+    {
+    }
+
+    auto Deallocator::operator()(void* pointer) const -> void
+    {
+#if !defined(_WIN32)
+        if (_length > 0)
+        {
+            munmap(static_cast<char*>(pointer) - _offset, _length);
+            return;
+        }
+#endif
+        Allocator::deallocate(pointer);
+    }
+}
@@ -14,7 +14,9 @@ namespace bluedot {
                              Real scale = static_cast<Real>(1.0),
                              Real offset = static_cast<Real>(0.0));
         virtual auto operator()(Layer<Real>& layer) -> bool;
-        virtual auto operator()(Layer<Real>& layer, Layer<Real>& mask) -> bool;
+        virtual auto operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool;
+        virtual auto writes(size_t channels) const -> std::vector<bool>;
+        virtual auto reads(const std::vector<bool>& needed) const -> std::vector<bool>;
     private:
         std::vector<Real> _multiplier;
         Real _scale;
@@ -1,6 +1,10 @@
 // alphatocolorop.hpp
 // Copyright Laurence Emms 2017
 
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
 namespace bluedot {
     template <typename Real>
     AlphaToColorOperator<Real>::AlphaToColorOperator(const std::vector<Real>& multiplier, Real scale, Real offset) : _multiplier(multiplier), _scale(scale), _offset(offset)
@@ -12,21 +16,25 @@ namespace bluedot {
     {
         assert(layer.channels() > 1);
 
-        int num_samples = static_cast<int>(layer.width() * layer.height());
-#pragma omp parallel for schedule(guided)
-        for (int s{0}; s < num_samples; ++s)
+        const size_t width{layer.width()};
+        const int64_t height{static_cast<int64_t>(layer.height())};
+        const auto live = this->live_list(layer.channels(), 1);
+#pragma omp parallel for schedule(static)
+        for (int64_t row = 0; row < height; ++row)
         {
-            size_t x = static_cast<size_t>(s) % layer.width();
-            size_t y = static_cast<size_t>(s) / layer.width();
-            for (size_t c{1}; c < layer.channels(); ++c)
+            size_t y{static_cast<size_t>(row)};
+            for (size_t x{0}; x < width; ++x)
             {
-                Real value{layer(x, y, 0) * _scale};
-                if (c < _multiplier.size())
+                for (const size_t c : live)
                 {
-                    value *= _multiplier[c];
+                    Real value{layer(x, y, 0) * _scale};
+                    if (c < _multiplier.size())
+                    {
+                        value *= _multiplier[c];
+                    }
+                    value += _offset;
+                    layer(x, y, c) = value;
                 }
-                value += _offset;
-                layer(x, y, c) = value;
             }
         }
 
@@ -34,30 +42,63 @@ namespace bluedot {
     }
 
     template <typename Real>
-    auto AlphaToColorOperator<Real>::operator()(Layer<Real>& layer, Layer<Real>& mask) -> bool
+    auto AlphaToColorOperator<Real>::operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool
     {
         assert(layer.channels() > 1);
-        assert(mask.channels() > 0);
 
-        int num_samples = static_cast<int>(layer.width() * layer.height());
-#pragma omp parallel for schedule(guided)
-        for (int s{0}; s < num_samples; ++s)
+        const Tiles<Real>& tiles{mask.tiles()};
+        const size_t width{layer.width()};
+        const int64_t height{static_cast<int64_t>(layer.height())};
+        const auto live = this->live_list(layer.channels(), 1);
+#pragma omp parallel for schedule(static)
+        for (int64_t row = 0; row < height; ++row)
         {
-            size_t x = static_cast<size_t>(s) % layer.width();
-            size_t y = static_cast<size_t>(s) / layer.width();
-            for (size_t c{1}; c < layer.channels(); ++c)
+            size_t y{static_cast<size_t>(row)};
+            for (size_t begin{0}; begin < width; begin += Tiles<Real>::size)
             {
-                Real value{layer(x, y, 0) * _scale};
-                if (c < _multiplier.size())
+                const Coverage coverage{tiles.coverage(begin, y)};
+                if (coverage == Coverage::none)
+                {
+                    continue;
+                }
+                const size_t end{std::min(width, begin + Tiles<Real>::size)};
+                for (size_t x{begin}; x < end; ++x)
                 {
-                    value *= _multiplier[c];
+                    for (const size_t c : live)
+                    {
+                        Real value{layer(x, y, 0) * _scale};
+                        if (c < _multiplier.size())
+                        {
+                            value *= _multiplier[c];
+                        }
+                        value += _offset;
+                        if (coverage == Coverage::full)
+                        {
+                            layer(x, y, c) = value;
+                        }
+                        else
+                        {
+                            Real t{mask(x, y)};
+                            layer(x, y, c) = (static_cast<Real>(1.0) - t) * layer(x, y, c) + t * value;
+                        }
+                    }
                 }
-                value += _offset;
-                Real t{mask(x, y, 0)};
-                layer(x, y, c) = (static_cast<Real>(1.0) - t) * layer(x, y, c) + t * value;
             }
         }
 
         return true;
     }
+
+    template <typename Real>
+    auto AlphaToColorOperator<Real>::writes(size_t channels) const -> std::vector<bool>
+    {
+        return channel_range(channels, 1, channels);
+    }
+
+    template <typename Real>
+    auto AlphaToColorOperator<Real>::reads(const std::vector<bool>& needed) const -> std::vector<bool>
+    {
+        // The color channels are computed from alpha
+        return channel_range(needed.size(), 0, any_channel(needed) ? 1 : 0);
+    }
 }
\ No newline at end of file
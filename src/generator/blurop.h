@@ -0,0 +1,32 @@
+// blurop.h
+// Separable gaussian blur operator
+// Copyright Laurence Emms 2017
+
+#pragma once
+#include "op.h"
+#include "layer.h"
+#include "stencil.h"
+
+namespace bluedot {
+    template <typename Real>
+    class BlurOperator : public UnaryOperator<Real> {
+    public:
+        BlurOperator(size_t radius,
+                     Real sigma,
+                     const std::vector<Real>& multiplier = {static_cast<Real>(0.0), static_cast<Real>(0.0), static_cast<Real>(0.0), static_cast<Real>(0.0)},
+                     Real scale = static_cast<Real>(1.0),
+                     Real offset = static_cast<Real>(0.0),
+                     bool spherical = true);
+        virtual auto operator()(Layer<Real>& layer) -> bool;
+        virtual auto operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool;
+        virtual auto footprint() const -> Footprint;
+    private:
+        auto blur(Layer<Real>& layer, const MaskView<Real>* mask) const -> void;
+        Stencil<Real> _kernel;
+        std::vector<Real> _multiplier;
+        Real _scale;
+        Real _offset;
+    };
+}
+
+#include "blurop.hpp"
@@ -0,0 +1,84 @@
+// blurop.hpp
+// Copyright Laurence Emms 2017
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+namespace bluedot {
+    template <typename Real>
+    BlurOperator<Real>::BlurOperator(size_t radius, Real sigma, const std::vector<Real>& multiplier, Real scale, Real offset, bool spherical) :
+        _kernel(Stencil<Real>::gaussian(radius, sigma), spherical), _multiplier(multiplier), _scale(scale), _offset(offset)
+    {
+    }
+
+    template <typename Real>
+    auto BlurOperator<Real>::operator()(Layer<Real>& layer) -> bool
+    {
+        blur(layer, nullptr);
+        return true;
+    }
+
+    template <typename Real>
+    auto BlurOperator<Real>::operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool
+    {
+        blur(layer, &mask);
+        return true;
+    }
+
+    template <typename Real>
+    auto BlurOperator<Real>::blur(Layer<Real>& layer, const MaskView<Real>* mask) const -> void
+    {
+        const Tiles<Real>* tiles{mask ? &mask->tiles() : nullptr};
+        const size_t width{layer.width()};
+        Layer<Real> rows{width, layer.height(), 1};
+        Layer<Real> blurred{width, layer.height(), 1};
+        ChannelView<Real> rows_view{rows, 0};
+        ChannelView<Real> blurred_view{blurred, 0};
+
+        for (size_t c{0}; c < layer.channels(); ++c)
+        {
+            if (!this->live(c))
+                continue;
+            ChannelView<Real> channel{layer, c};
+            _kernel.horizontal(channel, rows_view);
+            _kernel.vertical(rows_view, blurred_view);
+
+            Real multiplier{c < _multiplier.size() ? _multiplier[c] : static_cast<Real>(1.0)};
+            const int64_t height{static_cast<int64_t>(layer.height())};
+#pragma omp parallel for schedule(static)
+            for (int64_t row = 0; row < height; ++row)
+            {
+                size_t y{static_cast<size_t>(row)};
+                for (size_t begin{0}; begin < width; begin += Tiles<Real>::size)
+                {
+                    const Coverage coverage{tiles ? tiles->coverage(begin, y) : Coverage::full};
+                    if (coverage == Coverage::none)
+                    {
+                        continue;
+                    }
+                    const size_t end{std::min(width, begin + Tiles<Real>::size)};
+                    for (size_t x{begin}; x < end; ++x)
+                    {
+                        Real value{blurred(x, y, 0) * _scale * multiplier + _offset};
+                        if (coverage == Coverage::partial)
+                        {
+                            Real t{(*mask)(x, y)};
+                            layer(x, y, c) = (static_cast<Real>(1.0) - t) * layer(x, y, c) + t * value;
+                        }
+                        else
+                        {
+                            layer(x, y, c) = value;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    template <typename Real>
+    auto BlurOperator<Real>::footprint() const -> Footprint
+    {
+        return Footprint{_kernel.radius(), _kernel.spherical(), false};
+    }
+}
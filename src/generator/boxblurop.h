@@ -0,0 +1,33 @@
+// boxblurop.h
+// Box blur operator
+// Applies one or more box filter passes built on running sums, so wide radii cost no more than narrow ones
+// Three passes closely approximate a gaussian blur
+// Copyright Laurence Emms 2017
+
+#pragma once
+#include "op.h"
+#include "layer.h"
+#include "boxfilter.h"
+
+namespace bluedot {
+    template <typename Real>
+    class BoxBlurOperator : public UnaryOperator<Real> {
+    public:
+        BoxBlurOperator(const std::vector<size_t>& radii,
+                        const std::vector<Real>& multiplier = {static_cast<Real>(0.0), static_cast<Real>(0.0), static_cast<Real>(0.0), static_cast<Real>(0.0)},
+                        Real scale = static_cast<Real>(1.0),
+                        Real offset = static_cast<Real>(0.0),
+                        bool spherical = true);
+        virtual auto operator()(Layer<Real>& layer) -> bool;
+        virtual auto operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool;
+        virtual auto footprint() const -> Footprint;
+    private:
+        auto blur(Layer<Real>& layer, const MaskView<Real>* mask) const -> void;
+        std::vector<BoxFilter<Real>> _passes;
+        std::vector<Real> _multiplier;
+        Real _scale;
+        Real _offset;
+    };
+}
+
+#include "boxblurop.hpp"
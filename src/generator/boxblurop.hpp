@@ -0,0 +1,108 @@
+// boxblurop.hpp
+// Copyright Laurence Emms 2017
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+namespace bluedot {
+    template <typename Real>
+    BoxBlurOperator<Real>::BoxBlurOperator(const std::vector<size_t>& radii, const std::vector<Real>& multiplier, Real scale, Real offset, bool spherical) :
+        _multiplier(multiplier), _scale(scale), _offset(offset)
+    {
+        for (size_t radius : radii)
+        {
+            _passes.push_back(BoxFilter<Real>{radius, spherical});
+        }
+        if (_passes.empty())
+        {
+            _passes.push_back(BoxFilter<Real>{0, spherical});
+        }
+    }
+
+    template <typename Real>
+    auto BoxBlurOperator<Real>::operator()(Layer<Real>& layer) -> bool
+    {
+        blur(layer, nullptr);
+        return true;
+    }
+
+    template <typename Real>
+    auto BoxBlurOperator<Real>::operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool
+    {
+        blur(layer, &mask);
+        return true;
+    }
+
+    template <typename Real>
+    auto BoxBlurOperator<Real>::blur(Layer<Real>& layer, const MaskView<Real>* mask) const -> void
+    {
+        const Tiles<Real>* tiles{mask ? &mask->tiles() : nullptr};
+        const size_t width{layer.width()};
+        Layer<Real> rows{width, layer.height(), 1};
+        Layer<Real> blurred{width, layer.height(), 1};
+        ChannelView<Real> rows_view{rows, 0};
+        ChannelView<Real> blurred_view{blurred, 0};
+
+        for (size_t c{0}; c < layer.channels(); ++c)
+        {
+            if (!this->live(c))
+                continue;
+            ChannelView<Real> channel{layer, c};
+            for (size_t p{0}; p < _passes.size(); ++p)
+            {
+                if (p == 0)
+                {
+                    _passes[p].horizontal(channel, rows_view);
+                }
+                else
+                {
+                    _passes[p].horizontal(blurred_view, rows_view);
+                }
+                _passes[p].vertical(rows_view, blurred_view);
+            }
+
+            Real multiplier{c < _multiplier.size() ? _multiplier[c] : static_cast<Real>(1.0)};
+            const int64_t height{static_cast<int64_t>(layer.height())};
+#pragma omp parallel for schedule(static)
+            for (int64_t row = 0; row < height; ++row)
+            {
+                size_t y{static_cast<size_t>(row)};
+                for (size_t begin{0}; begin < width; begin += Tiles<Real>::size)
+                {
+                    const Coverage coverage{tiles ? tiles->coverage(begin, y) : Coverage::full};
+                    if (coverage == Coverage::none)
+                    {
+                        continue;
+                    }
+                    const size_t end{std::min(width, begin + Tiles<Real>::size)};
+                    for (size_t x{begin}; x < end; ++x)
+                    {
+                        Real value{blurred(x, y, 0) * _scale * multiplier + _offset};
+                        if (coverage == Coverage::partial)
+                        {
+                            Real t{(*mask)(x, y)};
+                            layer(x, y, c) = (static_cast<Real>(1.0) - t) * layer(x, y, c) + t * value;
+                        }
+                        else
+                        {
+                            layer(x, y, c) = value;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    template <typename Real>
+    auto BoxBlurOperator<Real>::footprint() const -> Footprint
+    {
+        // Each pass widens the window by its radius
+        size_t radius{0};
+        for (const BoxFilter<Real>& pass : _passes)
+        {
+            radius += pass.radius();
+        }
+        return Footprint{radius, _passes.front().spherical(), false};
+    }
+}
@@ -0,0 +1,34 @@
+// boxfilter.h
+// Box filter passes over a single channel built on running sums
+// The cost per sample is constant whatever the radius.
+// In x the window wraps around when spherical is set and clamps to the edge otherwise.
+// In y the window always clamps to the poles.
+// Copyright Laurence Emms 2017
+
+#pragma once
+#include <vector>
+#include "layer.h"
+#include "stencil.h"
+
+namespace bluedot {
+    template <typename Real>
+    class BoxFilter {
+    public:
+        BoxFilter(size_t radius, bool spherical = true);
+        auto radius() const -> size_t;
+        auto spherical() const -> bool;
+        // Averages each row of source over a window of 2 * radius + 1 samples
+        // source and destination may be the same view
+        auto horizontal(const ChannelView<Real>& source, ChannelView<Real>& destination) const -> void;
+        // Averages each column of source over a window of 2 * radius + 1 samples
+        // source and destination must not overlap
+        auto vertical(const ChannelView<Real>& source, ChannelView<Real>& destination) const -> void;
+        // Radii of successive box passes approximating a gaussian with the given sigma
+        static auto gaussian_radii(Real sigma, size_t passes) -> std::vector<size_t>;
+    private:
+        size_t _radius;
+        bool _spherical;
+    };
+}
+
+#include "boxfilter.hpp"
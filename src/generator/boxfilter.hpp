@@ -0,0 +1,185 @@
+// boxfilter.hpp
+// Copyright Laurence Emms 2017
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+
+namespace bluedot {
+    template <typename Real>
+    BoxFilter<Real>::BoxFilter(size_t radius, bool spherical) : _radius(radius), _spherical(spherical)
+    {
+    }
+
+    template <typename Real>
+    auto BoxFilter<Real>::radius() const -> size_t
+    {
+        return _radius;
+    }
+
+    template <typename Real>
+    auto BoxFilter<Real>::spherical() const -> bool
+    {
+        return _spherical;
+    }
+
+    template <typename Real>
+    auto BoxFilter<Real>::horizontal(const ChannelView<Real>& source, ChannelView<Real>& destination) const -> void
+    {
+        assert(source.width() == destination.width());
+        assert(source.height() == destination.height());
+
+        const size_t width{source.width()};
+        const size_t window{2 * _radius + 1};
+        const double normalize{1.0 / static_cast<double>(window)};
+        const size_t source_stride{source.stride()};
+        const size_t destination_stride{destination.stride()};
+
+        // When wrapping, the window covers cycles whole rows plus a partial run of remainder samples
+        // starting at column (x - radius) mod width
+        const size_t cycles{window / width};
+        const size_t remainder{window % width};
+        const size_t first_start{(width - _radius % width) % width};
+
+        const int64_t height{static_cast<int64_t>(source.height())};
+#pragma omp parallel
+        {
+            // Prefix sums over the row, repeated twice when wrapping so partial runs never need a modulo
+            std::vector<double> prefix((_spherical ? 2 * width : width) + 1);
+#pragma omp for schedule(static)
+            for (int64_t y = 0; y < height; ++y)
+            {
+                const Real* in{source.row(static_cast<size_t>(y))};
+                prefix[0] = 0.0;
+                for (size_t x{0}; x < width; ++x)
+                {
+                    prefix[x + 1] = prefix[x] + static_cast<double>(in[x * source_stride]);
+                }
+                const double total{prefix[width]};
+                const double first{static_cast<double>(in[0])};
+                const double last{static_cast<double>(in[(width - 1) * source_stride])};
+
+                Real* out{destination.row(static_cast<size_t>(y))};
+                if (_spherical)
+                {
+                    for (size_t x{0}; x < width; ++x)
+                    {
+                        prefix[width + x + 1] = prefix[width + x] + static_cast<double>(in[x * source_stride]);
+                    }
+                    size_t start{first_start};
+                    for (size_t x{0}; x < width; ++x)
+                    {
+                        double sum{static_cast<double>(cycles) * total + prefix[start + remainder] - prefix[start]};
+                        out[x * destination_stride] = static_cast<Real>(sum * normalize);
+                        start = (start + 1 == width) ? 0 : start + 1;
+                    }
+                }
+                else
+                {
+                    // Running sum of the row extended by its edge samples
+                    auto running_sum = [&](int64_t n) -> double
+                    {
+                        if (n <= 0)
+                            return static_cast<double>(n) * first;
+                        if (n >= static_cast<int64_t>(width))
+                            return total + static_cast<double>(n - static_cast<int64_t>(width)) * last;
+                        return prefix[static_cast<size_t>(n)];
+                    };
+                    const int64_t radius{static_cast<int64_t>(_radius)};
+                    for (size_t x{0}; x < width; ++x)
+                    {
+                        int64_t sx{static_cast<int64_t>(x)};
+                        double sum{running_sum(sx + radius + 1) - running_sum(sx - radius)};
+                        out[x * destination_stride] = static_cast<Real>(sum * normalize);
+                    }
+                }
+            }
+        }
+    }
+
+    template <typename Real>
+    auto BoxFilter<Real>::vertical(const ChannelView<Real>& source, ChannelView<Real>& destination) const -> void
+    {
+        assert(source.width() == destination.width());
+        assert(source.height() == destination.height());
+        assert(source.row(0) != destination.row(0));
+
+        const size_t width{source.width()};
+        const size_t height{source.height()};
+        const double normalize{1.0 / static_cast<double>(2 * _radius + 1)};
+        const size_t source_stride{source.stride()};
+        const size_t destination_stride{destination.stride()};
+
+        // Columns are processed in strips so each thread slides its window down contiguous runs of memory
+        const size_t strip_width{256};
+        const int64_t strips{static_cast<int64_t>((width + strip_width - 1) / strip_width)};
+#pragma omp parallel
+        {
+            std::vector<double> sum(strip_width);
+#pragma omp for schedule(static)
+            for (int64_t strip = 0; strip < strips; ++strip)
+            {
+                const size_t x0{static_cast<size_t>(strip) * strip_width};
+                const size_t columns{std::min(strip_width, width - x0)};
+                auto add_row = [&](size_t y, double weight)
+                {
+                    const Real* in{source.row(y) + x0 * source_stride};
+                    for (size_t i{0}; i < columns; ++i)
+                    {
+                        sum[i] += weight * static_cast<double>(in[i * source_stride]);
+                    }
+                };
+
+                // Window centered on row 0, with the rows above the pole clamped to row 0
+                std::fill(sum.begin(), sum.end(), 0.0);
+                add_row(0, static_cast<double>(_radius));
+                const size_t inside{std::min(_radius, height - 1)};
+                for (size_t y{0}; y <= inside; ++y)
+                {
+                    add_row(y, 1.0);
+                }
+                add_row(height - 1, static_cast<double>(_radius - inside));
+
+                for (size_t y{0}; y < height; ++y)
+                {
+                    Real* out{destination.row(y) + x0 * destination_stride};
+                    for (size_t i{0}; i < columns; ++i)
+                    {
+                        out[i * destination_stride] = static_cast<Real>(sum[i] * normalize);
+                    }
+                    if (y + 1 < height)
+                    {
+                        add_row(std::min(height - 1, y + _radius + 1), 1.0);
+                        add_row(y >= _radius ? y - _radius : 0, -1.0);
+                    }
+                }
+            }
+        }
+    }
+
+    template <typename Real>
+    auto BoxFilter<Real>::gaussian_radii(Real sigma, size_t passes) -> std::vector<size_t>
+    {
+        // c.f. Kovesi, Fast Almost-Gaussian Filtering
+        assert(passes > 0);
+        const double variance{static_cast<double>(sigma) * static_cast<double>(sigma)};
+        const double n{static_cast<double>(passes)};
+        double ideal{std::sqrt(12.0 * variance / n + 1.0)};
+        int64_t lower{static_cast<int64_t>(std::floor(ideal))};
+        if (lower % 2 == 0)
+            --lower;
+        lower = std::max(static_cast<int64_t>(1), lower);
+        const double l{static_cast<double>(lower)};
+        const double ideal_count{(12.0 * variance - n * l * l - 4.0 * n * l - 3.0 * n) / (-4.0 * l - 4.0)};
+        const size_t lower_count{static_cast<size_t>(std::max(0.0, std::min(n, std::round(ideal_count))))};
+
+        std::vector<size_t> radii(passes);
+        for (size_t p{0}; p < passes; ++p)
+        {
+            size_t size{static_cast<size_t>(p < lower_count ? lower : lower + 2)};
+            radii[p] = (size - 1) / 2;
+        }
+        return radii;
+    }
+}
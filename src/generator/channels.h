@@ -0,0 +1,47 @@
+// channels.h
+// Channel counts known at compile time
+// Operators dispatch once on the channel count of a layer, so that for the common counts of 1 to 4 channels
+// their per channel loops have a fixed trip count and unroll, and per channel values live in fixed size arrays.
+// Copyright Laurence Emms 2017
+
+#pragma once
+#include <array>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+namespace bluedot {
+    // Channel count fixed at compile time, which converts to size_t wherever a count is expected
+    template <size_t Count>
+    using Channels = std::integral_constant<size_t, Count>;
+
+    // Calls apply with Channels<1> to Channels<4>, or with the count itself for any other number of channels
+    template <typename Apply>
+    auto dispatch_channels(size_t channels, Apply apply) -> bool;
+
+    // Storage for one value per channel
+    template <typename Real>
+    auto channel_array(size_t channels) -> std::vector<Real>;
+
+    template <typename Real, size_t Count>
+    auto channel_array(Channels<Count>) -> std::array<Real, Count>;
+
+    // Multiplier of each channel, where channels the multiplier does not list are multiplied by 1
+    template <typename Real, typename Count>
+    auto expand_multiplier(const std::vector<Real>& multiplier, Count channels) -> decltype(channel_array<Real>(channels));
+
+    // Indices of some of the channels of a layer, so loops over the samples visit just those channels without testing each one
+    template <typename Indices>
+    struct ChannelList {
+        Indices indices;
+        size_t size;
+        auto begin() const -> const size_t* { return indices.data(); }
+        auto end() const -> const size_t* { return indices.data() + size; }
+    };
+
+    // Channels from first up to the given number of channels of a layer that are flagged, where channels past the end of the flags count as flagged
+    template <typename Count>
+    auto channel_list(const std::vector<bool>& flags, Count channels, size_t first = 0) -> ChannelList<decltype(channel_array<size_t>(channels))>;
+}
+
+#include "channels.hpp"
\ No newline at end of file
@@ -0,0 +1,59 @@
+// channels.hpp
+// Copyright Laurence Emms 2017
+
+namespace bluedot {
+    template <typename Apply>
+    auto dispatch_channels(size_t channels, Apply apply) -> bool
+    {
+        switch (channels)
+        {
+        case 1:
+            return apply(Channels<1>{});
+        case 2:
+            return apply(Channels<2>{});
+        case 3:
+            return apply(Channels<3>{});
+        case 4:
+            return apply(Channels<4>{});
+        default:
+            return apply(channels);
+        }
+    }
+
+    template <typename Real>
+    auto channel_array(size_t channels) -> std::vector<Real>
+    {
+        return std::vector<Real>(channels);
+    }
+
+    template <typename Real, size_t Count>
+    auto channel_array(Channels<Count>) -> std::array<Real, Count>
+    {
+        return std::array<Real, Count>{};
+    }
+
+    template <typename Real, typename Count>
+    auto expand_multiplier(const std::vector<Real>& multiplier, Count channels) -> decltype(channel_array<Real>(channels))
+    {
+        auto expanded = channel_array<Real>(channels);
+        for (size_t c{0}; c < channels; ++c)
+        {
+            expanded[c] = c < multiplier.size() ? multiplier[c] : static_cast<Real>(1.0);
+        }
+        return expanded;
+    }
+
+    template <typename Count>
+    auto channel_list(const std::vector<bool>& flags, Count channels, size_t first) -> ChannelList<decltype(channel_array<size_t>(channels))>
+    {
+        ChannelList<decltype(channel_array<size_t>(channels))> list{channel_array<size_t>(channels), 0};
+        for (size_t c{first}; c < channels; ++c)
+        {
+            if (c >= flags.size() || flags[c])
+            {
+                list.indices[list.size++] = c;
+            }
+        }
+        return list;
+    }
+}
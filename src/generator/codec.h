@@ -0,0 +1,43 @@
+// codec.h
+// Compressed samples of a layer
+// Each row is packed on its own, so rows are packed and unpacked in parallel with the operators' row schedule.
+// A sample is predicted by the sample of the same channel to its left, and only the bytes in which the two differ are kept,
+// with a four bit count of those bytes per sample. Smooth fields and sparse masks differ from their neighbours
+// in few bytes. Keeping fewer mantissa bits rounds the samples first, which makes the codec lossy and packs them tighter.
+// Copyright Laurence Emms 2017
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+namespace bluedot {
+    template <typename Real>
+    class PackedSamples {
+    public:
+        // Bits of a sample of the given type
+        using Bits = typename std::conditional<sizeof(Real) == 4, uint32_t, uint64_t>::type;
+        static_assert(sizeof(Real) == sizeof(Bits), "Only float and double samples can be packed");
+        // Mantissa bits of the type, which keeps every sample exactly
+        static constexpr size_t lossless{std::numeric_limits<Real>::digits - 1};
+
+        // Packs width * height samples of the given number of channels, laid out as in a layer
+        // bits: mantissa bits to keep, at most lossless
+        PackedSamples(const Real* samples, size_t width, size_t height, size_t channels, size_t bits = lossless);
+        // Writes the samples back to storage laid out as in a layer
+        auto unpack(Real* samples) const -> void;
+        // Bytes held by the packed rows
+        auto bytes() const -> size_t;
+    private:
+        size_t _width;
+        size_t _height;
+        size_t _channels;
+        // Low bits dropped from every sample
+        size_t _shift;
+        std::vector<std::vector<uint8_t>> _rows;
+    };
+}
+
+#include "codec.hpp"
\ No newline at end of file
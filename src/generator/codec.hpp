@@ -0,0 +1,99 @@
+// codec.hpp
+// Copyright Laurence Emms 2017
+
+#include <algorithm>
+#include <cstring>
+
+namespace bluedot {
+    template <typename Real>
+    constexpr size_t PackedSamples<Real>::lossless;
+
+    template <typename Real>
+    PackedSamples<Real>::PackedSamples(const Real* samples, size_t width, size_t height, size_t channels, size_t bits) :
+        _width(width), _height(height), _channels(channels), _shift(lossless - std::min(bits, lossless)), _rows(height)
+    {
+        const size_t count{width * channels};
+        const size_t shift{_shift};
+        const int64_t rows{static_cast<int64_t>(height)};
+#pragma omp parallel for schedule(static)
+        for (int64_t row = 0; row < rows; ++row)
+        {
+            const Real* in{samples + static_cast<size_t>(row) * count};
+            // The counts of bytes kept come first, two to a byte, followed by the bytes themselves
+            std::vector<uint8_t> packed((count + 1) / 2, 0);
+            for (size_t i{0}; i < count; ++i)
+            {
+                Bits bits;
+                std::memcpy(&bits, in + i, sizeof(Bits));
+                if (shift > 0)
+                {
+                    // Rounds to nearest, carrying into the exponent when the mantissa overflows
+                    bits = (bits + (static_cast<Bits>(1) << (shift - 1))) >> shift;
+                }
+                Bits predicted{0};
+                if (i >= channels)
+                {
+                    std::memcpy(&predicted, in + i - channels, sizeof(Bits));
+                    if (shift > 0)
+                        predicted = (predicted + (static_cast<Bits>(1) << (shift - 1))) >> shift;
+                }
+                Bits residual{bits ^ predicted};
+                uint8_t kept{0};
+                while (residual >> (8 * kept) != 0)
+                {
+                    packed.push_back(static_cast<uint8_t>(residual >> (8 * kept)));
+                    ++kept;
+                    if (kept == sizeof(Bits))
+                        break;
+                }
+                packed[i / 2] |= static_cast<uint8_t>(kept << (4 * (i % 2)));
+            }
+            packed.shrink_to_fit();
+            _rows[static_cast<size_t>(row)] = std::move(packed);
+        }
+    }
+
+    template <typename Real>
+    auto PackedSamples<Real>::unpack(Real* samples) const -> void
+    {
+        const size_t count{_width * _channels};
+        const size_t channels{_channels};
+        const size_t shift{_shift};
+        const int64_t rows{static_cast<int64_t>(_height)};
+#pragma omp parallel for schedule(static)
+        for (int64_t row = 0; row < rows; ++row)
+        {
+            const std::vector<uint8_t>& packed{_rows[static_cast<size_t>(row)]};
+            Real* out{samples + static_cast<size_t>(row) * count};
+            // Samples are unpacked shifted, each predicted by the shifted sample to its left
+            std::vector<Bits> previous(channels, 0);
+            size_t offset{(count + 1) / 2};
+            for (size_t i{0}; i < count; ++i)
+            {
+                const size_t kept{static_cast<size_t>(packed[i / 2] >> (4 * (i % 2))) & 15};
+                Bits residual{0};
+                for (size_t b{0}; b < kept; ++b)
+                {
+                    residual |= static_cast<Bits>(packed[offset + b]) << (8 * b);
+                }
+                offset += kept;
+                const size_t c{i % channels};
+                const Bits bits{residual ^ previous[c]};
+                previous[c] = bits;
+                const Bits value{bits << shift};
+                std::memcpy(out + i, &value, sizeof(Bits));
+            }
+        }
+    }
+
+    template <typename Real>
+    auto PackedSamples<Real>::bytes() const -> size_t
+    {
+        size_t bytes{0};
+        for (const std::vector<uint8_t>& row : _rows)
+        {
+            bytes += row.size();
+        }
+        return bytes;
+    }
+}
@@ -0,0 +1,38 @@
+// colorrampop.h
+// Color ramp operator
+// Maps a source channel through a piecewise linear gradient of color stops into the color channels,
+// and optionally the alpha channel, in a single pass
+// Copyright Laurence Emms 2017
+
+#pragma once
+#include "op.h"
+#include "layer.h"
+
+namespace bluedot {
+    template <typename Real>
+    class ColorRampOperator : public UnaryOperator<Real> {
+    public:
+        // Each color holds one value per channel, alpha first
+        ColorRampOperator(const std::vector<Real>& positions,
+                          const std::vector<std::vector<Real>>& colors,
+                          size_t channel = 0,
+                          bool alpha = false,
+                          size_t resolution = 1024);
+        virtual auto operator()(Layer<Real>& layer) -> bool;
+        virtual auto operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool;
+        virtual auto writes(size_t channels) const -> std::vector<bool>;
+        virtual auto reads(const std::vector<bool>& needed) const -> std::vector<bool>;
+    private:
+        auto ramp(Layer<Real>& layer, const MaskView<Real>* mask) const -> bool;
+        size_t _channel;
+        bool _alpha;
+        size_t _resolution;
+        size_t _channels;
+        Real _first;
+        Real _scale;
+        // Lookup table sampling the ramp at _resolution evenly spaced positions, one table per channel
+        std::vector<std::vector<Real>> _table;
+    };
+}
+
+#include "colorrampop.hpp"
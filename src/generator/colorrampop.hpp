@@ -0,0 +1,180 @@
+// colorrampop.hpp
+// Copyright Laurence Emms 2017
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <numeric>
+
+namespace bluedot {
+    template <typename Real>
+    ColorRampOperator<Real>::ColorRampOperator(const std::vector<Real>& positions, const std::vector<std::vector<Real>>& colors, size_t channel, bool alpha, size_t resolution) :
+        _channel(channel), _alpha(alpha), _resolution(std::max(static_cast<size_t>(2), resolution)), _channels(0), _first(static_cast<Real>(0.0)), _scale(static_cast<Real>(0.0))
+    {
+        assert(positions.size() == colors.size());
+        if (positions.empty())
+        {
+            return;
+        }
+
+        std::vector<size_t> order(positions.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return positions[a] < positions[b]; });
+        _channels = colors[order[0]].size();
+        for (size_t s : order)
+        {
+            _channels = std::min(_channels, colors[s].size());
+        }
+
+        _first = positions[order.front()];
+        const Real last{positions[order.back()]};
+        const Real span{last - _first};
+        _scale = span > static_cast<Real>(0.0) ? static_cast<Real>(_resolution - 1) / span : static_cast<Real>(0.0);
+
+        _table.assign(_channels, std::vector<Real>(_resolution));
+        size_t segment{0};
+        for (size_t i{0}; i < _resolution; ++i)
+        {
+            Real position{_first + span * static_cast<Real>(i) / static_cast<Real>(_resolution - 1)};
+            while (segment + 2 < order.size() && positions[order[segment + 1]] < position)
+            {
+                ++segment;
+            }
+            size_t s0{order[segment]};
+            size_t s1{order[std::min(segment + 1, order.size() - 1)]};
+            Real width{positions[s1] - positions[s0]};
+            Real t{width > static_cast<Real>(0.0) ? (position - positions[s0]) / width : static_cast<Real>(0.0)};
+            t = std::max(static_cast<Real>(0.0), std::min(static_cast<Real>(1.0), t));
+            for (size_t c{0}; c < _channels; ++c)
+            {
+                _table[c][i] = colors[s0][c] + t * (colors[s1][c] - colors[s0][c]);
+            }
+        }
+    }
+
+    template <typename Real>
+    auto ColorRampOperator<Real>::operator()(Layer<Real>& layer) -> bool
+    {
+        return ramp(layer, nullptr);
+    }
+
+    template <typename Real>
+    auto ColorRampOperator<Real>::operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool
+    {
+        return ramp(layer, &mask);
+    }
+
+    template <typename Real>
+    auto ColorRampOperator<Real>::ramp(Layer<Real>& layer, const MaskView<Real>* mask) const -> bool
+    {
+        if (_table.empty() || _channel >= layer.channels())
+        {
+            return false;
+        }
+
+        const Tiles<Real>* tiles{mask ? &mask->tiles() : nullptr};
+        const size_t width{layer.width()};
+        const size_t channels{layer.channels()};
+        const size_t first_channel{_alpha ? static_cast<size_t>(0) : static_cast<size_t>(1)};
+        const size_t last_channel{std::min(channels, _channels)};
+        const auto live = this->live_list(last_channel, first_channel);
+        const Real last_index{static_cast<Real>(_resolution - 1)};
+        const int64_t height{static_cast<int64_t>(layer.height())};
+#pragma omp parallel
+        {
+            std::vector<int32_t> index(width);
+            std::vector<Real> fraction(width);
+            std::vector<Real> color(width);
+            std::vector<Real> weight(width);
+#pragma omp for schedule(static)
+            for (int64_t row = 0; row < height; ++row)
+            {
+                size_t y{static_cast<size_t>(row)};
+                size_t begin{0};
+                while (begin < width)
+                {
+                    // Runs of tiles with the same coverage are ramped together
+                    const Coverage coverage{tiles ? tiles->coverage(begin, y) : Coverage::full};
+                    size_t end{tiles ? std::min(width, begin + Tiles<Real>::size) : width};
+                    while (end < width && tiles->coverage(end, y) == coverage)
+                    {
+                        end = std::min(width, end + Tiles<Real>::size);
+                    }
+                    const size_t count{end - begin};
+                    Real* samples{&layer(begin, y, 0)};
+                    const Real* source{samples + _channel};
+                    if (coverage == Coverage::none)
+                    {
+                        begin = end;
+                        continue;
+                    }
+
+                    // Positions in the table are computed for the whole run before any channel is written,
+                    // so the source channel may also be a destination
+                    int32_t* i{index.data()};
+                    Real* f{fraction.data()};
+#pragma omp simd
+                    for (size_t x = 0; x < count; ++x)
+                    {
+                        Real position{(source[x * channels] - _first) * _scale};
+                        position = std::max(static_cast<Real>(0.0), std::min(last_index, position));
+                        int32_t lower{std::min(static_cast<int32_t>(position), static_cast<int32_t>(_resolution - 2))};
+                        i[x] = lower;
+                        f[x] = position - static_cast<Real>(lower);
+                    }
+                    if (coverage == Coverage::partial)
+                    {
+                        for (size_t x{0}; x < count; ++x)
+                        {
+                            weight[x] = (*mask)(begin + x, y);
+                        }
+                    }
+
+                    for (const size_t c : live)
+                    {
+                        const Real* table{_table[c].data()};
+                        Real* r{color.data()};
+#pragma omp simd
+                        for (size_t x = 0; x < count; ++x)
+                        {
+                            Real lower{table[i[x]]};
+                            Real upper{table[i[x] + 1]};
+                            r[x] = lower + f[x] * (upper - lower);
+                        }
+                        if (coverage == Coverage::partial)
+                        {
+                            for (size_t x{0}; x < count; ++x)
+                            {
+                                Real t{weight[x]};
+                                samples[x * channels + c] = (static_cast<Real>(1.0) - t) * samples[x * channels + c] + t * r[x];
+                            }
+                        }
+                        else
+                        {
+                            for (size_t x{0}; x < count; ++x)
+                            {
+                                samples[x * channels + c] = r[x];
+                            }
+                        }
+                    }
+                    begin = end;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    template <typename Real>
+    auto ColorRampOperator<Real>::writes(size_t channels) const -> std::vector<bool>
+    {
+        return channel_range(channels, _alpha ? 0 : 1, _channels);
+    }
+
+    template <typename Real>
+    auto ColorRampOperator<Real>::reads(const std::vector<bool>& needed) const -> std::vector<bool>
+    {
+        // The ramp is looked up with the source channel
+        return channel_range(needed.size(), _channel, any_channel(needed) ? _channel + 1 : 0);
+    }
+}
@@ -1,6 +1,10 @@
 // colortoalphaop.hpp
 // Copyright Laurence Emms 2017
 
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
 namespace bluedot {
     template <typename Real>
     ColorToAlphaOperator<Real>::ColorToAlphaOperator(const std::vector<Real>& multiplier, Real scale, Real offset) : _multiplier(multiplier), _scale(scale), _offset(offset)
@@ -12,38 +16,42 @@ namespace bluedot {
     {
         assert(layer.channels() > 1);
 
-        int num_samples = static_cast<int>(layer.width() * layer.height());
-#pragma omp parallel for schedule(guided)
-        for (int s{0}; s < num_samples; ++s)
+        const size_t width{layer.width()};
+        const int64_t height{static_cast<int64_t>(layer.height())};
+        const auto live = this->live_list(layer.channels(), 1);
+#pragma omp parallel for schedule(static)
+        for (int64_t row = 0; row < height; ++row)
         {
-            size_t x = static_cast<size_t>(s) % layer.width();
-            size_t y = static_cast<size_t>(s) / layer.width();
-            Real min_value = layer(x, y, 1);
-            Real max_value = layer(x, y, 1);
-            if (layer.channels() > 1)
+            size_t y{static_cast<size_t>(row)};
+            for (size_t x{0}; x < width; ++x)
             {
-                for (size_t c{2}; c < layer.channels(); ++c)
+                Real min_value = layer(x, y, 1);
+                Real max_value = layer(x, y, 1);
+                if (layer.channels() > 1)
                 {
-                    Real value{layer(x, y, c)};
-                    if (value < min_value)
-                    {
-                        min_value = value;
-                    }
-                    if (value > max_value)
+                    for (size_t c{2}; c < layer.channels(); ++c)
                     {
-                        max_value = value;
+                        Real value{layer(x, y, c)};
+                        if (value < min_value)
+                        {
+                            min_value = value;
+                        }
+                        if (value > max_value)
+                        {
+                            max_value = value;
+                        }
                     }
                 }
-            }
-            for (size_t c{1}; c < layer.channels(); ++c)
-            {
-                Real value{(min_value + max_value) * static_cast<Real>(0.5) * _scale};
-                if (c < _multiplier.size())
+                for (const size_t c : live)
                 {
-                    value *= _multiplier[c];
+                    Real value{(min_value + max_value) * static_cast<Real>(0.5) * _scale};
+                    if (c < _multiplier.size())
+                    {
+                        value *= _multiplier[c];
+                    }
+                    value += _offset;
+                    layer(x, y, c) = value;
                 }
-                value += _offset;
-                layer(x, y, c) = value;
             }
         }
 
@@ -51,47 +59,80 @@ namespace bluedot {
     }
 
     template <typename Real>
-    auto ColorToAlphaOperator<Real>::operator()(Layer<Real>& layer, Layer<Real>& mask) -> bool
+    auto ColorToAlphaOperator<Real>::operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool
     {
         assert(layer.channels() > 1);
-        assert(mask.channels() > 0);
 
-        int num_samples = static_cast<int>(layer.width() * layer.height());
-#pragma omp parallel for schedule(guided)
-        for (int s{0}; s < num_samples; ++s)
+        const Tiles<Real>& tiles{mask.tiles()};
+        const size_t width{layer.width()};
+        const int64_t height{static_cast<int64_t>(layer.height())};
+        const auto live = this->live_list(layer.channels(), 1);
+#pragma omp parallel for schedule(static)
+        for (int64_t row = 0; row < height; ++row)
         {
-            size_t x = static_cast<size_t>(s) % layer.width();
-            size_t y = static_cast<size_t>(s) / layer.width();
-            Real min_value = layer(x, y, 1);
-            Real max_value = layer(x, y, 1);
-            if (layer.channels() > 1)
+            size_t y{static_cast<size_t>(row)};
+            for (size_t begin{0}; begin < width; begin += Tiles<Real>::size)
             {
-                for (size_t c{2}; c < layer.channels(); ++c)
+                const Coverage coverage{tiles.coverage(begin, y)};
+                if (coverage == Coverage::none)
+                {
+                    continue;
+                }
+                const size_t end{std::min(width, begin + Tiles<Real>::size)};
+                for (size_t x{begin}; x < end; ++x)
                 {
-                    Real value{layer(x, y, c)};
-                    if (value < min_value)
+                    Real min_value = layer(x, y, 1);
+                    Real max_value = layer(x, y, 1);
+                    if (layer.channels() > 1)
                     {
-                        min_value = value;
+                        for (size_t c{2}; c < layer.channels(); ++c)
+                        {
+                            Real value{layer(x, y, c)};
+                            if (value < min_value)
+                            {
+                                min_value = value;
+                            }
+                            if (value > max_value)
+                            {
+                                max_value = value;
+                            }
+                        }
                     }
-                    if (value > max_value)
+                    for (const size_t c : live)
                     {
-                        max_value = value;
+                        Real value{(min_value + max_value) * static_cast<Real>(0.5) * _scale};
+                        if (c < _multiplier.size())
+                        {
+                            value *= _multiplier[c];
+                        }
+                        value += _offset;
+                        if (coverage == Coverage::full)
+                        {
+                            layer(x, y, c) = value;
+                        }
+                        else
+                        {
+                            Real t{mask(x, y)};
+                            layer(x, y, c) = (static_cast<Real>(1.0) - t) * layer(x, y, c) + t * value;
+                        }
                     }
                 }
             }
-            for (size_t c{1}; c < layer.channels(); ++c)
-            {
-                Real value{(min_value + max_value) * static_cast<Real>(0.5) * _scale};
-                if (c < _multiplier.size())
-                {
-                    value *= _multiplier[c];
-                }
-                value += _offset;
-                Real t{mask(x, y, 0)};
-                layer(x, y, c) = (static_cast<Real>(1.0) - t) * layer(x, y, c) + t * value;
-            }
         }
 
         return true;
     }
+
+    template <typename Real>
+    auto ColorToAlphaOperator<Real>::writes(size_t channels) const -> std::vector<bool>
+    {
+        return channel_range(channels, 1, channels);
+    }
+
+    template <typename Real>
+    auto ColorToAlphaOperator<Real>::reads(const std::vector<bool>& needed) const -> std::vector<bool>
+    {
+        // Each color channel is computed from the range of all of them
+        return channel_range(needed.size(), 1, any_channel(needed) ? needed.size() : 0);
+    }
 }
@@ -0,0 +1,21 @@
+// copyop.h
+// Layer copy operation
+// Without a mask layer0 shares the storage of layer1 until either is written, so copying takes constant time
+// Copyright Laurence Emms 2017
+
+#pragma once
+#include "op.h"
+#include "layer.h"
+
+namespace bluedot {
+    template <typename Real>
+    class CopyOperator : public BinaryOperator<Real> {
+    public:
+        virtual auto operator()(Layer<Real>& layer0, Layer<Real>& layer1) -> bool;
+        virtual auto operator()(Layer<Real>& layer0, Layer<Real>& layer1, const MaskView<Real>& mask) -> bool;
+        virtual auto reads0(const std::vector<bool>& needed) const -> std::vector<bool>;
+        virtual auto moves_storage() const -> bool;
+    };
+}
+
+#include "copyop.hpp"
\ No newline at end of file
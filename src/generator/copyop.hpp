@@ -0,0 +1,76 @@
+// copyop.hpp
+// Copyright Laurence Emms 2017
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+namespace bluedot {
+    template <typename Real>
+    auto CopyOperator<Real>::operator()(Layer<Real>& layer0, Layer<Real>& layer1) -> bool
+    {
+        assert(layer0.width() == layer1.width());
+        assert(layer0.height() == layer1.height());
+        if (layer0.channels() != layer1.channels())
+            return false;
+
+        return layer0.share(layer1);
+    }
+
+    template <typename Real>
+    auto CopyOperator<Real>::operator()(Layer<Real>& layer0, Layer<Real>& layer1, const MaskView<Real>& mask) -> bool
+    {
+        assert(layer0.width() == layer1.width());
+        assert(layer0.height() == layer1.height());
+        if (layer0.channels() != layer1.channels())
+            return false;
+
+        const Tiles<Real>& tiles{mask.tiles()};
+        const size_t width{layer0.width()};
+        const int64_t height{static_cast<int64_t>(layer0.height())};
+        const auto live = this->live_list(layer0.channels());
+#pragma omp parallel for schedule(static)
+        for (int64_t row = 0; row < height; ++row)
+        {
+            size_t y{static_cast<size_t>(row)};
+            for (size_t begin{0}; begin < width; begin += Tiles<Real>::size)
+            {
+                const Coverage coverage{tiles.coverage(begin, y)};
+                if (coverage == Coverage::none)
+                {
+                    continue;
+                }
+                const size_t end{std::min(width, begin + Tiles<Real>::size)};
+                for (size_t x{begin}; x < end; ++x)
+                {
+                    for (const size_t c : live)
+                    {
+                        if (coverage == Coverage::full)
+                        {
+                            layer0(x, y, c) = layer1(x, y, c);
+                        }
+                        else
+                        {
+                            Real t{mask(x, y)};
+                            layer0(x, y, c) = (static_cast<Real>(1.0) - t) * layer0(x, y, c) + t * layer1(x, y, c);
+                        }
+                    }
+                }
+            }
+        }
+
+        return true;
+    }
+
+    template <typename Real>
+    auto CopyOperator<Real>::reads0(const std::vector<bool>& needed) const -> std::vector<bool>
+    {
+        return std::vector<bool>(needed.size(), false);
+    }
+
+    template <typename Real>
+    auto CopyOperator<Real>::moves_storage() const -> bool
+    {
+        return true;
+    }
+}
@@ -0,0 +1,39 @@
+// distancetransformop.h
+// Distance transform operator
+// Computes the exact euclidean distance, in samples, from each sample to the nearest sample
+// whose source channel is greater than level, and stores it in all channels
+// c.f. Distance Transforms of Sampled Functions by Pedro F. Felzenszwalb & Daniel P. Huttenlocher
+// Copyright Laurence Emms 2017
+
+#pragma once
+#include "op.h"
+#include "layer.h"
+
+namespace bluedot {
+    template <typename Real>
+    class DistanceTransformOperator : public UnaryOperator<Real> {
+    public:
+        DistanceTransformOperator(size_t channel = 0,
+                                  Real level = static_cast<Real>(0.0),
+                                  const std::vector<Real>& multiplier = {static_cast<Real>(0.0), static_cast<Real>(0.0), static_cast<Real>(0.0), static_cast<Real>(0.0)},
+                                  Real scale = static_cast<Real>(1.0),
+                                  Real offset = static_cast<Real>(0.0),
+                                  bool spherical = true);
+        virtual auto operator()(Layer<Real>& layer) -> bool;
+        virtual auto operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool;
+        virtual auto footprint() const -> Footprint;
+        virtual auto reads(const std::vector<bool>& needed) const -> std::vector<bool>;
+    private:
+        auto distance(Layer<Real>& layer, const MaskView<Real>* mask) const -> bool;
+        // Squared distance transform of the sampled function f, in one dimension
+        static auto transform(const double* f, double* d, size_t n, std::vector<size_t>& v, std::vector<double>& z) -> void;
+        size_t _channel;
+        Real _level;
+        std::vector<Real> _multiplier;
+        Real _scale;
+        Real _offset;
+        bool _spherical;
+    };
+}
+
+#include "distancetransformop.hpp"
@@ -0,0 +1,208 @@
+// distancetransformop.hpp
+// Copyright Laurence Emms 2017
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace bluedot {
+    template <typename Real>
+    DistanceTransformOperator<Real>::DistanceTransformOperator(size_t channel, Real level, const std::vector<Real>& multiplier, Real scale, Real offset, bool spherical) :
+        _channel(channel), _level(level), _multiplier(multiplier), _scale(scale), _offset(offset), _spherical(spherical)
+    {
+    }
+
+    template <typename Real>
+    auto DistanceTransformOperator<Real>::operator()(Layer<Real>& layer) -> bool
+    {
+        return distance(layer, nullptr);
+    }
+
+    template <typename Real>
+    auto DistanceTransformOperator<Real>::operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool
+    {
+        return distance(layer, &mask);
+    }
+
+    template <typename Real>
+    auto DistanceTransformOperator<Real>::transform(const double* f, double* d, size_t n, std::vector<size_t>& v, std::vector<double>& z) -> void
+    {
+        // Lower envelope of the parabolas rooted at each sample
+        const double infinity{std::numeric_limits<double>::infinity()};
+        size_t k{0};
+        v[0] = 0;
+        z[0] = -infinity;
+        z[1] = infinity;
+        for (size_t q{1}; q < n; ++q)
+        {
+            const double fq{f[q] + static_cast<double>(q) * static_cast<double>(q)};
+            auto intersection = [&](size_t p) -> double
+            {
+                double dp{static_cast<double>(p)};
+                return (fq - (f[p] + dp * dp)) / (2.0 * static_cast<double>(q) - 2.0 * dp);
+            };
+            double s{intersection(v[k])};
+            while (s <= z[k])
+            {
+                --k;
+                s = intersection(v[k]);
+            }
+            ++k;
+            v[k] = q;
+            z[k] = s;
+            z[k + 1] = infinity;
+        }
+
+        k = 0;
+        for (size_t q{0}; q < n; ++q)
+        {
+            while (z[k + 1] < static_cast<double>(q))
+                ++k;
+            double delta{static_cast<double>(q) - static_cast<double>(v[k])};
+            d[q] = delta * delta + f[v[k]];
+        }
+    }
+
+    template <typename Real>
+    auto DistanceTransformOperator<Real>::distance(Layer<Real>& layer, const MaskView<Real>* mask) const -> bool
+    {
+        if (_channel >= layer.channels())
+        {
+            return false;
+        }
+        // The transform is skipped when no channel it writes is read later
+        bool needed{false};
+        for (size_t c{0}; c < layer.channels(); ++c)
+        {
+            needed = needed || this->live(c);
+        }
+        if (!needed)
+        {
+            return true;
+        }
+
+        const Tiles<Real>* tiles{mask ? &mask->tiles() : nullptr};
+        const size_t width{layer.width()};
+        const size_t height{layer.height()};
+        // Finite stand in for infinity, larger than any squared distance on the map
+        const double far{4.0 * (static_cast<double>(width) * static_cast<double>(width) + static_cast<double>(height) * static_cast<double>(height)) + 1.0};
+        const double max_distance{std::sqrt(static_cast<double>(width) * static_cast<double>(width) + static_cast<double>(height) * static_cast<double>(height))};
+        Layer<double> squared{width, height, 1};
+
+        // Rows: when spherical, the nearest feature is at most width / 2 away around the wrap,
+        // so each row is transformed with half a row of wrapped samples on either side
+        const size_t pad{_spherical ? width / 2 + 1 : 0};
+        const size_t extended{width + 2 * pad};
+        const int64_t rows{static_cast<int64_t>(height)};
+#pragma omp parallel
+        {
+            std::vector<double> f(extended);
+            std::vector<double> d(extended);
+            std::vector<size_t> v(extended);
+            std::vector<double> z(extended + 1);
+            std::vector<double> features(width);
+#pragma omp for schedule(static)
+            for (int64_t row = 0; row < rows; ++row)
+            {
+                size_t y{static_cast<size_t>(row)};
+                for (size_t x{0}; x < width; ++x)
+                {
+                    features[x] = layer(x, y, _channel) > _level ? 0.0 : far;
+                }
+                size_t x{(width - pad % width) % width};
+                for (size_t i{0}; i < extended; ++i)
+                {
+                    f[i] = features[x];
+                    x = (x + 1 == width) ? 0 : x + 1;
+                }
+                transform(f.data(), d.data(), extended, v, z);
+                std::copy(d.begin() + pad, d.begin() + pad + width, &squared(0, y, 0));
+            }
+        }
+
+        // Columns: gathered a strip at a time so each pass over the rows reads whole cache lines
+        const size_t strip_width{8};
+        const int64_t strips{static_cast<int64_t>((width + strip_width - 1) / strip_width)};
+#pragma omp parallel
+        {
+            std::vector<double> f(strip_width * height);
+            std::vector<double> d(height);
+            std::vector<size_t> v(height);
+            std::vector<double> z(height + 1);
+#pragma omp for schedule(static)
+            for (int64_t strip = 0; strip < strips; ++strip)
+            {
+                const size_t x0{static_cast<size_t>(strip) * strip_width};
+                const size_t columns{std::min(strip_width, width - x0)};
+                for (size_t y{0}; y < height; ++y)
+                {
+                    for (size_t i{0}; i < columns; ++i)
+                    {
+                        f[i * height + y] = squared(x0 + i, y, 0);
+                    }
+                }
+                for (size_t i{0}; i < columns; ++i)
+                {
+                    transform(&f[i * height], d.data(), height, v, z);
+                    for (size_t y{0}; y < height; ++y)
+                    {
+                        squared(x0 + i, y, 0) = d[y];
+                    }
+                }
+            }
+        }
+
+        const auto live = this->live_list(layer.channels());
+        const auto multiplier = expand_multiplier(_multiplier, layer.channels());
+#pragma omp parallel for schedule(static)
+        for (int64_t row = 0; row < rows; ++row)
+        {
+            size_t y{static_cast<size_t>(row)};
+            for (size_t begin{0}; begin < width; begin += Tiles<Real>::size)
+            {
+                const Coverage coverage{tiles ? tiles->coverage(begin, y) : Coverage::full};
+                if (coverage == Coverage::none)
+                {
+                    continue;
+                }
+                const size_t end{std::min(width, begin + Tiles<Real>::size)};
+                for (size_t x{begin}; x < end; ++x)
+                {
+                    Real distance{static_cast<Real>(std::min(std::sqrt(squared(x, y, 0)), max_distance))};
+                    Real t{coverage == Coverage::partial ? (*mask)(x, y) : static_cast<Real>(1.0)};
+                    for (const size_t c : live)
+                    {
+                        Real value{distance * _scale * multiplier[c]};
+                        value += _offset;
+                        if (coverage == Coverage::partial)
+                        {
+                            layer(x, y, c) = (static_cast<Real>(1.0) - t) * layer(x, y, c) + t * value;
+                        }
+                        else
+                        {
+                            layer(x, y, c) = value;
+                        }
+                    }
+                }
+            }
+        }
+
+        return true;
+    }
+
+    template <typename Real>
+    auto DistanceTransformOperator<Real>::footprint() const -> Footprint
+    {
+        // The nearest selected sample may be anywhere in the layer
+        return Footprint{0, true, true};
+    }
+
+    template <typename Real>
+    auto DistanceTransformOperator<Real>::reads(const std::vector<bool>& needed) const -> std::vector<bool>
+    {
+        // Every channel is computed from the distance to the samples of the source channel
+        return channel_range(needed.size(), _channel, any_channel(needed) ? _channel + 1 : 0);
+    }
+}
@@ -0,0 +1,27 @@
+// equalizeop.h
+// Histogram equalization operator
+// Maps the color channels through their cumulative histogram, spreading them evenly over the range 0-1
+// Copyright Laurence Emms 2017
+
+#pragma once
+#include "op.h"
+#include "layer.h"
+#include "histogram.h"
+
+namespace bluedot {
+    template <typename Real>
+    class EqualizeOperator : public UnaryOperator<Real> {
+    public:
+        EqualizeOperator(size_t bins = 4096);
+        virtual auto operator()(Layer<Real>& layer) -> bool;
+        virtual auto operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool;
+        virtual auto footprint() const -> Footprint;
+        virtual auto writes(size_t channels) const -> std::vector<bool>;
+        virtual auto reads(const std::vector<bool>& needed) const -> std::vector<bool>;
+    private:
+        auto equalize(Layer<Real>& layer, const MaskView<Real>* mask) const -> void;
+        size_t _bins;
+    };
+}
+
+#include "equalizeop.hpp"
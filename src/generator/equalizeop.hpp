@@ -0,0 +1,89 @@
+// equalizeop.hpp
+// Copyright Laurence Emms 2017
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+namespace bluedot {
+    template <typename Real>
+    EqualizeOperator<Real>::EqualizeOperator(size_t bins) : _bins(bins)
+    {
+    }
+
+    template <typename Real>
+    auto EqualizeOperator<Real>::operator()(Layer<Real>& layer) -> bool
+    {
+        equalize(layer, nullptr);
+        return true;
+    }
+
+    template <typename Real>
+    auto EqualizeOperator<Real>::operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool
+    {
+        equalize(layer, &mask);
+        return true;
+    }
+
+    template <typename Real>
+    auto EqualizeOperator<Real>::equalize(Layer<Real>& layer, const MaskView<Real>* mask) const -> void
+    {
+        const Tiles<Real>* tiles{mask ? &mask->tiles() : nullptr};
+        Histogram<Real> histogram{_bins};
+        histogram.build(layer, 1, layer.channels());
+
+        const size_t width{layer.width()};
+        const int64_t height{static_cast<int64_t>(layer.height())};
+        const auto live = this->live_list(layer.channels(), 1);
+#pragma omp parallel for schedule(static)
+        for (int64_t row = 0; row < height; ++row)
+        {
+            size_t y{static_cast<size_t>(row)};
+            for (size_t begin{0}; begin < width; begin += Tiles<Real>::size)
+            {
+                const Coverage coverage{tiles ? tiles->coverage(begin, y) : Coverage::full};
+                if (coverage == Coverage::none)
+                {
+                    continue;
+                }
+                const size_t end{std::min(width, begin + Tiles<Real>::size)};
+                for (size_t x{begin}; x < end; ++x)
+                {
+                    for (const size_t c : live)
+                    {
+                        Real value{histogram.cumulative(layer(x, y, c))};
+                        if (coverage == Coverage::partial)
+                        {
+                            Real t{(*mask)(x, y)};
+                            layer(x, y, c) = (static_cast<Real>(1.0) - t) * layer(x, y, c) + t * value;
+                        }
+                        else
+                        {
+                            layer(x, y, c) = value;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    template <typename Real>
+    auto EqualizeOperator<Real>::footprint() const -> Footprint
+    {
+        // The histogram is built over the whole layer
+        return Footprint{0, true, true};
+    }
+
+    template <typename Real>
+    auto EqualizeOperator<Real>::writes(size_t channels) const -> std::vector<bool>
+    {
+        return channel_range(channels, 1, channels);
+    }
+
+    template <typename Real>
+    auto EqualizeOperator<Real>::reads(const std::vector<bool>& needed) const -> std::vector<bool>
+    {
+        // The histogram is built over all color channels
+        return channel_range(needed.size(), 1, any_channel(needed) ? needed.size() : 0);
+    }
+}
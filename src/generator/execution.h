@@ -0,0 +1,46 @@
+// execution.h
+// How the operators' parallel loops are run
+// Operators split their rows between the threads of OpenMP parallel regions, with the static schedule that places
+// each row's pages on the thread that processes it. OpenMP keeps its threads between regions, so the settings here
+// choose how many threads those regions use, run small maps on the calling thread, where waking the threads costs
+// more than the work, and can pin the threads to processors.
+// Copyright Laurence Emms 2017
+
+#pragma once
+#include <cstddef>
+#include <vector>
+
+namespace bluedot {
+    enum class Backend {
+        // Rows are split between the threads of OpenMP parallel regions
+        openmp,
+        // Every loop runs on the calling thread, as when a host application parallelizes across renders
+        serial
+    };
+
+    class Execution {
+    public:
+        // threads: threads per parallel region, 0 for the OpenMP default
+        // serial_samples: maps with fewer samples than this run on the calling thread
+        // pin: bind each thread OpenMP starts to one processor, so rows stay next to the memory their thread first touched,
+        // leaving the calling thread on the processors it had
+        Execution(Backend backend = Backend::openmp, size_t threads = 0, size_t serial_samples = 128 * 128, bool pin = false);
+        inline auto backend() const -> Backend;
+        inline auto pin() const -> bool;
+        // Threads the operators use on a width by height map
+        auto threads(size_t width, size_t height) const -> size_t;
+        // Applies the settings to the parallel regions the calling thread starts from now on, returns the threads they use
+        auto apply(size_t width, size_t height) const -> size_t;
+    private:
+        // Threads OpenMP would use before any settings were applied, which honours OMP_NUM_THREADS
+        static auto default_threads() -> size_t;
+        // Processors the process may run on, in order
+        static auto processors() -> std::vector<int>;
+        Backend _backend;
+        size_t _threads;
+        size_t _serial_samples;
+        bool _pin;
+    };
+}
+
+#include "execution.hpp"
\ No newline at end of file
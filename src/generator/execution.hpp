@@ -0,0 +1,85 @@
+// execution.hpp
+// Copyright Laurence Emms 2017
+
+#include <omp.h>
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace bluedot {
+    inline Execution::Execution(Backend backend, size_t threads, size_t serial_samples, bool pin) :
+        _backend(backend), _threads(threads), _serial_samples(serial_samples), _pin(pin)
+    {
+    }
+
+    inline auto Execution::backend() const -> Backend
+    {
+        return _backend;
+    }
+
+    inline auto Execution::pin() const -> bool
+    {
+        return _pin;
+    }
+
+    inline auto Execution::threads(size_t width, size_t height) const -> size_t
+    {
+        if (_backend == Backend::serial || width * height < _serial_samples)
+            return 1;
+        return _threads > 0 ? _threads : default_threads();
+    }
+
+    inline auto Execution::apply(size_t width, size_t height) const -> size_t
+    {
+        const size_t threads{this->threads(width, height)};
+        // Fixed team sizes keep the static schedule, and with it the rows each thread owns, the same in every region
+        omp_set_dynamic(0);
+        omp_set_num_threads(static_cast<int>(threads));
+#if defined(__linux__)
+        const std::vector<int> cpus{processors()};
+        if (_pin && threads > 1 && !cpus.empty())
+        {
+            // OpenMP reuses the threads of a team of the same size, so they stay pinned for the later regions.
+            // The calling thread takes part in every region as thread 0, and gets its own processors back afterwards,
+            // so the threads it starts itself, such as the writers of outputs, are not confined to the processor of thread 0.
+            cpu_set_t calling;
+            CPU_ZERO(&calling);
+            const bool restore{sched_getaffinity(0, sizeof(calling), &calling) == 0};
+#pragma omp parallel num_threads(static_cast<int>(threads))
+            {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(cpus[static_cast<size_t>(omp_get_thread_num()) % cpus.size()], &set);
+                sched_setaffinity(0, sizeof(set), &set);
+            }
+            if (restore)
+                sched_setaffinity(0, sizeof(calling), &calling);
+        }
+#endif
+        return threads;
+    }
+
+    inline auto Execution::default_threads() -> size_t
+    {
+        static const size_t threads{static_cast<size_t>(omp_get_max_threads())};
+        return threads;
+    }
+
+    inline auto Execution::processors() -> std::vector<int>
+    {
+        std::vector<int> cpus;
+#if defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0)
+        {
+            for (int cpu{0}; cpu < CPU_SETSIZE; ++cpu)
+            {
+                if (CPU_ISSET(cpu, &set))
+                    cpus.push_back(cpu);
+            }
+        }
+#endif
+        return cpus;
+    }
+}
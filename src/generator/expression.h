@@ -0,0 +1,119 @@
+// expression.h
+// Per sample formulas over named layers, compiled once to bytecode for a register machine
+// A formula is a list of statements of the form layer.channel = expression, separated by semicolons.
+// Channels are named a, r, g and b, or numbered from 0.
+// Expressions support + - * /, comparisons < > <= >= which give 0 or 1, and the functions
+// min(x, y), max(x, y), clamp(x, low, high), abs(x), sqrt(x), floor(x) and lerp(x, y, t).
+// Each register holds a block of samples along a row, so every instruction is a vectorizable loop.
+// Copyright Laurence Emms 2017
+
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "layer.h"
+#include "mask.h"
+
+namespace bluedot {
+    template <typename Real>
+    class Expression {
+    public:
+        Expression(const std::string& formula);
+        auto valid() const -> bool;
+        // Describes the first problem found in the formula
+        auto error() const -> const std::string&;
+        // Names of the layers the formula uses, in the order run expects them
+        auto layers() const -> const std::vector<std::string>&;
+        // Evaluates the formula at every sample, blending stores with the mask when one is given
+        // Fails if a layer is too small or lacks a channel the formula uses
+        auto run(const std::vector<Layer<Real>*>& layers, const MaskView<Real>* mask) const -> bool;
+    private:
+        enum class Opcode {
+            load,
+            store,
+            add,
+            subtract,
+            multiply,
+            divide,
+            negate,
+            minimum,
+            maximum,
+            absolute,
+            square_root,
+            floor,
+            lerp,
+            less,
+            greater,
+            less_equal,
+            greater_equal
+        };
+
+        // Loads use a as the layer and b as the channel, stores use a as the source, b as the layer and c as the channel
+        struct Instruction {
+            Opcode opcode;
+            uint32_t destination;
+            uint32_t a;
+            uint32_t b;
+            uint32_t c;
+        };
+
+        struct Token {
+            enum class Kind {
+                number,
+                name,
+                symbol,
+                end
+            };
+            Kind kind;
+            std::string text;
+            Real value;
+            size_t offset;
+        };
+
+        // A value during compilation, either a constant that is folded or a register
+        struct Operand {
+            bool constant;
+            Real value;
+            uint32_t reg;
+            bool temporary;
+        };
+
+        auto tokenize(const std::string& formula) -> bool;
+        auto statement() -> bool;
+        auto comparison(Operand& result) -> bool;
+        auto additive(Operand& result) -> bool;
+        auto term(Operand& result) -> bool;
+        auto unary(Operand& result) -> bool;
+        auto primary(Operand& result) -> bool;
+        auto reference(std::string& layer, uint32_t& channel) -> bool;
+        auto fail(const std::string& message) -> bool;
+        auto accept(const std::string& symbol) -> bool;
+        auto slot(const std::string& layer, uint32_t channel) -> uint32_t;
+        auto allocate() -> uint32_t;
+        auto materialize(const Operand& operand) -> uint32_t;
+        auto release(const Operand& operand) -> void;
+        auto emit(Opcode opcode, const std::vector<Operand>& operands) -> Operand;
+        static auto evaluate(Opcode opcode, Real a, Real b, Real c) -> Real;
+        auto execute(const Instruction& instruction, Real* registers, size_t count, const std::vector<Layer<Real>*>& layers, size_t x, size_t y, const Real* weight) const -> void;
+
+        std::vector<Instruction> _code;
+        // Registers holding constants, filled once by each thread
+        std::vector<std::pair<uint32_t, Real>> _constants;
+        uint32_t _registers;
+        std::vector<std::string> _layers;
+        // Number of channels each layer needs
+        std::vector<size_t> _channels;
+        std::string _error;
+
+        // Compilation state
+        std::vector<Token> _tokens;
+        size_t _position;
+        std::vector<uint32_t> _free;
+        std::map<std::pair<uint32_t, uint32_t>, uint32_t> _loaded;
+        std::map<Real, uint32_t> _constant_registers;
+    };
+}
+
+#include "expression.hpp"
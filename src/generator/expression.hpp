@@ -0,0 +1,750 @@
+// expression.hpp
+// Copyright Laurence Emms 2017
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+
+namespace bluedot {
+    template <typename Real>
+    Expression<Real>::Expression(const std::string& formula) : _registers(0), _position(0)
+    {
+        if (tokenize(formula))
+        {
+            while (_tokens[_position].kind != Token::Kind::end)
+            {
+                if (!statement())
+                {
+                    break;
+                }
+            }
+            if (_error.empty() && _code.empty())
+            {
+                _error = "Formula has no statements";
+            }
+        }
+        if (!_error.empty())
+        {
+            _code.clear();
+        }
+
+        _tokens.clear();
+        _free.clear();
+        _loaded.clear();
+        _constant_registers.clear();
+    }
+
+    template <typename Real>
+    auto Expression<Real>::valid() const -> bool
+    {
+        return _error.empty();
+    }
+
+    template <typename Real>
+    auto Expression<Real>::error() const -> const std::string&
+    {
+        return _error;
+    }
+
+    template <typename Real>
+    auto Expression<Real>::layers() const -> const std::vector<std::string>&
+    {
+        return _layers;
+    }
+
+    template <typename Real>
+    auto Expression<Real>::run(const std::vector<Layer<Real>*>& layers, const MaskView<Real>* mask) const -> bool
+    {
+        if (!valid() || layers.size() != _layers.size())
+        {
+            return false;
+        }
+
+        const size_t width{layers[0]->width()};
+        const size_t height{layers[0]->height()};
+        for (size_t i{0}; i < layers.size(); ++i)
+        {
+            if (layers[i]->width() != width || layers[i]->height() != height || layers[i]->channels() < _channels[i])
+            {
+                return false;
+            }
+        }
+        if (mask && (mask->width() != width || mask->height() != height))
+        {
+            return false;
+        }
+
+        // Blocks line up with the mask's tiles, so whole blocks are skipped or stored without blending
+        const size_t block{Tiles<Real>::size};
+        const Tiles<Real>* tiles{mask ? &mask->tiles() : nullptr};
+        const int64_t rows{static_cast<int64_t>(height)};
+#pragma omp parallel
+        {
+            std::vector<Real> registers(_registers * block);
+            std::vector<Real> weight(block);
+            for (const std::pair<uint32_t, Real>& constant : _constants)
+            {
+                std::fill(registers.begin() + constant.first * block, registers.begin() + (constant.first + 1) * block, constant.second);
+            }
+#pragma omp for schedule(static)
+            for (int64_t row = 0; row < rows; ++row)
+            {
+                size_t y{static_cast<size_t>(row)};
+                for (size_t begin{0}; begin < width; begin += block)
+                {
+                    const Coverage coverage{tiles ? tiles->coverage(begin, y) : Coverage::full};
+                    if (coverage == Coverage::none)
+                    {
+                        continue;
+                    }
+                    const size_t count{std::min(block, width - begin)};
+                    if (coverage == Coverage::partial)
+                    {
+                        for (size_t i{0}; i < count; ++i)
+                        {
+                            weight[i] = (*mask)(begin + i, y);
+                        }
+                    }
+                    const Real* w{coverage == Coverage::partial ? weight.data() : nullptr};
+                    for (const Instruction& instruction : _code)
+                    {
+                        execute(instruction, registers.data(), count, layers, begin, y, w);
+                    }
+                }
+            }
+        }
+
+        return true;
+    }
+
+    template <typename Real>
+    auto Expression<Real>::execute(const Instruction& instruction, Real* registers, size_t count, const std::vector<Layer<Real>*>& layers, size_t x, size_t y, const Real* weight) const -> void
+    {
+        const size_t block{Tiles<Real>::size};
+        Real* d{registers + instruction.destination * block};
+        switch (instruction.opcode)
+        {
+        case Opcode::load:
+        {
+            const Layer<Real>& layer{*layers[instruction.a]};
+            const Real* source{&layer(x, y, instruction.b)};
+            const size_t stride{layer.channels()};
+            for (size_t i{0}; i < count; ++i)
+            {
+                d[i] = source[i * stride];
+            }
+            return;
+        }
+        case Opcode::store:
+        {
+            Layer<Real>& layer{*layers[instruction.b]};
+            Real* target{&layer(x, y, instruction.c)};
+            const Real* source{registers + instruction.a * block};
+            const size_t stride{layer.channels()};
+            if (weight)
+            {
+                for (size_t i{0}; i < count; ++i)
+                {
+                    const Real t{weight[i]};
+                    target[i * stride] = (static_cast<Real>(1.0) - t) * target[i * stride] + t * source[i];
+                }
+            }
+            else
+            {
+                for (size_t i{0}; i < count; ++i)
+                {
+                    target[i * stride] = source[i];
+                }
+            }
+            return;
+        }
+        default:
+            break;
+        }
+
+        const Real* a{registers + instruction.a * block};
+        const Real* b{registers + instruction.b * block};
+        const Real* c{registers + instruction.c * block};
+        switch (instruction.opcode)
+        {
+        case Opcode::add:
+#pragma omp simd
+            for (size_t i = 0; i < count; ++i)
+            {
+                d[i] = a[i] + b[i];
+            }
+            break;
+        case Opcode::subtract:
+#pragma omp simd
+            for (size_t i = 0; i < count; ++i)
+            {
+                d[i] = a[i] - b[i];
+            }
+            break;
+        case Opcode::multiply:
+#pragma omp simd
+            for (size_t i = 0; i < count; ++i)
+            {
+                d[i] = a[i] * b[i];
+            }
+            break;
+        case Opcode::divide:
+#pragma omp simd
+            for (size_t i = 0; i < count; ++i)
+            {
+                d[i] = a[i] / b[i];
+            }
+            break;
+        case Opcode::negate:
+#pragma omp simd
+            for (size_t i = 0; i < count; ++i)
+            {
+                d[i] = -a[i];
+            }
+            break;
+        case Opcode::minimum:
+#pragma omp simd
+            for (size_t i = 0; i < count; ++i)
+            {
+                d[i] = std::min(a[i], b[i]);
+            }
+            break;
+        case Opcode::maximum:
+#pragma omp simd
+            for (size_t i = 0; i < count; ++i)
+            {
+                d[i] = std::max(a[i], b[i]);
+            }
+            break;
+        case Opcode::absolute:
+#pragma omp simd
+            for (size_t i = 0; i < count; ++i)
+            {
+                d[i] = std::abs(a[i]);
+            }
+            break;
+        case Opcode::square_root:
+#pragma omp simd
+            for (size_t i = 0; i < count; ++i)
+            {
+                d[i] = std::sqrt(a[i]);
+            }
+            break;
+        case Opcode::floor:
+#pragma omp simd
+            for (size_t i = 0; i < count; ++i)
+            {
+                d[i] = std::floor(a[i]);
+            }
+            break;
+        case Opcode::lerp:
+#pragma omp simd
+            for (size_t i = 0; i < count; ++i)
+            {
+                d[i] = a[i] + c[i] * (b[i] - a[i]);
+            }
+            break;
+        case Opcode::less:
+#pragma omp simd
+            for (size_t i = 0; i < count; ++i)
+            {
+                d[i] = a[i] < b[i] ? static_cast<Real>(1.0) : static_cast<Real>(0.0);
+            }
+            break;
+        case Opcode::greater:
+#pragma omp simd
+            for (size_t i = 0; i < count; ++i)
+            {
+                d[i] = a[i] > b[i] ? static_cast<Real>(1.0) : static_cast<Real>(0.0);
+            }
+            break;
+        case Opcode::less_equal:
+#pragma omp simd
+            for (size_t i = 0; i < count; ++i)
+            {
+                d[i] = a[i] <= b[i] ? static_cast<Real>(1.0) : static_cast<Real>(0.0);
+            }
+            break;
+        case Opcode::greater_equal:
+#pragma omp simd
+            for (size_t i = 0; i < count; ++i)
+            {
+                d[i] = a[i] >= b[i] ? static_cast<Real>(1.0) : static_cast<Real>(0.0);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    template <typename Real>
+    auto Expression<Real>::evaluate(Opcode opcode, Real a, Real b, Real c) -> Real
+    {
+        switch (opcode)
+        {
+        case Opcode::add:
+            return a + b;
+        case Opcode::subtract:
+            return a - b;
+        case Opcode::multiply:
+            return a * b;
+        case Opcode::divide:
+            return a / b;
+        case Opcode::negate:
+            return -a;
+        case Opcode::minimum:
+            return std::min(a, b);
+        case Opcode::maximum:
+            return std::max(a, b);
+        case Opcode::absolute:
+            return std::abs(a);
+        case Opcode::square_root:
+            return std::sqrt(a);
+        case Opcode::floor:
+            return std::floor(a);
+        case Opcode::lerp:
+            return a + c * (b - a);
+        case Opcode::less:
+            return a < b ? static_cast<Real>(1.0) : static_cast<Real>(0.0);
+        case Opcode::greater:
+            return a > b ? static_cast<Real>(1.0) : static_cast<Real>(0.0);
+        case Opcode::less_equal:
+            return a <= b ? static_cast<Real>(1.0) : static_cast<Real>(0.0);
+        case Opcode::greater_equal:
+            return a >= b ? static_cast<Real>(1.0) : static_cast<Real>(0.0);
+        default:
+            return static_cast<Real>(0.0);
+        }
+    }
+
+    template <typename Real>
+    auto Expression<Real>::tokenize(const std::string& formula) -> bool
+    {
+        size_t i{0};
+        while (i < formula.size())
+        {
+            const char character{formula[i]};
+            const bool digit_follows{i + 1 < formula.size() && std::isdigit(static_cast<unsigned char>(formula[i + 1]))};
+            if (std::isspace(static_cast<unsigned char>(character)))
+            {
+                ++i;
+            }
+            else if (std::isdigit(static_cast<unsigned char>(character)) ||
+                     (character == '.' && digit_follows && (_tokens.empty() || _tokens.back().kind != Token::Kind::name)))
+            {
+                const char* begin{formula.c_str() + i};
+                char* end{nullptr};
+                const double value{std::strtod(begin, &end)};
+                _tokens.push_back(Token{Token::Kind::number, std::string(begin, static_cast<size_t>(end - begin)), static_cast<Real>(value), i});
+                i += static_cast<size_t>(end - begin);
+            }
+            else if (std::isalpha(static_cast<unsigned char>(character)) || character == '_')
+            {
+                size_t end{i + 1};
+                while (end < formula.size() && (std::isalnum(static_cast<unsigned char>(formula[end])) || formula[end] == '_'))
+                {
+                    ++end;
+                }
+                _tokens.push_back(Token{Token::Kind::name, formula.substr(i, end - i), static_cast<Real>(0.0), i});
+                i = end;
+            }
+            else if ((character == '<' || character == '>') && i + 1 < formula.size() && formula[i + 1] == '=')
+            {
+                _tokens.push_back(Token{Token::Kind::symbol, formula.substr(i, 2), static_cast<Real>(0.0), i});
+                i += 2;
+            }
+            else if (std::string("+-*/(),;=.<>").find(character) != std::string::npos)
+            {
+                _tokens.push_back(Token{Token::Kind::symbol, std::string(1, character), static_cast<Real>(0.0), i});
+                ++i;
+            }
+            else
+            {
+                _error = std::string("Unexpected character '") + character + "' at offset " + std::to_string(i);
+                return false;
+            }
+        }
+        _tokens.push_back(Token{Token::Kind::end, "", static_cast<Real>(0.0), formula.size()});
+        return true;
+    }
+
+    template <typename Real>
+    auto Expression<Real>::statement() -> bool
+    {
+        if (accept(";"))
+        {
+            return true;
+        }
+
+        std::string layer;
+        uint32_t channel{0};
+        if (!reference(layer, channel))
+        {
+            return false;
+        }
+        if (!accept("="))
+        {
+            return fail("Expected =");
+        }
+        Operand value;
+        if (!comparison(value))
+        {
+            return false;
+        }
+
+        const uint32_t source{materialize(value)};
+        release(value);
+        const uint32_t target{slot(layer, channel)};
+        _code.push_back(Instruction{Opcode::store, 0, source, target, channel});
+        // Later reads load the stored value again, since a mask may have blended it
+        _loaded.erase(std::make_pair(target, channel));
+
+        if (_tokens[_position].kind != Token::Kind::end && !accept(";"))
+        {
+            return fail("Expected ;");
+        }
+        return true;
+    }
+
+    template <typename Real>
+    auto Expression<Real>::comparison(Operand& result) -> bool
+    {
+        if (!additive(result))
+        {
+            return false;
+        }
+        const std::vector<std::pair<std::string, Opcode>> comparisons{
+            {"<", Opcode::less}, {">", Opcode::greater}, {"<=", Opcode::less_equal}, {">=", Opcode::greater_equal}};
+        for (const std::pair<std::string, Opcode>& comparison : comparisons)
+        {
+            if (accept(comparison.first))
+            {
+                Operand right;
+                if (!additive(right))
+                {
+                    return false;
+                }
+                result = emit(comparison.second, {result, right});
+                return true;
+            }
+        }
+        return true;
+    }
+
+    template <typename Real>
+    auto Expression<Real>::additive(Operand& result) -> bool
+    {
+        if (!term(result))
+        {
+            return false;
+        }
+        while (true)
+        {
+            Opcode opcode{Opcode::add};
+            if (accept("+"))
+            {
+                opcode = Opcode::add;
+            }
+            else if (accept("-"))
+            {
+                opcode = Opcode::subtract;
+            }
+            else
+            {
+                return true;
+            }
+            Operand right;
+            if (!term(right))
+            {
+                return false;
+            }
+            result = emit(opcode, {result, right});
+        }
+    }
+
+    template <typename Real>
+    auto Expression<Real>::term(Operand& result) -> bool
+    {
+        if (!unary(result))
+        {
+            return false;
+        }
+        while (true)
+        {
+            Opcode opcode{Opcode::multiply};
+            if (accept("*"))
+            {
+                opcode = Opcode::multiply;
+            }
+            else if (accept("/"))
+            {
+                opcode = Opcode::divide;
+            }
+            else
+            {
+                return true;
+            }
+            Operand right;
+            if (!unary(right))
+            {
+                return false;
+            }
+            result = emit(opcode, {result, right});
+        }
+    }
+
+    template <typename Real>
+    auto Expression<Real>::unary(Operand& result) -> bool
+    {
+        if (accept("-"))
+        {
+            Operand operand;
+            if (!unary(operand))
+            {
+                return false;
+            }
+            result = emit(Opcode::negate, {operand});
+            return true;
+        }
+        return primary(result);
+    }
+
+    template <typename Real>
+    auto Expression<Real>::primary(Operand& result) -> bool
+    {
+        const Token token{_tokens[_position]};
+        if (token.kind == Token::Kind::number)
+        {
+            ++_position;
+            result = Operand{true, token.value, 0, false};
+            return true;
+        }
+        if (accept("("))
+        {
+            if (!comparison(result))
+            {
+                return false;
+            }
+            if (!accept(")"))
+            {
+                return fail("Expected )");
+            }
+            return true;
+        }
+        if (token.kind != Token::Kind::name)
+        {
+            return fail("Expected a value");
+        }
+
+        const Token& next{_tokens[_position + 1]};
+        if (next.kind != Token::Kind::symbol || next.text != "(")
+        {
+            std::string layer;
+            uint32_t channel{0};
+            if (!reference(layer, channel))
+            {
+                return false;
+            }
+            const uint32_t layer_slot{slot(layer, channel)};
+            const std::pair<uint32_t, uint32_t> key{layer_slot, channel};
+            auto loaded = _loaded.find(key);
+            if (loaded == _loaded.end())
+            {
+                const uint32_t reg{allocate()};
+                _code.push_back(Instruction{Opcode::load, reg, layer_slot, channel, 0});
+                loaded = _loaded.insert(std::make_pair(key, reg)).first;
+            }
+            result = Operand{false, static_cast<Real>(0.0), loaded->second, false};
+            return true;
+        }
+
+        // Function call
+        _position += 2;
+        std::vector<Operand> arguments;
+        if (!accept(")"))
+        {
+            do
+            {
+                Operand argument;
+                if (!comparison(argument))
+                {
+                    return false;
+                }
+                arguments.push_back(argument);
+            } while (accept(","));
+            if (!accept(")"))
+            {
+                return fail("Expected )");
+            }
+        }
+
+        const std::map<std::string, std::pair<Opcode, size_t>> functions{
+            {"min", {Opcode::minimum, 2}},
+            {"max", {Opcode::maximum, 2}},
+            {"clamp", {Opcode::maximum, 3}},
+            {"abs", {Opcode::absolute, 1}},
+            {"sqrt", {Opcode::square_root, 1}},
+            {"floor", {Opcode::floor, 1}},
+            {"lerp", {Opcode::lerp, 3}}};
+        auto function = functions.find(token.text);
+        if (function == functions.end())
+        {
+            _error = "Unknown function " + token.text + " at offset " + std::to_string(token.offset);
+            return false;
+        }
+        if (arguments.size() != function->second.second)
+        {
+            _error = "Function " + token.text + " takes " + std::to_string(function->second.second) + " arguments at offset " + std::to_string(token.offset);
+            return false;
+        }
+        if (token.text == "clamp")
+        {
+            result = emit(Opcode::maximum, {arguments[0], arguments[1]});
+            result = emit(Opcode::minimum, {result, arguments[2]});
+        }
+        else
+        {
+            result = emit(function->second.first, arguments);
+        }
+        return true;
+    }
+
+    template <typename Real>
+    auto Expression<Real>::reference(std::string& layer, uint32_t& channel) -> bool
+    {
+        const Token name{_tokens[_position]};
+        if (name.kind != Token::Kind::name)
+        {
+            return fail("Expected a layer");
+        }
+        ++_position;
+        if (!accept("."))
+        {
+            return fail("Expected . after layer " + name.text);
+        }
+
+        const Token token{_tokens[_position]};
+        const std::string channels{"argb"};
+        if (token.kind == Token::Kind::name && token.text.size() == 1 && channels.find(token.text[0]) != std::string::npos)
+        {
+            channel = static_cast<uint32_t>(channels.find(token.text[0]));
+        }
+        else if (token.kind == Token::Kind::number && token.value >= static_cast<Real>(0.0) && token.value == std::floor(token.value))
+        {
+            channel = static_cast<uint32_t>(token.value);
+        }
+        else
+        {
+            return fail("Expected a channel of layer " + name.text);
+        }
+        ++_position;
+        layer = name.text;
+        return true;
+    }
+
+    template <typename Real>
+    auto Expression<Real>::fail(const std::string& message) -> bool
+    {
+        _error = message + " at offset " + std::to_string(_tokens[_position].offset);
+        return false;
+    }
+
+    template <typename Real>
+    auto Expression<Real>::accept(const std::string& symbol) -> bool
+    {
+        const Token& token{_tokens[_position]};
+        if (token.kind == Token::Kind::symbol && token.text == symbol)
+        {
+            ++_position;
+            return true;
+        }
+        return false;
+    }
+
+    template <typename Real>
+    auto Expression<Real>::slot(const std::string& layer, uint32_t channel) -> uint32_t
+    {
+        auto found = std::find(_layers.begin(), _layers.end(), layer);
+        const uint32_t index{static_cast<uint32_t>(found - _layers.begin())};
+        if (found == _layers.end())
+        {
+            _layers.push_back(layer);
+            _channels.push_back(0);
+        }
+        _channels[index] = std::max(_channels[index], static_cast<size_t>(channel) + 1);
+        return index;
+    }
+
+    template <typename Real>
+    auto Expression<Real>::allocate() -> uint32_t
+    {
+        if (_free.empty())
+        {
+            return _registers++;
+        }
+        const uint32_t reg{_free.back()};
+        _free.pop_back();
+        return reg;
+    }
+
+    template <typename Real>
+    auto Expression<Real>::materialize(const Operand& operand) -> uint32_t
+    {
+        if (!operand.constant)
+        {
+            return operand.reg;
+        }
+        auto found = _constant_registers.find(operand.value);
+        if (found != _constant_registers.end())
+        {
+            return found->second;
+        }
+        // Constants are filled in before the program runs, so they never share a register with a temporary
+        const uint32_t reg{_registers++};
+        _constants.push_back(std::make_pair(reg, operand.value));
+        if (operand.value == operand.value)
+        {
+            _constant_registers.insert(std::make_pair(operand.value, reg));
+        }
+        return reg;
+    }
+
+    template <typename Real>
+    auto Expression<Real>::release(const Operand& operand) -> void
+    {
+        if (!operand.constant && operand.temporary)
+        {
+            _free.push_back(operand.reg);
+        }
+    }
+
+    template <typename Real>
+    auto Expression<Real>::emit(Opcode opcode, const std::vector<Operand>& operands) -> Operand
+    {
+        const bool constant{std::all_of(operands.begin(), operands.end(), [](const Operand& operand) { return operand.constant; })};
+        if (constant)
+        {
+            Real values[3]{static_cast<Real>(0.0), static_cast<Real>(0.0), static_cast<Real>(0.0)};
+            for (size_t i{0}; i < operands.size(); ++i)
+            {
+                values[i] = operands[i].value;
+            }
+            return Operand{true, evaluate(opcode, values[0], values[1], values[2]), 0, false};
+        }
+
+        uint32_t registers[3]{0, 0, 0};
+        for (size_t i{0}; i < operands.size(); ++i)
+        {
+            registers[i] = materialize(operands[i]);
+        }
+        for (const Operand& operand : operands)
+        {
+            release(operand);
+        }
+        // Instructions work element by element, so the result may reuse an operand's register
+        const uint32_t destination{allocate()};
+        _code.push_back(Instruction{opcode, destination, registers[0], registers[1], registers[2]});
+        return Operand{false, static_cast<Real>(0.0), destination, true};
+    }
+}
@@ -0,0 +1,29 @@
+// expressionop.h
+// Expression operator
+// Evaluates a per sample formula over any number of layers in a single pass, see expression.h for the syntax
+// Copyright Laurence Emms 2017
+
+#pragma once
+#include <string>
+#include <vector>
+#include "op.h"
+#include "layer.h"
+#include "expression.h"
+
+namespace bluedot {
+    template <typename Real>
+    class ExpressionOperator : public NaryOperator<Real> {
+    public:
+        ExpressionOperator(const std::string& formula);
+        auto valid() const -> bool;
+        auto error() const -> const std::string&;
+        // Names of the layers to pass to the operator, in order
+        auto layers() const -> const std::vector<std::string>&;
+        virtual auto operator()(const std::vector<Layer<Real>*>& layers) -> bool;
+        virtual auto operator()(const std::vector<Layer<Real>*>& layers, const MaskView<Real>& mask) -> bool;
+    private:
+        Expression<Real> _expression;
+    };
+}
+
+#include "expressionop.hpp"
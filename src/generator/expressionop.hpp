@@ -0,0 +1,39 @@
+// expressionop.hpp
+// Copyright Laurence Emms 2017
+
+namespace bluedot {
+    template <typename Real>
+    ExpressionOperator<Real>::ExpressionOperator(const std::string& formula) : _expression(formula)
+    {
+    }
+
+    template <typename Real>
+    auto ExpressionOperator<Real>::valid() const -> bool
+    {
+        return _expression.valid();
+    }
+
+    template <typename Real>
+    auto ExpressionOperator<Real>::error() const -> const std::string&
+    {
+        return _expression.error();
+    }
+
+    template <typename Real>
+    auto ExpressionOperator<Real>::layers() const -> const std::vector<std::string>&
+    {
+        return _expression.layers();
+    }
+
+    template <typename Real>
+    auto ExpressionOperator<Real>::operator()(const std::vector<Layer<Real>*>& layers) -> bool
+    {
+        return _expression.run(layers, nullptr);
+    }
+
+    template <typename Real>
+    auto ExpressionOperator<Real>::operator()(const std::vector<Layer<Real>*>& layers, const MaskView<Real>& mask) -> bool
+    {
+        return _expression.run(layers, &mask);
+    }
+}
@@ -5,13 +5,15 @@
 
 #pragma once
 #include <vector>
+#include "window.h"
 
 namespace bluedot
 {
     template <typename T, typename RNG>
     class FBM {
     public:
-        FBM(RNG& rng, size_t width, size_t height, size_t octaves, T exponent = 2.0, bool spherical = true);
+        // width and height are the size of the layer, which covers the given window of the map
+        FBM(RNG& rng, size_t width, size_t height, size_t octaves, T exponent = 2.0, bool spherical = true, const Window& window = Window{0, 0, 0, 0});
         auto operator()(size_t x, size_t y) const -> T;
     private:
         size_t _width;
@@ -1,84 +1,144 @@
 // fbm.hpp
 // Copyright Laurence Emms 2017
 
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+
 namespace bluedot {
     template <typename T, typename RNG>
-    FBM<T, RNG>::FBM(RNG& rng, size_t width, size_t height, size_t octaves, T exponent, bool spherical) : _width(width), _height(height)
+    FBM<T, RNG>::FBM(RNG& rng, size_t width, size_t height, size_t octaves, T exponent, bool spherical, const Window& window) : _width(width), _height(height)
     {
+        const Window map{window.resolve(width, height)};
         T weight = static_cast<T>(0.5) / std::pow(exponent, static_cast<T>(1.0) - static_cast<T>(octaves));
         _noise.resize(_width * _height, static_cast<T>(0.0));
-        for (size_t y{0}; y < _height; ++y)
+        if (_width == 0 || _height == 0)
+            return;
+
+        // Every sample of the map is drawn in row order, so a window sees the same values as the whole map
+        // The first sample of each row is kept as well, since the seam repeats it
+        std::vector<T> first(_height, static_cast<T>(0.0));
+        T north{static_cast<T>(0.0)};
+        T south{static_cast<T>(0.0)};
+        for (size_t map_y{0}; map_y < map.map_height; ++map_y)
         {
-            for (size_t x{0}; x < _width; ++x)
+            const size_t y{map_y - map.y};
+            const bool inside{map_y >= map.y && y < _height};
+            size_t x{map.column(0)};
+            for (size_t map_x{0}; map_x < map.map_width; ++map_x)
             {
-                _noise[x + y * _width] = static_cast<T>(rng()) * weight;
+                const T value{static_cast<T>(rng()) * weight};
+                if (map_x == 0)
+                {
+                    if (map_y == 0)
+                        north = value;
+                    if (map_y == map.map_height - 1)
+                        south = value;
+                    if (inside)
+                        first[y] = value;
+                }
+                if (inside && x < _width)
+                {
+                    _noise[x + y * _width] = value;
+                }
+                x = (x + 1 == map.map_width) ? 0 : x + 1;
             }
         }
         if (spherical)
         {
-            for (size_t x{0}; x < _width; ++x)
-            {
-                _noise[x] = _noise[0];
-            }
-            for (size_t x{0}; x < _width; ++x)
-            {
-                _noise[x + (_height - 1) * _width] = _noise[(_height - 1) * _width];
-            }
+            // The poles take the first sample of their row, and the last column repeats the first
+            const size_t seam{map.column(map.map_width - 1)};
             for (size_t y{0}; y < _height; ++y)
             {
-                _noise[_width - 1 + y * _width] = _noise[y * _width];
+                const size_t map_y{map.y + y};
+                if (map_y == 0 || map_y == map.map_height - 1)
+                {
+                    std::fill(_noise.begin() + y * _width, _noise.begin() + (y + 1) * _width, map_y == 0 ? north : south);
+                }
+                else if (seam < _width)
+                {
+                    _noise[seam + y * _width] = first[y];
+                }
             }
         }
+
+        size_t grid_width{map.map_width};
+        size_t grid_height{map.map_height};
         for (size_t o{0}; o < octaves; ++o)
         {
             weight *= exponent;
-            width /= 2;
-            height /= 2;
-            size_t w = width + 1;
-            size_t h = height + 1;
-            std::vector<T> layer(w * h, static_cast<T>(0.0));
+            grid_width /= 2;
+            grid_height /= 2;
+            size_t w = grid_width + 1;
+            size_t h = grid_height + 1;
+
+            // Only the rows of the grid the window interpolates between are kept
+            auto grid_row = [&map, grid_height](size_t map_y) -> size_t
+            {
+                T fly{static_cast<T>(map_y) / static_cast<T>(map.map_height) * static_cast<T>(grid_height)};
+                return static_cast<size_t>(std::floor(fly));
+            };
+            const size_t top{grid_row(map.y)};
+            const size_t bottom{std::min(h - 1, grid_row(map.y + _height - 1) + 1)};
+            std::vector<T> layer(w * (bottom - top + 1), static_cast<T>(0.0));
+            T first_north{static_cast<T>(0.0)};
+            T first_south{static_cast<T>(0.0)};
             for (size_t y{0}; y < h; ++y)
             {
                 for (size_t x{0}; x < w; ++x)
                 {
-                    layer[x + y * w] = static_cast<T>(rng());
+                    const T value{static_cast<T>(rng())};
+                    if (x == 0 && y == 0)
+                        first_north = value;
+                    if (x == 0 && y == h - 1)
+                        first_south = value;
+                    if (y >= top && y <= bottom)
+                        layer[x + (y - top) * w] = value;
                 }
             }
             if (spherical)
             {
-                for (size_t x{0}; x < w; ++x)
+                for (size_t y{top}; y <= bottom; ++y)
                 {
-                    layer[x] = layer[0];
-                }
-                for (size_t x{0}; x < w; ++x)
-                {
-                    layer[x + (h - 1) * w] = layer[(h - 1) * w];
-                }
-                for (size_t y{0}; y < h; ++y)
-                {
-                    layer[w - 1 + y * w] = layer[y * w];
+                    T* row{&layer[(y - top) * w]};
+                    if (y == 0 || y == h - 1)
+                    {
+                        std::fill(row, row + w, y == 0 ? first_north : first_south);
+                    }
+                    else
+                    {
+                        row[w - 1] = row[0];
+                    }
                 }
             }
 
-            for (size_t y{0}; y < _height; ++y)
+            // Random values are drawn serially above, so the interpolation can run in parallel
+            const int64_t rows{static_cast<int64_t>(_height)};
+#pragma omp parallel for schedule(static)
+            for (int64_t row = 0; row < rows; ++row)
             {
+                size_t y{static_cast<size_t>(row)};
+                size_t map_y{map.y + y};
+                size_t map_x{map.x % map.map_width};
                 for (size_t x{0}; x < _width; ++x)
                 {
-                    T flx{static_cast<T>(x) / static_cast<T>(_width) * static_cast<T>(width)};
-                    T fly{static_cast<T>(y) / static_cast<T>(_height) * static_cast<T>(height)};
+                    T flx{static_cast<T>(map_x) / static_cast<T>(map.map_width) * static_cast<T>(grid_width)};
+                    T fly{static_cast<T>(map_y) / static_cast<T>(map.map_height) * static_cast<T>(grid_height)};
                     size_t lx{static_cast<size_t>(std::floor(flx))};
                     size_t ly{static_cast<size_t>(std::floor(fly))};
-                    T dlx{flx - static_cast<float>(lx)};
-                    T dly{fly - static_cast<float>(ly)};
+                    T dlx{flx - static_cast<T>(lx)};
+                    T dly{fly - static_cast<T>(ly)};
                     size_t nlx{(lx + 1 < w) ? lx + 1 : lx};
                     size_t nly{(ly + 1 < h) ? ly + 1 : ly};
-                    T x00 = layer[lx + ly * w];
-                    T x10 = layer[nlx + ly * w];
-                    T x01 = layer[lx + nly * w];
-                    T x11 = layer[nlx + nly * w];
+                    T x00 = layer[lx + (ly - top) * w];
+                    T x10 = layer[nlx + (ly - top) * w];
+                    T x01 = layer[lx + (nly - top) * w];
+                    T x11 = layer[nlx + (nly - top) * w];
                     T x0 = x00 + dlx * (x10 - x00);
                     T x1 = x01 + dlx * (x11 - x01);
                     _noise[x + y * _width] += (x0 + dly * (x1 - x0)) * weight;
+                    map_x = (map_x + 1 == map.map_width) ? 0 : map_x + 1;
                 }
             }
         }
@@ -5,6 +5,7 @@
 #pragma once
 #include "op.h"
 #include "layer.h"
+#include "window.h"
 
 namespace bluedot {
     template <typename Real, typename RNG>
@@ -16,9 +17,11 @@ namespace bluedot {
                     const std::vector<Real>& multiplier = {static_cast<Real>(0.0), static_cast<Real>(0.0), static_cast<Real>(0.0), static_cast<Real>(0.0)},
                     Real scale = static_cast<Real>(1.0),
                     Real offset = static_cast<Real>(0.0),
-                    bool spherical = true);
+                    bool spherical = true,
+                    const Window& window = Window{0, 0, 0, 0});
         virtual auto operator()(Layer<Real>& layer) -> bool;
-        virtual auto operator()(Layer<Real>& layer, Layer<Real>& mask) -> bool;
+        virtual auto operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool;
+        virtual auto reads(const std::vector<bool>& needed) const -> std::vector<bool>;
     private:
         RNG& _rng;
         size_t _octaves;
@@ -27,6 +30,7 @@ namespace bluedot {
         Real _scale;
         Real _offset;
         bool _spherical;
+        Window _window;
     };
 }
 
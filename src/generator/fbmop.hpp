@@ -1,36 +1,41 @@
 // fbmop.hpp
 // Copyright Laurence Emms 2017
 
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
 #include "fbm.h"
 #include <boost/random.hpp>
 #include <omp.h>
 
 namespace bluedot {
     template <typename Real, typename RNG>
-    FBMOperator<Real, RNG>::FBMOperator(RNG& rng, size_t octaves, Real exponent, const std::vector<Real>& multiplier, Real scale, Real offset, bool spherical) :
-        _rng(rng), _octaves(octaves), _exponent(exponent), _multiplier(multiplier), _scale(scale), _offset(offset), _spherical(spherical)
+    FBMOperator<Real, RNG>::FBMOperator(RNG& rng, size_t octaves, Real exponent, const std::vector<Real>& multiplier, Real scale, Real offset, bool spherical, const Window& window) :
+        _rng(rng), _octaves(octaves), _exponent(exponent), _multiplier(multiplier), _scale(scale), _offset(offset), _spherical(spherical), _window(window)
     {
     }
 
     template <typename Real, typename RNG>
     auto FBMOperator<Real, RNG>::operator()(Layer<Real>& layer) -> bool
     {
-        FBM<Real, RNG> fbm{_rng, layer.width(), layer.height(), _octaves, _exponent, _spherical};
-        int num_samples = static_cast<int>(layer.width() * layer.height());
-#pragma omp parallel for schedule(guided)
-        for (int s{0}; s < num_samples; ++s)
+        FBM<Real, RNG> fbm{_rng, layer.width(), layer.height(), _octaves, _exponent, _spherical, _window};
+        const size_t width{layer.width()};
+        const int64_t height{static_cast<int64_t>(layer.height())};
+        const auto live = this->live_list(layer.channels());
+        const auto multiplier = expand_multiplier(_multiplier, layer.channels());
+#pragma omp parallel for schedule(static)
+        for (int64_t row = 0; row < height; ++row)
         {
-            size_t x = static_cast<size_t>(s) % layer.width();
-            size_t y = static_cast<size_t>(s) / layer.width();
-            for (size_t c{0}; c < layer.channels(); ++c)
+            size_t y{static_cast<size_t>(row)};
+            for (size_t x{0}; x < width; ++x)
             {
-                Real value{fbm(x, y) * _scale};
-                if (c < _multiplier.size())
+                const Real sample{fbm(x, y) * _scale};
+                for (const size_t c : live)
                 {
-                    value *= _multiplier[c];
+                    Real value{sample * multiplier[c]};
+                    value += _offset;
+                    layer(x, y, c) = value;
                 }
-                value += _offset;
-                layer(x, y, c) = value;
             }
         }
 
@@ -38,30 +43,54 @@ namespace bluedot {
     }
 
     template <typename Real, typename RNG>
-    auto FBMOperator<Real, RNG>::operator()(Layer<Real>& layer, Layer<Real>& mask) -> bool
+    auto FBMOperator<Real, RNG>::operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool
     {
-        assert(mask.channels() > 0);
-
-        FBM<Real, RNG> fbm{_rng, layer.width(), layer.height(), _octaves, _exponent, _spherical};
-        int num_samples = static_cast<int>(layer.width() * layer.height());
-#pragma omp parallel for schedule(guided)
-        for (int s{0}; s < num_samples; ++s)
+        FBM<Real, RNG> fbm{_rng, layer.width(), layer.height(), _octaves, _exponent, _spherical, _window};
+        const Tiles<Real>& tiles{mask.tiles()};
+        const size_t width{layer.width()};
+        const int64_t height{static_cast<int64_t>(layer.height())};
+        const auto live = this->live_list(layer.channels());
+        const auto multiplier = expand_multiplier(_multiplier, layer.channels());
+#pragma omp parallel for schedule(static)
+        for (int64_t row = 0; row < height; ++row)
         {
-            size_t x = static_cast<size_t>(s) % layer.width();
-            size_t y = static_cast<size_t>(s) / layer.width();
-            for (size_t c{0}; c < layer.channels(); ++c)
+            size_t y{static_cast<size_t>(row)};
+            for (size_t begin{0}; begin < width; begin += Tiles<Real>::size)
             {
-                Real value{fbm(x, y) * _scale};
-                if (c < _multiplier.size())
+                const Coverage coverage{tiles.coverage(begin, y)};
+                if (coverage == Coverage::none)
+                {
+                    continue;
+                }
+                const size_t end{std::min(width, begin + Tiles<Real>::size)};
+                for (size_t x{begin}; x < end; ++x)
                 {
-                    value *= _multiplier[c];
+                    const Real sample{fbm(x, y) * _scale};
+                    for (const size_t c : live)
+                    {
+                        Real value{sample * multiplier[c]};
+                        value += _offset;
+                        if (coverage == Coverage::full)
+                        {
+                            layer(x, y, c) = value;
+                        }
+                        else
+                        {
+                            Real t{mask(x, y)};
+                            layer(x, y, c) = (static_cast<Real>(1.0) - t) * layer(x, y, c) + t * value;
+                        }
+                    }
                 }
-                value += _offset;
-                Real t{mask(x, y, 0)};
-                layer(x, y, c) = (static_cast<Real>(1.0) - t) * layer(x, y, c) + t * value;
             }
         }
 
         return true;
     }
+
+    template <typename Real, typename RNG>
+    auto FBMOperator<Real, RNG>::reads(const std::vector<bool>& needed) const -> std::vector<bool>
+    {
+        // Every channel is overwritten without being read
+        return std::vector<bool>(needed.size(), false);
+    }
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 // Copyright Laurence Emms 2017
 
 #pragma once
+#include "channels.h"
 #include "op.h"
 #include "layer.h"
 
@@ -14,8 +15,13 @@ namespace bluedot {
                      Real scale = static_cast<Real>(1.0),
                      Real offset = static_cast<Real>(0.0));
         virtual auto operator()(Layer<Real>& layer) -> bool;
-        virtual auto operator()(Layer<Real>& layer, Layer<Real>& mask) -> bool;
+        virtual auto operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool;
+        virtual auto reads(const std::vector<bool>& needed) const -> std::vector<bool>;
+        virtual auto uniform(const Layer<Real>& layer) const -> bool;
     private:
+        // Applied with the channel count of the layer, fixed at compile time for the common counts
+        template <typename Count>
+        auto apply(Layer<Real>& layer, const MaskView<Real>& mask, Count channels) -> bool;
         std::vector<Real> _multiplier;
         Real _scale;
         Real _offset;
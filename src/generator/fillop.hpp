@@ -1,6 +1,10 @@
 // fillop.hpp
 // Copyright Laurence Emms 2017
 
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
 namespace bluedot {
     template <typename Real>
     FillOperator<Real>::FillOperator(const std::vector<Real>& multiplier, Real scale, Real offset) : _multiplier(multiplier), _scale(scale), _offset(offset)
@@ -10,51 +14,88 @@ namespace bluedot {
     template <typename Real>
     auto FillOperator<Real>::operator()(Layer<Real>& layer) -> bool
     {
-        int num_samples = static_cast<int>(layer.width() * layer.height());
-#pragma omp parallel for schedule(guided)
-        for (int s{0}; s < num_samples; ++s)
+        // The layer becomes uniform, and its samples are only written if a later operator needs them
+        std::vector<Real> values(layer.channels());
+        for (size_t c{0}; c < layer.channels(); ++c)
         {
-            size_t x = static_cast<size_t>(s) % layer.width();
-            size_t y = static_cast<size_t>(s) / layer.width();
-            for (size_t c{0}; c < layer.channels(); ++c)
+            Real value{_scale};
+            if (c < _multiplier.size())
             {
-                Real value{_scale};
-                if (c < _multiplier.size())
-                {
-                    value *= _multiplier[c];
-                }
-                value += _offset;
-                layer(x, y, c) = value;
+                value *= _multiplier[c];
             }
+            value += _offset;
+            values[c] = value;
         }
+        layer.fill(values);
 
         return true;
     }
 
     template <typename Real>
-    auto FillOperator<Real>::operator()(Layer<Real>& layer, Layer<Real>& mask) -> bool
+    auto FillOperator<Real>::operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool
     {
-        assert(mask.channels() > 0);
+        return dispatch_channels(layer.channels(), [&](auto channels) { return this->apply(layer, mask, channels); });
+    }
 
-        int num_samples = static_cast<int>(layer.width() * layer.height());
-#pragma omp parallel for schedule(guided)
-        for (int s{0}; s < num_samples; ++s)
+    template <typename Real>
+    template <typename Count>
+    auto FillOperator<Real>::apply(Layer<Real>& layer, const MaskView<Real>& mask, Count channels) -> bool
+    {
+        // The color is the same for every sample
+        auto values = expand_multiplier(_multiplier, channels);
+        for (size_t c{0}; c < channels; ++c)
+        {
+            values[c] = _scale * values[c] + _offset;
+        }
+        const Tiles<Real>& tiles{mask.tiles()};
+        const size_t width{layer.width()};
+        const int64_t height{static_cast<int64_t>(layer.height())};
+        const auto live = this->live_list(channels);
+#pragma omp parallel for schedule(static)
+        for (int64_t row = 0; row < height; ++row)
         {
-            size_t x = static_cast<size_t>(s) % layer.width();
-            size_t y = static_cast<size_t>(s) / layer.width();
-            for (size_t c{0}; c < layer.channels(); ++c)
+            size_t y{static_cast<size_t>(row)};
+            for (size_t begin{0}; begin < width; begin += Tiles<Real>::size)
             {
-                Real value{_scale};
-                if (c < _multiplier.size())
+                const Coverage coverage{tiles.coverage(begin, y)};
+                if (coverage == Coverage::none)
+                {
+                    continue;
+                }
+                const size_t end{std::min(width, begin + Tiles<Real>::size)};
+                for (size_t x{begin}; x < end; ++x)
                 {
-                    value *= _multiplier[c];
+                    // The mask weight is the same for every channel
+                    const Real t{coverage == Coverage::full ? static_cast<Real>(1.0) : mask(x, y)};
+                    for (const size_t c : live)
+                    {
+                        const Real value{values[c]};
+                        if (coverage == Coverage::full)
+                        {
+                            layer(x, y, c) = value;
+                        }
+                        else
+                        {
+                            layer(x, y, c) = (static_cast<Real>(1.0) - t) * layer(x, y, c) + t * value;
+                        }
+                    }
                 }
-                value += _offset;
-                Real t{mask(x, y, 0)};
-                layer(x, y, c) = (static_cast<Real>(1.0) - t) * layer(x, y, c) + t * value;
             }
         }
 
         return true;
     }
+
+    template <typename Real>
+    auto FillOperator<Real>::reads(const std::vector<bool>& needed) const -> std::vector<bool>
+    {
+        // Every channel is overwritten without being read
+        return std::vector<bool>(needed.size(), false);
+    }
+
+    template <typename Real>
+    auto FillOperator<Real>::uniform(const Layer<Real>&) const -> bool
+    {
+        return true;
+    }
 }
\ No newline at end of file
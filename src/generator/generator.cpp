@@ -4,14 +4,28 @@
 #include "generator.h"
 #include "alphablendop.h"
 #include "alphatocolorop.h"
+#include "blurop.h"
+#include "boxblurop.h"
+#include "colorrampop.h"
 #include "colortoalphaop.h"
+#include "copyop.h"
+#include "distancetransformop.h"
+#include "equalizeop.h"
+#include "execution.h"
+#include "expressionop.h"
 #include "fbmop.h"
 #include "fillop.h"
 #include "gradientop.h"
 #include "greaterthanop.h"
+#include "laplacianop.h"
 #include "lessthanop.h"
+#include "loadlayerop.h"
 #include "maddop.h"
 #include "multiplyop.h"
 #include "noiseop.h"
 #include "normalizeop.h"
+#include "output.h"
+#include "percentilenormalizeop.h"
+#include "savelayerop.h"
+#include "sobelop.h"
 #include "swapop.h"
\ No newline at end of file
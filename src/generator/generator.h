@@ -3,7 +3,11 @@
 
 #pragma once
 #include <map>
+#include <memory>
+#include <string>
+#include <vector>
 #include "layer.h"
+#include "mask.h"
 #include "op.h"
 
 namespace bluedot
@@ -11,13 +15,37 @@ namespace bluedot
     template <typename Real>
     class Generator {
     public:
-        auto create_layer(const std::string& name, size_t width, size_t height, size_t channels) -> void;
+        auto create_layer(const std::string& name, size_t width, size_t height, size_t channels, const Allocator& allocator = Allocator{}) -> void;
+        auto create_mask(const std::string& name, size_t width, size_t height, MaskFormat format = MaskFormat::bit) -> void;
+        // Channels of each layer that are read after the next operator, which may leave the others uncomputed
+        // Layers that are not listed keep every channel
+        auto live_channels(const std::map<std::string, std::vector<bool>>& live) -> void;
         auto apply_unary_operator(const std::string& layer, UnaryOperator<Real>& op, const std::string& mask = "") -> bool;
         auto apply_binary_operator(const std::string& layer0, const std::string& layer1, BinaryOperator<Real>& op, const std::string& mask = "") -> bool;
+        auto apply_nary_operator(const std::vector<std::string>& layers, NaryOperator<Real>& op, const std::string& mask = "") -> bool;
+        auto apply_mask_operator(const std::string& layer, MaskOperator<Real>& op, const std::string& mask) -> bool;
         auto operator()(const std::string& layer, size_t x, size_t y, size_t channel) -> Real;
+        // The layer must not be compressed
         auto operator()(const std::string& layer, size_t x, size_t y, size_t channel) const -> Real;
+        // Stores the samples of a layer if it is uniform or compressed, which must be done before reading them through layer
+        auto materialize(const std::string& name) -> bool;
+        // Packs the samples of a layer that the next few operators do not use, keeping the given mantissa bits
+        // The next operator to use the layer unpacks it
+        auto compress(const std::string& name, size_t bits = PackedSamples<Real>::lossless) -> bool;
+        // Frees the samples of a layer that no later operator or output reads
+        auto release(const std::string& name) -> bool;
+        // A generator whose layers share the samples of these until either side writes them, so that operators
+        // can carry on from the same state along several paths; masks are copied
+        auto fork() const -> Generator;
+        // The layer with the given name, or null if there is none
+        auto layer(const std::string& name) const -> const Layer<Real>*;
     private:
+        // Layers or masks with the given name, which masked operators can read
+        auto find_mask(const std::string& name) -> std::unique_ptr<MaskView<Real>>;
+        auto live(const std::string& layer) const -> std::vector<bool>;
         std::map<std::string, Layer<Real>> _layers;
+        std::map<std::string, MaskLayer<Real>> _masks;
+        std::map<std::string, std::vector<bool>> _live;
     };
 }
 
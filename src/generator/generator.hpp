@@ -2,12 +2,33 @@
 // Copyright Laurence Emms 2017
 
 #include <tuple>
+#include <utility>
 
 namespace bluedot {
     template <typename Real>
-    auto Generator<Real>::create_layer(const std::string& name, size_t width, size_t height, size_t channels) -> void
+    auto Generator<Real>::create_layer(const std::string& name, size_t width, size_t height, size_t channels, const Allocator& allocator) -> void
     {
-        _layers.insert(std::make_pair(name, Layer<Real>(width, height, channels)));
+        if (!allocator.initialize())
+        {
+            _layers.insert(std::make_pair(name, Layer<Real>(width, height, channels, allocator)));
+            return;
+        }
+        // Zeroed layers start out uniform, and are only written if an operator needs their samples
+        Layer<Real> layer{width, height, channels, Allocator{allocator.alignment(), allocator.huge_pages(), false}};
+        layer.fill(std::vector<Real>(channels, static_cast<Real>(0.0)));
+        _layers.insert(std::make_pair(name, std::move(layer)));
+    }
+
+    template <typename Real>
+    auto Generator<Real>::create_mask(const std::string& name, size_t width, size_t height, MaskFormat format) -> void
+    {
+        _masks.insert(std::make_pair(name, MaskLayer<Real>(width, height, format)));
+    }
+
+    template <typename Real>
+    auto Generator<Real>::live_channels(const std::map<std::string, std::vector<bool>>& live) -> void
+    {
+        _live = live;
     }
 
     template <typename Real>
@@ -16,18 +37,23 @@ namespace bluedot {
         auto l = _layers.find(layer);
         if (l == _layers.end())
             return false;
+        op.live_channels(live(layer));
+        prepare_layers(l->second, op, mask != "");
+        bool result{false};
         if (mask == "")
         {
-            return op(l->second);
+            result = op(l->second);
         }
         else
         {
-            auto m = _layers.find(mask);
-            if (m == _layers.end())
+            std::unique_ptr<MaskView<Real>> m{find_mask(mask)};
+            if (!m)
                 return false;
-            return op(l->second, m->second);
+            result = op(l->second, *m);
         }
-        return false;
+        // The operator may have written the layer, so its tile summary is stale
+        l->second.invalidate();
+        return result;
     }
 
     template <typename Real>
@@ -39,18 +65,74 @@ namespace bluedot {
         auto l1 = _layers.find(layer1);
         if (l1 == _layers.end())
             return false;
+        op.live_channels(live(layer0));
+        prepare_layers(l0->second, l1->second, op, mask != "");
+        bool result{false};
+        if (mask == "")
+        {
+            result = op(l0->second, l1->second);
+        }
+        else
+        {
+            std::unique_ptr<MaskView<Real>> m{find_mask(mask)};
+            if (!m)
+                return false;
+            result = op(l0->second, l1->second, *m);
+        }
+        // Binary operators may write either layer, as swap does
+        l0->second.invalidate();
+        l1->second.invalidate();
+        return result;
+    }
+
+    template <typename Real>
+    auto Generator<Real>::apply_nary_operator(const std::vector<std::string>& layers, NaryOperator<Real>& op, const std::string& mask) -> bool
+    {
+        std::vector<Layer<Real>*> pointers;
+        for (const std::string& layer : layers)
+        {
+            auto l = _layers.find(layer);
+            if (l == _layers.end())
+                return false;
+            pointers.push_back(&l->second);
+        }
+        for (Layer<Real>* layer : pointers)
+        {
+            layer->detach();
+            layer->materialize();
+        }
+        bool result{false};
         if (mask == "")
         {
-            return op(l0->second, l1->second);
+            result = op(pointers);
         }
         else
         {
-            auto m = _layers.find(mask);
-            if (m == _layers.end())
+            std::unique_ptr<MaskView<Real>> m{find_mask(mask)};
+            if (!m)
                 return false;
-            return op(l0->second, l1->second, m->second);
+            result = op(pointers, *m);
         }
-        return false;
+        for (Layer<Real>* layer : pointers)
+        {
+            layer->invalidate();
+        }
+        return result;
+    }
+
+    template <typename Real>
+    auto Generator<Real>::apply_mask_operator(const std::string& layer, MaskOperator<Real>& op, const std::string& mask) -> bool
+    {
+        auto l = _layers.find(layer);
+        if (l == _layers.end())
+            return false;
+        auto m = _masks.find(mask);
+        if (m == _masks.end())
+            return false;
+        l->second.materialize();
+        bool result{op(l->second, m->second)};
+        m->second.invalidate();
+        return result;
     }
 
     template <typename Real>
@@ -59,7 +141,8 @@ namespace bluedot {
         auto l = _layers.find(layer);
         if (l == _layers.end())
             return static_cast<Real>(0.0);
-        return l->second(x, y, channel);
+        l->second.materialize();
+        return l->second.uniform() ? l->second.value(channel) : l->second(x, y, channel);
     }
 
     template <typename Real>
@@ -68,6 +151,82 @@ namespace bluedot {
         auto l = _layers.find(layer);
         if (l == _layers.end())
             return static_cast<Real>(0.0);
-        return l->second(x, y, channel);
+        return l->second.uniform() ? l->second.value(channel) : l->second(x, y, channel);
+    }
+
+    template <typename Real>
+    auto Generator<Real>::materialize(const std::string& name) -> bool
+    {
+        auto l = _layers.find(name);
+        if (l == _layers.end())
+            return false;
+        l->second.materialize();
+        return true;
+    }
+
+    template <typename Real>
+    auto Generator<Real>::compress(const std::string& name, size_t bits) -> bool
+    {
+        auto l = _layers.find(name);
+        if (l == _layers.end())
+            return false;
+        return l->second.compress(bits);
+    }
+
+    template <typename Real>
+    auto Generator<Real>::release(const std::string& name) -> bool
+    {
+        auto l = _layers.find(name);
+        if (l == _layers.end())
+            return false;
+        l->second.release();
+        return true;
+    }
+
+    template <typename Real>
+    auto Generator<Real>::fork() const -> Generator<Real>
+    {
+        Generator<Real> fork;
+        for (const auto& l : _layers)
+        {
+            // The forked layer starts without storage of its own, and takes on the samples of the original
+            Layer<Real> layer{l.second.width(), l.second.height(), l.second.channels(), std::unique_ptr<Real[], Deallocator>{}, l.second.allocator()};
+            layer.share(l.second);
+            fork._layers.insert(std::make_pair(l.first, std::move(layer)));
+        }
+        fork._masks = _masks;
+        fork._live = _live;
+        return fork;
+    }
+
+    template <typename Real>
+    auto Generator<Real>::layer(const std::string& name) const -> const Layer<Real>*
+    {
+        auto l = _layers.find(name);
+        if (l == _layers.end())
+            return nullptr;
+        return &l->second;
+    }
+
+    template <typename Real>
+    auto Generator<Real>::find_mask(const std::string& name) -> std::unique_ptr<MaskView<Real>>
+    {
+        auto l = _layers.find(name);
+        if (l != _layers.end())
+        {
+            l->second.materialize();
+            return std::unique_ptr<MaskView<Real>>{new MaskView<Real>{l->second}};
+        }
+        auto m = _masks.find(name);
+        if (m != _masks.end())
+            return std::unique_ptr<MaskView<Real>>{new MaskView<Real>{m->second}};
+        return nullptr;
+    }
+
+    template <typename Real>
+    auto Generator<Real>::live(const std::string& layer) const -> std::vector<bool>
+    {
+        auto l = _live.find(layer);
+        return l != _live.end() ? l->second : std::vector<bool>{};
     }
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 #pragma once
 #include "op.h"
 #include "layer.h"
+#include "stencil.h"
 
 namespace bluedot {
     template <typename Real>
@@ -16,12 +17,16 @@ namespace bluedot {
                          Real offset = static_cast<Real>(0.0),
                          bool spherical = true);
         virtual auto operator()(Layer<Real>& layer) -> bool;
-        virtual auto operator()(Layer<Real>& layer, Layer<Real>& mask) -> bool;
+        virtual auto operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool;
+        virtual auto footprint() const -> Footprint;
+        virtual auto writes(size_t channels) const -> std::vector<bool>;
+        virtual auto reads(const std::vector<bool>& needed) const -> std::vector<bool>;
     private:
+        auto store(Layer<Real>& layer, const Layer<Real>& x_gradient, const Layer<Real>& y_gradient, const MaskView<Real>* mask) const -> void;
+        Stencil<Real> _derivative;
         std::vector<Real> _multiplier;
         Real _scale;
         Real _offset;
-        bool _spherical;
     };
 }
 
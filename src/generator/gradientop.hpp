@@ -1,9 +1,15 @@
 // gradientop.hpp
 // Copyright Laurence Emms 2017
 
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
 namespace bluedot {
     template <typename Real>
-    GradientOperator<Real>::GradientOperator(const std::vector<Real>& multiplier, Real scale, Real offset, bool spherical = true) : _multiplier(multiplier), _scale(scale), _offset(offset), _spherical(spherical)
+    GradientOperator<Real>::GradientOperator(const std::vector<Real>& multiplier, Real scale, Real offset, bool spherical) :
+        _derivative({static_cast<Real>(-0.5), static_cast<Real>(0.0), static_cast<Real>(0.5)}, spherical),
+        _multiplier(multiplier), _scale(scale), _offset(offset)
     {
     }
 
@@ -14,104 +20,104 @@ namespace bluedot {
         {
             return false;
         }
-        int num_samples = static_cast<int>(layer.width() * layer.height());
-#pragma omp parallel for schedule(guided)
-        for (int s{0}; s < num_samples; ++s)
+        if (!this->live(1) && !this->live(2))
         {
-            size_t x{static_cast<size_t>(s) % layer.width()};
-            size_t y{static_cast<size_t>(s) / layer.width()};
-
-            size_t up{std::min(layer.height(), y + 1)};
-            size_t down{static_cast<size_t>(std::max(0, static_cast<int>(y) - 1))};
-            size_t right{0};
-            size_t left{0};
-            if (_spherical)
-            {
-                right = (x + 1 >= layer.width()) ? x + 1 - layer.width() : x + 1;
-                left = (static_cast<int>(x) - 1 < 0) ? x + layer.width() - 1 : x - 1;
-            }
-            else
-            {
-                right = std::min(layer.width(), x + 1);
-                left = static_cast<size_t>(std::max(0, static_cast<int>(x) - 1));
-            }
-
-            Real right_alpha{layer(right, y, 0)};
-            Real left_alpha{layer(left, y, 0)};
-            Real up_alpha{layer(x, up, 0)};
-            Real down_alpha{layer(x, down, 0)};
-            Real x_gradient{(right_alpha - left_alpha) * 0.5f * _scale};
-            Real y_gradient{(up_alpha - down_alpha) * 0.5f * _scale};
-            if (_multiplier.size() > 1)
-            {
-                x_gradient *= _multiplier[1];
-            }
-            if (_multiplier.size() > 2)
-            {
-                y_gradient *= _multiplier[2];
-            }
-            x_gradient += _offset;
-            y_gradient += _offset;
-            layer(x, y, 1) = x_gradient;
-            layer(x, y, 2) = y_gradient;
+            return true;
         }
 
+        Layer<Real> x_gradient{layer.width(), layer.height(), 1};
+        Layer<Real> y_gradient{layer.width(), layer.height(), 1};
+        ChannelView<Real> alpha{layer, 0};
+        ChannelView<Real> x_view{x_gradient, 0};
+        ChannelView<Real> y_view{y_gradient, 0};
+        _derivative.horizontal(alpha, x_view);
+        _derivative.vertical(alpha, y_view);
+        store(layer, x_gradient, y_gradient, nullptr);
+
         return true;
     }
 
     template <typename Real>
-    auto GradientOperator<Real>::operator()(Layer<Real>& layer, Layer<Real>& mask) -> bool
+    auto GradientOperator<Real>::operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool
     {
-        assert(mask.channels() > 0);
         if (layer.channels() < 3)
         {
             return false;
         }
-
-        int num_samples = static_cast<int>(layer.width() * layer.height());
-#pragma omp parallel for schedule(guided)
-        for (int s{0}; s < num_samples; ++s)
+        if (!this->live(1) && !this->live(2))
         {
-            size_t x{static_cast<size_t>(s) % layer.width()};
-            size_t y{static_cast<size_t>(s) / layer.width()};
+            return true;
+        }
 
-            size_t up{std::min(layer.height(), y + 1)};
-            size_t down{static_cast<size_t>(std::max(0, static_cast<int>(y) - 1))};
-            size_t right{0};
-            size_t left{0};
-            if (_spherical)
-            {
-                right = (x + 1 >= layer.width()) ? x + 1 - layer.width() : x + 1;
-                left = (static_cast<int>(x) - 1 < 0) ? x + layer.width() - 1 : x - 1;
-            }
-            else
-            {
-                right = std::min(layer.width(), x + 1);
-                left = static_cast<size_t>(std::max(0, static_cast<int>(x) - 1));
-            }
+        Layer<Real> x_gradient{layer.width(), layer.height(), 1};
+        Layer<Real> y_gradient{layer.width(), layer.height(), 1};
+        ChannelView<Real> alpha{layer, 0};
+        ChannelView<Real> x_view{x_gradient, 0};
+        ChannelView<Real> y_view{y_gradient, 0};
+        _derivative.horizontal(alpha, x_view);
+        _derivative.vertical(alpha, y_view);
+        store(layer, x_gradient, y_gradient, &mask);
 
-            Real right_alpha{layer(right, y, 0)};
-            Real left_alpha{layer(left, y, 0)};
-            Real up_alpha{layer(x, up, 0)};
-            Real down_alpha{layer(x, down, 0)};
-            Real x_gradient{(right_alpha - left_alpha) * 0.5f * _scale};
-            Real y_gradient{(up_alpha - down_alpha) * 0.5f * _scale};
-            if (_multiplier.size() > 1)
-            {
-                x_gradient *= _multiplier[1];
-            }
-            if (_multiplier.size() > 2)
+        return true;
+    }
+
+    template <typename Real>
+    auto GradientOperator<Real>::store(Layer<Real>& layer, const Layer<Real>& x_gradient, const Layer<Real>& y_gradient, const MaskView<Real>* mask) const -> void
+    {
+        const Tiles<Real>* tiles{mask ? &mask->tiles() : nullptr};
+        Real x_multiplier{_multiplier.size() > 1 ? _multiplier[1] : static_cast<Real>(1.0)};
+        Real y_multiplier{_multiplier.size() > 2 ? _multiplier[2] : static_cast<Real>(1.0)};
+
+        const size_t width{layer.width()};
+        const int64_t height{static_cast<int64_t>(layer.height())};
+#pragma omp parallel for schedule(static)
+        for (int64_t row = 0; row < height; ++row)
+        {
+            size_t y{static_cast<size_t>(row)};
+            for (size_t begin{0}; begin < width; begin += Tiles<Real>::size)
             {
-                y_gradient *= _multiplier[2];
+                const Coverage coverage{tiles ? tiles->coverage(begin, y) : Coverage::full};
+                if (coverage == Coverage::none)
+                {
+                    continue;
+                }
+                const size_t end{std::min(width, begin + Tiles<Real>::size)};
+                for (size_t x{begin}; x < end; ++x)
+                {
+                    Real dx{x_gradient(x, y, 0) * _scale * x_multiplier + _offset};
+                    Real dy{y_gradient(x, y, 0) * _scale * y_multiplier + _offset};
+                    if (coverage == Coverage::partial)
+                    {
+                        Real t{(*mask)(x, y)};
+                        layer(x, y, 1) = (static_cast<Real>(1.0) - t) * layer(x, y, 1) + t * dx;
+                        layer(x, y, 2) = (static_cast<Real>(1.0) - t) * layer(x, y, 2) + t * dy;
+                    }
+                    else
+                    {
+                        layer(x, y, 1) = dx;
+                        layer(x, y, 2) = dy;
+                    }
+                }
             }
-            x_gradient += _offset;
-            y_gradient += _offset;
-
-            Real t{mask(x, y, 0)};
-            layer(x, y, 1) = (static_cast<Real>(1.0) - t) * layer(x, y, 1) + t * x_gradient;
-            layer(x, y, 2) = (static_cast<Real>(1.0) - t) * layer(x, y, 2) + t * y_gradient;
         }
+    }
 
-        return true;
+    template <typename Real>
+    auto GradientOperator<Real>::footprint() const -> Footprint
+    {
+        return Footprint{_derivative.radius(), _derivative.spherical(), false};
+    }
+
+    template <typename Real>
+    auto GradientOperator<Real>::writes(size_t channels) const -> std::vector<bool>
+    {
+        return channel_range(channels, 1, 3);
+    }
+
+    template <typename Real>
+    auto GradientOperator<Real>::reads(const std::vector<bool>& needed) const -> std::vector<bool>
+    {
+        // The gradient is taken of alpha
+        return channel_range(needed.size(), 0, any_channel(needed) ? 1 : 0);
     }
 }
@@ -0,0 +1,37 @@
+// histogram.h
+// Histogram of a range of channels of a layer
+// Threads count into private histograms which are then merged, so the result does not depend on the thread count
+// Copyright Laurence Emms 2017
+
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "layer.h"
+
+namespace bluedot
+{
+    template <typename Real>
+    class Histogram {
+    public:
+        Histogram(size_t bins);
+        // Counts the samples of channels [first_channel, last_channel) of layer
+        auto build(Layer<Real>& layer, size_t first_channel, size_t last_channel) -> void;
+        auto minimum() const -> Real;
+        auto maximum() const -> Real;
+        auto count() const -> uint64_t;
+        // Value below which the given fraction of samples lie, interpolated within its bin
+        auto percentile(Real fraction) const -> Real;
+        // Fraction of samples below value, interpolated within its bin
+        auto cumulative(Real value) const -> Real;
+    private:
+        inline auto bin(Real value) const -> size_t;
+        size_t _bins;
+        Real _minimum;
+        Real _maximum;
+        Real _bin_width;
+        std::vector<uint64_t> _counts;
+        std::vector<uint64_t> _cumulative;
+    };
+}
+
+#include "histogram.hpp"
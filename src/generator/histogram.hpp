@@ -0,0 +1,148 @@
+// histogram.hpp
+// Copyright Laurence Emms 2017
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <omp.h>
+
+namespace bluedot {
+    template <typename Real>
+    Histogram<Real>::Histogram(size_t bins) :
+        _bins(std::max(static_cast<size_t>(1), bins)), _minimum(static_cast<Real>(0.0)), _maximum(static_cast<Real>(0.0)), _bin_width(static_cast<Real>(0.0)),
+        _counts(_bins, 0), _cumulative(_bins + 1, 0)
+    {
+    }
+
+    template <typename Real>
+    auto Histogram<Real>::bin(Real value) const -> size_t
+    {
+        if (!(_bin_width > static_cast<Real>(0.0)) || value <= _minimum)
+            return 0;
+        return std::min(_bins - 1, static_cast<size_t>((value - _minimum) / _bin_width));
+    }
+
+    template <typename Real>
+    auto Histogram<Real>::build(Layer<Real>& layer, size_t first_channel, size_t last_channel) -> void
+    {
+        assert(last_channel <= layer.channels());
+        const size_t width{layer.width()};
+        const int64_t height{static_cast<int64_t>(layer.height())};
+        const size_t threads{static_cast<size_t>(omp_get_max_threads())};
+
+        // Range of the samples
+        std::vector<Real> minimums(threads, std::numeric_limits<Real>::max());
+        std::vector<Real> maximums(threads, -std::numeric_limits<Real>::max());
+#pragma omp parallel
+        {
+            Real& thread_minimum{minimums[static_cast<size_t>(omp_get_thread_num())]};
+            Real& thread_maximum{maximums[static_cast<size_t>(omp_get_thread_num())]};
+#pragma omp for schedule(static)
+            for (int64_t row = 0; row < height; ++row)
+            {
+                size_t y{static_cast<size_t>(row)};
+                for (size_t x{0}; x < width; ++x)
+                {
+                    for (size_t c{first_channel}; c < last_channel; ++c)
+                    {
+                        thread_minimum = std::min(thread_minimum, layer(x, y, c));
+                        thread_maximum = std::max(thread_maximum, layer(x, y, c));
+                    }
+                }
+            }
+        }
+        _minimum = *std::min_element(minimums.begin(), minimums.end());
+        _maximum = *std::max_element(maximums.begin(), maximums.end());
+        if (_maximum < _minimum)
+        {
+            _minimum = static_cast<Real>(0.0);
+            _maximum = static_cast<Real>(0.0);
+        }
+        _bin_width = (_maximum - _minimum) / static_cast<Real>(_bins);
+
+        // Private histograms, merged in thread order
+        std::vector<std::vector<uint64_t>> counts(threads, std::vector<uint64_t>(_bins, 0));
+#pragma omp parallel
+        {
+            std::vector<uint64_t>& thread_counts{counts[static_cast<size_t>(omp_get_thread_num())]};
+#pragma omp for schedule(static)
+            for (int64_t row = 0; row < height; ++row)
+            {
+                size_t y{static_cast<size_t>(row)};
+                for (size_t x{0}; x < width; ++x)
+                {
+                    for (size_t c{first_channel}; c < last_channel; ++c)
+                    {
+                        ++thread_counts[bin(layer(x, y, c))];
+                    }
+                }
+            }
+        }
+        std::fill(_counts.begin(), _counts.end(), 0);
+        for (const std::vector<uint64_t>& thread_counts : counts)
+        {
+            for (size_t b{0}; b < _bins; ++b)
+            {
+                _counts[b] += thread_counts[b];
+            }
+        }
+        _cumulative[0] = 0;
+        for (size_t b{0}; b < _bins; ++b)
+        {
+            _cumulative[b + 1] = _cumulative[b] + _counts[b];
+        }
+    }
+
+    template <typename Real>
+    auto Histogram<Real>::minimum() const -> Real
+    {
+        return _minimum;
+    }
+
+    template <typename Real>
+    auto Histogram<Real>::maximum() const -> Real
+    {
+        return _maximum;
+    }
+
+    template <typename Real>
+    auto Histogram<Real>::count() const -> uint64_t
+    {
+        return _cumulative[_bins];
+    }
+
+    template <typename Real>
+    auto Histogram<Real>::percentile(Real fraction) const -> Real
+    {
+        if (count() == 0)
+            return _minimum;
+        fraction = std::max(static_cast<Real>(0.0), std::min(static_cast<Real>(1.0), fraction));
+        const double target{static_cast<double>(fraction) * static_cast<double>(count())};
+        // First bin whose cumulative count reaches the target
+        size_t b{static_cast<size_t>(std::lower_bound(_cumulative.begin() + 1, _cumulative.end(), target) - (_cumulative.begin() + 1))};
+        b = std::min(b, _bins - 1);
+        double within{0.0};
+        if (_counts[b] > 0)
+        {
+            within = (target - static_cast<double>(_cumulative[b])) / static_cast<double>(_counts[b]);
+        }
+        within = std::max(0.0, std::min(1.0, within));
+        return _minimum + static_cast<Real>((static_cast<double>(b) + within) * static_cast<double>(_bin_width));
+    }
+
+    template <typename Real>
+    auto Histogram<Real>::cumulative(Real value) const -> Real
+    {
+        if (count() == 0)
+            return static_cast<Real>(0.0);
+        if (value >= _maximum)
+            return static_cast<Real>(1.0);
+        if (value < _minimum)
+            return static_cast<Real>(0.0);
+        size_t b{bin(value)};
+        double within{static_cast<double>((value - _minimum) / _bin_width) - static_cast<double>(b)};
+        within = std::max(0.0, std::min(1.0, within));
+        double below{static_cast<double>(_cumulative[b]) + within * static_cast<double>(_counts[b])};
+        return static_cast<Real>(below / static_cast<double>(count()));
+    }
+}
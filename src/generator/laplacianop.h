@@ -0,0 +1,31 @@
+// laplacianop.h
+// Laplacian operator
+// Replaces every channel with its 5 point Laplacian
+// Copyright Laurence Emms 2017
+
+#pragma once
+#include "op.h"
+#include "layer.h"
+#include "stencil.h"
+
+namespace bluedot {
+    template <typename Real>
+    class LaplacianOperator : public UnaryOperator<Real> {
+    public:
+        LaplacianOperator(const std::vector<Real>& multiplier = {static_cast<Real>(0.0), static_cast<Real>(0.0), static_cast<Real>(0.0), static_cast<Real>(0.0)},
+                          Real scale = static_cast<Real>(1.0),
+                          Real offset = static_cast<Real>(0.0),
+                          bool spherical = true);
+        virtual auto operator()(Layer<Real>& layer) -> bool;
+        virtual auto operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool;
+        virtual auto footprint() const -> Footprint;
+    private:
+        auto laplacian(Layer<Real>& layer, const MaskView<Real>* mask) const -> void;
+        Stencil<Real> _second_derivative;
+        std::vector<Real> _multiplier;
+        Real _scale;
+        Real _offset;
+    };
+}
+
+#include "laplacianop.hpp"
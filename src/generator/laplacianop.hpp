@@ -0,0 +1,85 @@
+// laplacianop.hpp
+// Copyright Laurence Emms 2017
+
+#include <algorithm>
+#include <cstdint>
+
+namespace bluedot {
+    template <typename Real>
+    LaplacianOperator<Real>::LaplacianOperator(const std::vector<Real>& multiplier, Real scale, Real offset, bool spherical) :
+        _second_derivative({static_cast<Real>(1.0), static_cast<Real>(-2.0), static_cast<Real>(1.0)}, spherical),
+        _multiplier(multiplier), _scale(scale), _offset(offset)
+    {
+    }
+
+    template <typename Real>
+    auto LaplacianOperator<Real>::operator()(Layer<Real>& layer) -> bool
+    {
+        laplacian(layer, nullptr);
+        return true;
+    }
+
+    template <typename Real>
+    auto LaplacianOperator<Real>::operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool
+    {
+        laplacian(layer, &mask);
+        return true;
+    }
+
+    template <typename Real>
+    auto LaplacianOperator<Real>::laplacian(Layer<Real>& layer, const MaskView<Real>* mask) const -> void
+    {
+        const Tiles<Real>* tiles{mask ? &mask->tiles() : nullptr};
+        const size_t width{layer.width()};
+        Layer<Real> x_derivative{width, layer.height(), 1};
+        Layer<Real> y_derivative{width, layer.height(), 1};
+        ChannelView<Real> x_view{x_derivative, 0};
+        ChannelView<Real> y_view{y_derivative, 0};
+
+        for (size_t c{0}; c < layer.channels(); ++c)
+        {
+            if (!this->live(c))
+                continue;
+            // The 5 point Laplacian is the sum of the two 1D second derivatives
+            ChannelView<Real> channel{layer, c};
+            _second_derivative.horizontal(channel, x_view);
+            _second_derivative.vertical(channel, y_view);
+
+            Real multiplier{c < _multiplier.size() ? _multiplier[c] : static_cast<Real>(1.0)};
+            const int64_t height{static_cast<int64_t>(layer.height())};
+#pragma omp parallel for schedule(static)
+            for (int64_t row = 0; row < height; ++row)
+            {
+                size_t y{static_cast<size_t>(row)};
+                for (size_t begin{0}; begin < width; begin += Tiles<Real>::size)
+                {
+                    const Coverage coverage{tiles ? tiles->coverage(begin, y) : Coverage::full};
+                    if (coverage == Coverage::none)
+                    {
+                        continue;
+                    }
+                    const size_t end{std::min(width, begin + Tiles<Real>::size)};
+                    for (size_t x{begin}; x < end; ++x)
+                    {
+                        Real value{(x_derivative(x, y, 0) + y_derivative(x, y, 0)) * _scale * multiplier + _offset};
+                        if (coverage == Coverage::partial)
+                        {
+                            Real t{(*mask)(x, y)};
+                            layer(x, y, c) = (static_cast<Real>(1.0) - t) * layer(x, y, c) + t * value;
+                        }
+                        else
+                        {
+                            layer(x, y, c) = value;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    template <typename Real>
+    auto LaplacianOperator<Real>::footprint() const -> Footprint
+    {
+        return Footprint{_second_derivative.radius(), _second_derivative.spherical(), false};
+    }
+}
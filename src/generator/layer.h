@@ -1,26 +1,81 @@
 // layer.h
 // Layers of the map
+// A layer whose samples all hold the same value, as after a fill, is uniform: it keeps one value per channel
+// and does not store its samples until an operator that needs them asks for them with materialize.
+// A layer left idle between operators may be compressed, which frees its samples until it is materialized again.
 // Copyright Laurence Emms 2017
 
 #pragma once
+#include <cstddef>
+#include <memory>
 #include <vector>
+#include "allocator.h"
+#include "codec.h"
+#include "storage.h"
+#include "tiles.h"
 
 namespace bluedot {
     template <typename Real>
     class Layer {
     public:
-        Layer(size_t width, size_t height, size_t channels);
+        Layer(size_t width, size_t height, size_t channels, const Allocator& allocator = Allocator{});
+        // Adopts storage for width * height * channels samples, such as the pages of a mapped layer file
+        Layer(size_t width, size_t height, size_t channels, std::unique_ptr<Real[], Deallocator> storage, const Allocator& allocator = Allocator{});
+        Layer(const Layer& layer);
+        Layer(Layer&& layer) = default;
+        auto operator=(const Layer& layer) -> Layer&;
+        auto operator=(Layer&& layer) -> Layer& = default;
+        // Samples may only be accessed once a uniform or compressed layer is materialized
         inline auto operator()(size_t x, size_t y, size_t channel) -> Real&;
         inline auto operator()(size_t x, size_t y, size_t channel) const -> const Real&;
         inline auto width() const -> size_t;
         inline auto height() const -> size_t;
         inline auto channels() const -> size_t;
+        inline auto allocator() const -> const Allocator&;
+        // Summary of channel 0, computed on first use after the layer was last invalidated
+        // Must not be called from inside a parallel region
+        auto tiles() const -> const Tiles<Real>&;
+        // Discards the summary, must be called after the layer is written
+        inline auto invalidate() -> void;
+        // Exchanges the samples of two layers of the same size in constant time, fails if the sizes differ
+        auto swap(Layer& layer) -> bool;
+        // Makes the layer share the samples of another of the same size until either is written, fails if the sizes differ
+        auto share(const Layer& layer) -> bool;
+        // Gives the layer samples of its own if they are shared, must be called before the layer is written
+        // The shared samples are copied unless the layer is about to be overwritten without being read
+        auto detach(bool keep = true) -> void;
+        inline auto shared() const -> bool;
+        // Makes every sample of each channel hold the given value, without writing the samples
+        auto fill(const std::vector<Real>& values) -> void;
+        inline auto uniform() const -> bool;
+        // Value of every sample of a channel of a uniform layer
+        inline auto value(size_t channel) const -> Real;
+        // Packs the samples keeping the given mantissa bits and frees them
+        // Fails if the layer is uniform, shared or compressed, or if its samples do not pack smaller
+        auto compress(size_t bits = PackedSamples<Real>::lossless) -> bool;
+        inline auto compressed() const -> bool;
+        // Bytes held by the packed samples of a compressed layer
+        auto compressed_bytes() const -> size_t;
+        // Frees the samples of a layer that is not read again, leaving it uniform zero
+        auto release() -> void;
+        // Stores the samples of a uniform or compressed layer, which then is neither anymore
+        // The samples are left unwritten if the layer is about to be overwritten without being read
+        auto materialize(bool keep = true) -> void;
     private:
         size_t _width;
         size_t _height;
         size_t _channels;
-        std::vector<Real> _layer;
+        Allocator _allocator;
+        // Allocated without initialization, then written row by row by the threads the operators assign those rows to
+        // Layers sharing samples hold the same storage until one of them is detached
+        // A uniform layer may hold no storage until it is materialized
+        Storage<Real> _layer;
+        // Value of each channel of a uniform layer, empty for any other layer
+        std::vector<Real> _uniform;
+        // Packed samples of a compressed layer, which holds no storage, and are shared by its copies
+        std::shared_ptr<const PackedSamples<Real>> _compressed;
+        mutable std::unique_ptr<Tiles<Real>> _tiles;
     };
 }
 
-#include "layer.hpp"
\ No newline at end of file
+#include "layer.hpp"
@@ -1,22 +1,79 @@
 // layer.hpp
 // Copyright Laurence Emms 2017
 
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <utility>
+
 namespace bluedot {
     template <typename Real>
-    Layer<Real>::Layer(size_t width, size_t height, size_t channels) : _width(width), _height(height), _channels(channels), _layer(width * height * channels)
+    Layer<Real>::Layer(size_t width, size_t height, size_t channels, const Allocator& allocator) :
+        _width(width), _height(height), _channels(channels), _allocator(allocator), _layer(allocator.allocate<Real>(width * height * channels), Deallocator{})
+    {
+        if (!_allocator.initialize())
+        {
+            // The first operator to write the layer touches its rows with the same schedule
+            return;
+        }
+
+        // First touch: each row is zeroed by the thread that the operators' static row schedule gives it to,
+        // so on NUMA machines its pages land on the node of the thread that will process it
+        const size_t row_size{_width * _channels};
+        const int64_t rows{static_cast<int64_t>(_height)};
+#pragma omp parallel for schedule(static)
+        for (int64_t row = 0; row < rows; ++row)
+        {
+            Real* begin{_layer.get() + static_cast<size_t>(row) * row_size};
+            std::fill(begin, begin + row_size, static_cast<Real>(0.0));
+        }
+    }
+
+    template <typename Real>
+    Layer<Real>::Layer(size_t width, size_t height, size_t channels, std::unique_ptr<Real[], Deallocator> storage, const Allocator& allocator) :
+        _width(width), _height(height), _channels(channels), _allocator(allocator), _layer(storage.release(), storage.get_deleter())
+    {
+    }
+
+    template <typename Real>
+    Layer<Real>::Layer(const Layer<Real>& layer) :
+        _width(layer._width), _height(layer._height), _channels(layer._channels), _allocator(layer._allocator), _uniform(layer._uniform), _compressed(layer._compressed)
     {
+        // Copies of uniform and compressed layers hold no storage until they are materialized, as their originals do
+        if (uniform() || compressed())
+            return;
+        _layer = Storage<Real>{_allocator.allocate<Real>(_width * _height * _channels), Deallocator{}};
+        const size_t row_size{_width * _channels};
+        const int64_t rows{static_cast<int64_t>(_height)};
+#pragma omp parallel for schedule(static)
+        for (int64_t row = 0; row < rows; ++row)
+        {
+            const Real* begin{layer._layer.get() + static_cast<size_t>(row) * row_size};
+            std::copy(begin, begin + row_size, _layer.get() + static_cast<size_t>(row) * row_size);
+        }
+    }
+
+    template <typename Real>
+    auto Layer<Real>::operator=(const Layer<Real>& layer) -> Layer<Real>&
+    {
+        if (this != &layer)
+        {
+            Layer<Real> copy{layer};
+            *this = std::move(copy);
+        }
+        return *this;
     }
 
     template <typename Real>
     auto Layer<Real>::operator()(size_t x, size_t y, size_t channel) -> Real&
     {
-        return _layer[(x + y * _width) * _channels + channel];
+        return _layer.get()[(x + y * _width) * _channels + channel];
     }
 
     template <typename Real>
     auto Layer<Real>::operator()(size_t x, size_t y, size_t channel) const -> const Real&
     {
-        return _layer[(x + y * _width) * _channels + channel];
+        return _layer.get()[(x + y * _width) * _channels + channel];
     }
     
     template <typename Real>
@@ -36,4 +93,170 @@ namespace bluedot {
     {
         return _channels;
     }
-}
\ No newline at end of file
+
+    template <typename Real>
+    auto Layer<Real>::allocator() const -> const Allocator&
+    {
+        return _allocator;
+    }
+
+    template <typename Real>
+    auto Layer<Real>::tiles() const -> const Tiles<Real>&
+    {
+        // The samples of a compressed layer must be materialized before they are summarized
+        assert(!compressed());
+        if (!_tiles)
+        {
+            _tiles.reset(new Tiles<Real>{_width, _height, [this](size_t x, size_t y) { return uniform() ? _uniform[0] : (*this)(x, y, 0); }});
+        }
+        return *_tiles;
+    }
+
+    template <typename Real>
+    auto Layer<Real>::invalidate() -> void
+    {
+        _tiles.reset();
+    }
+
+    template <typename Real>
+    auto Layer<Real>::swap(Layer<Real>& layer) -> bool
+    {
+        if (_width != layer._width || _height != layer._height || _channels != layer._channels)
+            return false;
+        std::swap(_layer, layer._layer);
+        std::swap(_allocator, layer._allocator);
+        std::swap(_uniform, layer._uniform);
+        std::swap(_compressed, layer._compressed);
+        invalidate();
+        layer.invalidate();
+        return true;
+    }
+
+    template <typename Real>
+    auto Layer<Real>::share(const Layer<Real>& layer) -> bool
+    {
+        if (_width != layer._width || _height != layer._height || _channels != layer._channels)
+            return false;
+        if (this != &layer)
+        {
+            _layer = layer._layer;
+            _allocator = layer._allocator;
+            _uniform = layer._uniform;
+            _compressed = layer._compressed;
+            invalidate();
+        }
+        return true;
+    }
+
+    template <typename Real>
+    auto Layer<Real>::detach(bool keep) -> void
+    {
+        if (!shared())
+            return;
+        // Either way the new samples are touched row by row with the operators' schedule, like any new layer
+        Layer<Real> copy{keep && !uniform() ? Layer<Real>{*this} : Layer<Real>{_width, _height, _channels, _allocator}};
+        _layer = std::move(copy._layer);
+    }
+
+    template <typename Real>
+    auto Layer<Real>::shared() const -> bool
+    {
+        return _layer.shared();
+    }
+
+    template <typename Real>
+    auto Layer<Real>::fill(const std::vector<Real>& values) -> void
+    {
+        _uniform = values;
+        _uniform.resize(_channels, static_cast<Real>(0.0));
+        // Storage shared with other layers is left to them rather than copied when the layer is materialized
+        if (shared())
+            _layer.reset();
+        _compressed.reset();
+        invalidate();
+    }
+
+    template <typename Real>
+    auto Layer<Real>::uniform() const -> bool
+    {
+        return !_uniform.empty();
+    }
+
+    template <typename Real>
+    auto Layer<Real>::value(size_t channel) const -> Real
+    {
+        return _uniform[channel];
+    }
+
+    template <typename Real>
+    auto Layer<Real>::compress(size_t bits) -> bool
+    {
+        if (uniform() || shared() || compressed())
+            return false;
+        std::shared_ptr<const PackedSamples<Real>> packed{std::make_shared<const PackedSamples<Real>>(_layer.get(), _width, _height, _channels, bits)};
+        // Samples too noisy to pack smaller are kept as they are
+        if (packed->bytes() >= _width * _height * _channels * sizeof(Real))
+            return false;
+        _compressed = std::move(packed);
+        _layer.reset();
+        invalidate();
+        return true;
+    }
+
+    template <typename Real>
+    auto Layer<Real>::compressed() const -> bool
+    {
+        return static_cast<bool>(_compressed);
+    }
+
+    template <typename Real>
+    auto Layer<Real>::compressed_bytes() const -> size_t
+    {
+        return _compressed ? _compressed->bytes() : 0;
+    }
+
+    template <typename Real>
+    auto Layer<Real>::release() -> void
+    {
+        _layer.reset();
+        fill(std::vector<Real>(_channels, static_cast<Real>(0.0)));
+    }
+
+    template <typename Real>
+    auto Layer<Real>::materialize(bool keep) -> void
+    {
+        if (compressed())
+        {
+            // Unpacked with the operators' row schedule, so each row lands where the thread that processes it runs
+            _layer = Storage<Real>{_allocator.allocate<Real>(_width * _height * _channels), Deallocator{}};
+            if (keep)
+                _compressed->unpack(_layer.get());
+            _compressed.reset();
+            invalidate();
+            return;
+        }
+        if (!uniform())
+            return;
+        if (!_layer || shared())
+            _layer = Storage<Real>{_allocator.allocate<Real>(_width * _height * _channels), Deallocator{}};
+        if (keep)
+        {
+            // Written with the operators' row schedule, as a fill writes them
+            const size_t width{_width};
+            const size_t channels{_channels};
+            const std::vector<Real>& values{_uniform};
+            const int64_t rows{static_cast<int64_t>(_height)};
+#pragma omp parallel for schedule(static)
+            for (int64_t row = 0; row < rows; ++row)
+            {
+                Real* begin{_layer.get() + static_cast<size_t>(row) * width * channels};
+                for (size_t x{0}; x < width; ++x)
+                {
+                    std::copy(values.begin(), values.end(), begin + x * channels);
+                }
+            }
+        }
+        _uniform.clear();
+        invalidate();
+    }
+}
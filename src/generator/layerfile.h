@@ -0,0 +1,37 @@
+// layerfile.h
+// Binary layer files, which keep a computed layer for later runs
+// A file is a header padded to a page, followed by the samples of the whole map laid out as in a layer,
+// in the byte order of the machine. A layer covering the whole map maps the file copy on write rather than reading it.
+// Copyright Laurence Emms 2017
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include "layer.h"
+#include "window.h"
+
+namespace bluedot {
+    struct LayerFileHeader {
+        static constexpr size_t size{4096};
+
+        char magic[8];
+        // Tells apart files written on machines of another byte order
+        uint32_t byte_order;
+        uint32_t sample_size;
+        uint64_t width;
+        uint64_t height;
+        uint64_t channels;
+    };
+
+    // Writes the layer, which must hold the whole map
+    // The file is written under a temporary name and renamed, so runs reading it never see it half written
+    template <typename Real>
+    auto save_layer(const Layer<Real>& layer, const std::string& file) -> bool;
+
+    // Reads the part of the map the window places the layer over
+    // Fails if the file is not a layer file of the map with the channels and sample type of the layer
+    template <typename Real>
+    auto load_layer(Layer<Real>& layer, const std::string& file, const Window& window = Window{0, 0, 0, 0}) -> bool;
+}
+
+#include "layerfile.hpp"
@@ -0,0 +1,108 @@
+// layerfile.hpp
+// Copyright Laurence Emms 2017
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <vector>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace bluedot {
+    template <typename Real>
+    auto layer_file_header(size_t width, size_t height, size_t channels) -> LayerFileHeader
+    {
+        return LayerFileHeader{{'b', 'l', 'u', 'e', 'd', 'o', 't', 'L'}, 0x01020304, static_cast<uint32_t>(sizeof(Real)),
+                               static_cast<uint64_t>(width), static_cast<uint64_t>(height), static_cast<uint64_t>(channels)};
+    }
+
+    template <typename Real>
+    auto save_layer(const Layer<Real>& layer, const std::string& file) -> bool
+    {
+        const LayerFileHeader header{layer_file_header<Real>(layer.width(), layer.height(), layer.channels())};
+        std::vector<char> page(LayerFileHeader::size, 0);
+        std::memcpy(page.data(), &header, sizeof(header));
+
+        const std::string temporary{file + ".tmp"};
+        {
+            std::ofstream out{temporary, std::ios::out | std::ios::binary};
+            out.write(page.data(), static_cast<std::streamsize>(page.size()));
+            out.write(reinterpret_cast<const char*>(&layer(0, 0, 0)), static_cast<std::streamsize>(layer.width() * layer.height() * layer.channels() * sizeof(Real)));
+            if (!out)
+            {
+                std::remove(temporary.c_str());
+                return false;
+            }
+        }
+        // Renaming leaves the old file to any run that has it mapped
+        return std::rename(temporary.c_str(), file.c_str()) == 0;
+    }
+
+    template <typename Real>
+    auto load_layer(Layer<Real>& layer, const std::string& file, const Window& window) -> bool
+    {
+        std::ifstream in{file, std::ios::in | std::ios::binary};
+        LayerFileHeader header;
+        if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)))
+            return false;
+        const LayerFileHeader expected{layer_file_header<Real>(header.width, header.height, layer.channels())};
+        if (std::memcmp(&header, &expected, sizeof(header)) != 0)
+            return false;
+
+        const Window placement{window.resolve(layer.width(), layer.height())};
+        const size_t width{layer.width()};
+        const size_t height{layer.height()};
+        const size_t channels{layer.channels()};
+        if (header.width != placement.map_width || header.height != placement.map_height || width > placement.map_width || placement.y + height > placement.map_height)
+            return false;
+
+#if !defined(_WIN32)
+        if (placement.x == 0 && placement.y == 0 && width == placement.map_width && height == placement.map_height)
+        {
+            // The layer is the whole map, so the samples in the file can become its storage.
+            // Private mappings are copy on write, so operators change the layer and never the file.
+            const size_t length{LayerFileHeader::size + width * height * channels * sizeof(Real)};
+            const int descriptor{open(file.c_str(), O_RDONLY)};
+            struct stat status;
+            if (descriptor >= 0 && fstat(descriptor, &status) == 0 && static_cast<size_t>(status.st_size) >= length)
+            {
+                void* mapping{mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, descriptor, 0)};
+                close(descriptor);
+                if (mapping != MAP_FAILED)
+                {
+                    // Start reading the file ahead of the operators
+                    madvise(mapping, length, MADV_WILLNEED);
+                    Real* samples{reinterpret_cast<Real*>(static_cast<char*>(mapping) + LayerFileHeader::size)};
+                    layer = Layer<Real>{width, height, channels, std::unique_ptr<Real[], Deallocator>{samples, Deallocator{LayerFileHeader::size, length}}, layer.allocator()};
+                    return true;
+                }
+            }
+            else if (descriptor >= 0)
+            {
+                close(descriptor);
+            }
+        }
+#endif
+
+        // Each row of the window is one read, or two where the window wraps around the seam
+        const size_t first{placement.x % placement.map_width};
+        const size_t before_seam{std::min(width, placement.map_width - first)};
+        for (size_t j{0}; j < height; ++j)
+        {
+            const size_t map_row{placement.y + j};
+            in.seekg(static_cast<std::streamoff>(LayerFileHeader::size + (map_row * placement.map_width + first) * channels * sizeof(Real)));
+            in.read(reinterpret_cast<char*>(&layer(0, j, 0)), static_cast<std::streamsize>(before_seam * channels * sizeof(Real)));
+            if (before_seam < width)
+            {
+                in.seekg(static_cast<std::streamoff>(LayerFileHeader::size + map_row * placement.map_width * channels * sizeof(Real)));
+                in.read(reinterpret_cast<char*>(&layer(before_seam, j, 0)), static_cast<std::streamsize>((width - before_seam) * channels * sizeof(Real)));
+            }
+        }
+        return static_cast<bool>(in);
+    }
+}
@@ -9,11 +9,14 @@
 
 namespace bluedot {
     template <typename Real>
-    class LessThanOperator : public UnaryOperator<Real> {
+    class LessThanOperator : public UnaryOperator<Real>, public MaskOperator<Real> {
     public:
         LessThanOperator(const std::vector<Real>& level = {static_cast<Real>(0.0), static_cast<Real>(0.0), static_cast<Real>(0.0), static_cast<Real>(0.0)}, bool clamp = false);
         virtual auto operator()(Layer<Real>& layer) -> bool;
-        virtual auto operator()(Layer<Real>& layer, Layer<Real>& mask) -> bool;
+        virtual auto operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool;
+        // Selects the samples whose first channel is less than level[0], as masks are read through their first channel alone,
+        // or every sample when no level is given
+        virtual auto operator()(const Layer<Real>& layer, MaskLayer<Real>& mask) -> bool;
     private:
         std::vector<Real> _level;
         bool _clamp;
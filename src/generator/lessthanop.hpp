@@ -1,6 +1,10 @@
 // lessthanop.hpp
 // Copyright Laurence Emms 2017
 
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
 namespace bluedot {
     template <typename Real>
     LessThanOperator<Real>::LessThanOperator(const std::vector<Real>& level, bool clamp) : _level(level), _clamp(clamp)
@@ -10,23 +14,27 @@ namespace bluedot {
     template <typename Real>
     auto LessThanOperator<Real>::operator()(Layer<Real>& layer) -> bool
     {
-        int num_samples = static_cast<int>(layer.width() * layer.height());
-#pragma omp parallel for schedule(guided)
-        for (int s{0}; s < num_samples; ++s)
+        const size_t width{layer.width()};
+        const int64_t height{static_cast<int64_t>(layer.height())};
+        const auto live = this->live_list(layer.channels());
+#pragma omp parallel for schedule(static)
+        for (int64_t row = 0; row < height; ++row)
         {
-            size_t x = static_cast<size_t>(s) % layer.width();
-            size_t y = static_cast<size_t>(s) / layer.width();
-            for (size_t c{0}; c < layer.channels(); ++c)
+            size_t y{static_cast<size_t>(row)};
+            for (size_t x{0}; x < width; ++x)
             {
-                if (c < _level.size() && layer(x, y, c) >= _level[c])
+                for (const size_t c : live)
                 {
-                    if (_clamp)
-                    {
-                        layer(x, y, c) = _level[c];
-                    }
-                    else
+                    if (c < _level.size() && layer(x, y, c) >= _level[c])
                     {
-                        layer(x, y, c) = static_cast<Real>(0.0);
+                        if (_clamp)
+                        {
+                            layer(x, y, c) = _level[c];
+                        }
+                        else
+                        {
+                            layer(x, y, c) = static_cast<Real>(0.0);
+                        }
                     }
                 }
             }
@@ -36,28 +44,40 @@ namespace bluedot {
     }
 
     template <typename Real>
-    auto LessThanOperator<Real>::operator()(Layer<Real>& layer, Layer<Real>& mask) -> bool
+    auto LessThanOperator<Real>::operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool
     {
-        assert(mask.channels() > 0);
-
-        int num_samples = static_cast<int>(layer.width() * layer.height());
-#pragma omp parallel for schedule(guided)
-        for (int s{0}; s < num_samples; ++s)
+        const Tiles<Real>& tiles{mask.tiles()};
+        const size_t width{layer.width()};
+        const int64_t height{static_cast<int64_t>(layer.height())};
+        const auto live = this->live_list(layer.channels());
+#pragma omp parallel for schedule(static)
+        for (int64_t row = 0; row < height; ++row)
         {
-            size_t x = static_cast<size_t>(s) % layer.width();
-            size_t y = static_cast<size_t>(s) / layer.width();
-            for (size_t c{0}; c < layer.channels(); ++c)
+            size_t y{static_cast<size_t>(row)};
+            for (size_t begin{0}; begin < width; begin += Tiles<Real>::size)
             {
-                if (c < _level.size() && layer(x, y, c) >= _level[c])
+                const Coverage coverage{tiles.coverage(begin, y)};
+                if (coverage == Coverage::none)
                 {
-                    Real t{mask(x, y, 0)};
-                    if (_clamp)
-                    {
-                        layer(x, y, c) = (static_cast<Real>(1.0) - t) * layer(x, y, c) + t * _level[c];
-                    }
-                    else
+                    continue;
+                }
+                const size_t end{std::min(width, begin + Tiles<Real>::size)};
+                for (size_t x{begin}; x < end; ++x)
+                {
+                    for (const size_t c : live)
                     {
-                        layer(x, y, c) = (static_cast<Real>(1.0) - t) * layer(x, y, c);
+                        if (c < _level.size() && layer(x, y, c) >= _level[c])
+                        {
+                            Real t{coverage == Coverage::full ? static_cast<Real>(1.0) : mask(x, y)};
+                            if (_clamp)
+                            {
+                                layer(x, y, c) = (static_cast<Real>(1.0) - t) * layer(x, y, c) + t * _level[c];
+                            }
+                            else
+                            {
+                                layer(x, y, c) = (static_cast<Real>(1.0) - t) * layer(x, y, c);
+                            }
+                        }
                     }
                 }
             }
@@ -65,4 +85,28 @@ namespace bluedot {
 
         return true;
     }
+
+    template <typename Real>
+    auto LessThanOperator<Real>::operator()(const Layer<Real>& layer, MaskLayer<Real>& mask) -> bool
+    {
+        assert(layer.width() == mask.width());
+        assert(layer.height() == mask.height());
+
+        // Operators read a mask through its first channel alone, so only the first channel is compared with its level
+        const size_t width{layer.width()};
+        const bool leveled{!_level.empty() && layer.channels() > 0};
+        const int64_t height{static_cast<int64_t>(layer.height())};
+#pragma omp parallel for schedule(static)
+        for (int64_t row = 0; row < height; ++row)
+        {
+            size_t y{static_cast<size_t>(row)};
+            for (size_t x{0}; x < width; ++x)
+            {
+                const bool selected{!leveled || layer(x, y, 0) < _level[0]};
+                mask.set(x, y, selected ? static_cast<Real>(1.0) : static_cast<Real>(0.0));
+            }
+        }
+
+        return true;
+    }
 }
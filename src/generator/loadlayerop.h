@@ -0,0 +1,26 @@
+// loadlayerop.h
+// Load layer operator
+// Reads a layer saved by the SaveLayerOperator, so that expensive layers are computed once and shared between runs
+// Copyright Laurence Emms 2017
+
+#pragma once
+#include <string>
+#include "op.h"
+#include "layer.h"
+#include "window.h"
+
+namespace bluedot {
+    template <typename Real>
+    class LoadLayerOperator : public UnaryOperator<Real> {
+    public:
+        LoadLayerOperator(const std::string& file, const Window& window = Window{0, 0, 0, 0});
+        virtual auto operator()(Layer<Real>& layer) -> bool;
+        virtual auto operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool;
+        virtual auto reads(const std::vector<bool>& needed) const -> std::vector<bool>;
+    private:
+        std::string _file;
+        Window _window;
+    };
+}
+
+#include "loadlayerop.hpp"
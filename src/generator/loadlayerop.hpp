@@ -0,0 +1,64 @@
+// loadlayerop.hpp
+// Copyright Laurence Emms 2017
+
+#include <algorithm>
+#include <cstdint>
+#include "layerfile.h"
+
+namespace bluedot {
+    template <typename Real>
+    LoadLayerOperator<Real>::LoadLayerOperator(const std::string& file, const Window& window) : _file(file), _window(window)
+    {
+    }
+
+    template <typename Real>
+    auto LoadLayerOperator<Real>::operator()(Layer<Real>& layer) -> bool
+    {
+        return load_layer(layer, _file, _window);
+    }
+
+    template <typename Real>
+    auto LoadLayerOperator<Real>::operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool
+    {
+        const Allocator& allocator{layer.allocator()};
+        Layer<Real> loaded{layer.width(), layer.height(), layer.channels(), Allocator{allocator.alignment(), allocator.huge_pages(), false}};
+        if (!load_layer(loaded, _file, _window))
+            return false;
+
+        const Tiles<Real>& tiles{mask.tiles()};
+        const size_t width{layer.width()};
+        const size_t channels{layer.channels()};
+        const int64_t height{static_cast<int64_t>(layer.height())};
+#pragma omp parallel for schedule(static)
+        for (int64_t row = 0; row < height; ++row)
+        {
+            size_t y{static_cast<size_t>(row)};
+            for (size_t begin{0}; begin < width; begin += Tiles<Real>::size)
+            {
+                const Coverage coverage{tiles.coverage(begin, y)};
+                if (coverage == Coverage::none)
+                {
+                    continue;
+                }
+                const size_t end{std::min(width, begin + Tiles<Real>::size)};
+                for (size_t x{begin}; x < end; ++x)
+                {
+                    Real t{coverage == Coverage::full ? static_cast<Real>(1.0) : mask(x, y)};
+                    for (size_t c{0}; c < channels; ++c)
+                    {
+                        layer(x, y, c) = (static_cast<Real>(1.0) - t) * layer(x, y, c) + t * loaded(x, y, c);
+                    }
+                }
+            }
+        }
+
+        return true;
+    }
+
+    template <typename Real>
+    auto LoadLayerOperator<Real>::reads(const std::vector<bool>& needed) const -> std::vector<bool>
+    {
+        // Every channel is overwritten without being read
+        return std::vector<bool>(needed.size(), false);
+    }
+}
@@ -1,6 +1,10 @@
 // maddop.hpp
 // Copyright Laurence Emms 2017
 
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
 namespace bluedot {
     template <typename Real>
     MADDOperator<Real>::MADDOperator(const std::vector<Real>& multiplier, Real scale, Real offset) : _multiplier(multiplier), _scale(scale), _offset(offset)
@@ -10,21 +14,47 @@ namespace bluedot {
     template <typename Real>
     auto MADDOperator<Real>::operator()(Layer<Real>& layer) -> bool
     {
-        int num_samples = static_cast<int>(layer.width() * layer.height());
-#pragma omp parallel for schedule(guided)
-        for (int s{0}; s < num_samples; ++s)
+        if (layer.uniform())
         {
-            size_t x = static_cast<size_t>(s) % layer.width();
-            size_t y = static_cast<size_t>(s) / layer.width();
+            std::vector<Real> values(layer.channels());
             for (size_t c{0}; c < layer.channels(); ++c)
             {
-                Real value{layer(x, y, c) * _scale};
+                Real value{layer.value(c) * _scale};
                 if (c < _multiplier.size())
                 {
                     value *= _multiplier[c];
                 }
                 value += _offset;
-                layer(x, y, c) = value;
+                values[c] = value;
+            }
+            layer.fill(values);
+            return true;
+        }
+
+        return dispatch_channels(layer.channels(), [&](auto channels) { return this->apply(layer, channels); });
+    }
+
+    template <typename Real>
+    template <typename Count>
+    auto MADDOperator<Real>::apply(Layer<Real>& layer, Count channels) -> bool
+    {
+        const auto multiplier = expand_multiplier(_multiplier, channels);
+        const size_t width{layer.width()};
+        const int64_t height{static_cast<int64_t>(layer.height())};
+        const auto live = this->live_list(channels);
+#pragma omp parallel for schedule(static)
+        for (int64_t row = 0; row < height; ++row)
+        {
+            size_t y{static_cast<size_t>(row)};
+            for (size_t x{0}; x < width; ++x)
+            {
+                for (const size_t c : live)
+                {
+                    Real value{layer(x, y, c) * _scale};
+                    value *= multiplier[c];
+                    value += _offset;
+                    layer(x, y, c) = value;
+                }
             }
         }
 
@@ -32,29 +62,60 @@ namespace bluedot {
     }
 
     template <typename Real>
-    auto MADDOperator<Real>::operator()(Layer<Real>& layer, Layer<Real>& mask) -> bool
+    auto MADDOperator<Real>::operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool
     {
-        assert(mask.channels() > 0);
+        return dispatch_channels(layer.channels(), [&](auto channels) { return this->apply(layer, mask, channels); });
+    }
 
-        int num_samples = static_cast<int>(layer.width() * layer.height());
-#pragma omp parallel for schedule(guided)
-        for (int s{0}; s < num_samples; ++s)
+    template <typename Real>
+    template <typename Count>
+    auto MADDOperator<Real>::apply(Layer<Real>& layer, const MaskView<Real>& mask, Count channels) -> bool
+    {
+        const auto multiplier = expand_multiplier(_multiplier, channels);
+        const Tiles<Real>& tiles{mask.tiles()};
+        const size_t width{layer.width()};
+        const int64_t height{static_cast<int64_t>(layer.height())};
+        const auto live = this->live_list(channels);
+#pragma omp parallel for schedule(static)
+        for (int64_t row = 0; row < height; ++row)
         {
-            size_t x = static_cast<size_t>(s) % layer.width();
-            size_t y = static_cast<size_t>(s) / layer.width();
-            for (size_t c{0}; c < layer.channels(); ++c)
+            size_t y{static_cast<size_t>(row)};
+            for (size_t begin{0}; begin < width; begin += Tiles<Real>::size)
             {
-                Real value{layer(x, y, c) * _scale};
-                if (c < _multiplier.size())
+                const Coverage coverage{tiles.coverage(begin, y)};
+                if (coverage == Coverage::none)
                 {
-                    value *= _multiplier[c];
+                    continue;
+                }
+                const size_t end{std::min(width, begin + Tiles<Real>::size)};
+                for (size_t x{begin}; x < end; ++x)
+                {
+                    // The mask weight is the same for every channel
+                    const Real t{coverage == Coverage::full ? static_cast<Real>(1.0) : mask(x, y)};
+                    for (const size_t c : live)
+                    {
+                        Real value{layer(x, y, c) * _scale};
+                        value *= multiplier[c];
+                        value += _offset;
+                        if (coverage == Coverage::full)
+                        {
+                            layer(x, y, c) = value;
+                        }
+                        else
+                        {
+                            layer(x, y, c) = (static_cast<Real>(1.0) - t) * layer(x, y, c) + t * value;
+                        }
+                    }
                 }
-                value += _offset;
-                Real t{mask(x, y, 0)};
-                layer(x, y, c) = (static_cast<Real>(1.0) - t) * layer(x, y, c) + t * value;
             }
         }
 
         return true;
     }
+
+    template <typename Real>
+    auto MADDOperator<Real>::uniform(const Layer<Real>& layer) const -> bool
+    {
+        return layer.uniform();
+    }
 }
@@ -0,0 +1,69 @@
+// mask.h
+// Compact single channel masks, and views that read either them or channel 0 of a layer as blend weights
+// Bit masks hold one bit per sample, byte masks hold weights quantized to 1/255.
+// Rows of a bit mask are padded to whole 64 bit words, so rows may be written by different threads.
+// Copyright Laurence Emms 2017
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "layer.h"
+#include "tiles.h"
+
+namespace bluedot {
+    enum class MaskFormat {
+        bit,
+        byte
+    };
+
+    template <typename Real>
+    class MaskLayer {
+    public:
+        MaskLayer(size_t width, size_t height, MaskFormat format = MaskFormat::bit);
+        // Copies leave the summary to be computed again
+        MaskLayer(const MaskLayer& mask);
+        MaskLayer(MaskLayer&& mask) = default;
+        auto operator=(const MaskLayer& mask) -> MaskLayer&;
+        auto operator=(MaskLayer&& mask) -> MaskLayer& = default;
+        inline auto operator()(size_t x, size_t y) const -> Real;
+        // Weights are rounded to the nearest one the format can hold
+        inline auto set(size_t x, size_t y, Real weight) -> void;
+        inline auto width() const -> size_t;
+        inline auto height() const -> size_t;
+        inline auto format() const -> MaskFormat;
+        // Summary of the weights, computed on first use after the mask was last invalidated
+        // Must not be called from inside a parallel region
+        auto tiles() const -> const Tiles<Real>&;
+        // Discards the summary, must be called after the mask is written
+        inline auto invalidate() -> void;
+    private:
+        size_t _width;
+        size_t _height;
+        MaskFormat _format;
+        // 64 bit words in each row of a bit mask
+        size_t _words;
+        std::vector<uint64_t> _bits;
+        std::vector<uint8_t> _bytes;
+        mutable std::unique_ptr<Tiles<Real>> _tiles;
+    };
+
+    // The weights a masked operator blends with
+    template <typename Real>
+    class MaskView {
+    public:
+        // Channel 0 of the layer
+        MaskView(const Layer<Real>& layer);
+        MaskView(const MaskLayer<Real>& mask);
+        inline auto operator()(size_t x, size_t y) const -> Real;
+        inline auto width() const -> size_t;
+        inline auto height() const -> size_t;
+        auto tiles() const -> const Tiles<Real>&;
+    private:
+        const Layer<Real>* _layer;
+        const MaskLayer<Real>* _mask;
+    };
+}
+
+#include "mask.hpp"
@@ -0,0 +1,134 @@
+// mask.hpp
+// Copyright Laurence Emms 2017
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <utility>
+
+namespace bluedot {
+    template <typename Real>
+    MaskLayer<Real>::MaskLayer(size_t width, size_t height, MaskFormat format) :
+        _width(width), _height(height), _format(format), _words((width + 63) / 64),
+        _bits(format == MaskFormat::bit ? _words * height : 0),
+        _bytes(format == MaskFormat::byte ? width * height : 0)
+    {
+    }
+
+    template <typename Real>
+    MaskLayer<Real>::MaskLayer(const MaskLayer<Real>& mask) :
+        _width(mask._width), _height(mask._height), _format(mask._format), _words(mask._words), _bits(mask._bits), _bytes(mask._bytes)
+    {
+    }
+
+    template <typename Real>
+    auto MaskLayer<Real>::operator=(const MaskLayer<Real>& mask) -> MaskLayer<Real>&
+    {
+        if (this != &mask)
+        {
+            MaskLayer<Real> copy{mask};
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    template <typename Real>
+    auto MaskLayer<Real>::operator()(size_t x, size_t y) const -> Real
+    {
+        if (_format == MaskFormat::bit)
+        {
+            return static_cast<Real>((_bits[y * _words + x / 64] >> (x % 64)) & 1);
+        }
+        return static_cast<Real>(_bytes[x + y * _width]) / static_cast<Real>(255.0);
+    }
+
+    template <typename Real>
+    auto MaskLayer<Real>::set(size_t x, size_t y, Real weight) -> void
+    {
+        if (_format == MaskFormat::bit)
+        {
+            const uint64_t bit{static_cast<uint64_t>(1) << (x % 64)};
+            uint64_t& word{_bits[y * _words + x / 64]};
+            if (weight >= static_cast<Real>(0.5))
+            {
+                word |= bit;
+            }
+            else
+            {
+                word &= ~bit;
+            }
+            return;
+        }
+        const Real clamped{std::max(static_cast<Real>(0.0), std::min(static_cast<Real>(1.0), weight))};
+        _bytes[x + y * _width] = static_cast<uint8_t>(std::lround(clamped * static_cast<Real>(255.0)));
+    }
+
+    template <typename Real>
+    auto MaskLayer<Real>::width() const -> size_t
+    {
+        return _width;
+    }
+
+    template <typename Real>
+    auto MaskLayer<Real>::height() const -> size_t
+    {
+        return _height;
+    }
+
+    template <typename Real>
+    auto MaskLayer<Real>::format() const -> MaskFormat
+    {
+        return _format;
+    }
+
+    template <typename Real>
+    auto MaskLayer<Real>::tiles() const -> const Tiles<Real>&
+    {
+        if (!_tiles)
+        {
+            _tiles.reset(new Tiles<Real>{_width, _height, [this](size_t x, size_t y) { return (*this)(x, y); }});
+        }
+        return *_tiles;
+    }
+
+    template <typename Real>
+    auto MaskLayer<Real>::invalidate() -> void
+    {
+        _tiles.reset();
+    }
+
+    template <typename Real>
+    MaskView<Real>::MaskView(const Layer<Real>& layer) : _layer(&layer), _mask(nullptr)
+    {
+        assert(layer.channels() > 0);
+    }
+
+    template <typename Real>
+    MaskView<Real>::MaskView(const MaskLayer<Real>& mask) : _layer(nullptr), _mask(&mask)
+    {
+    }
+
+    template <typename Real>
+    auto MaskView<Real>::operator()(size_t x, size_t y) const -> Real
+    {
+        return _layer ? (*_layer)(x, y, 0) : (*_mask)(x, y);
+    }
+
+    template <typename Real>
+    auto MaskView<Real>::width() const -> size_t
+    {
+        return _layer ? _layer->width() : _mask->width();
+    }
+
+    template <typename Real>
+    auto MaskView<Real>::height() const -> size_t
+    {
+        return _layer ? _layer->height() : _mask->height();
+    }
+
+    template <typename Real>
+    auto MaskView<Real>::tiles() const -> const Tiles<Real>&
+    {
+        return _layer ? _layer->tiles() : _mask->tiles();
+    }
+}
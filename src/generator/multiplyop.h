@@ -3,6 +3,7 @@
 // Copyright Laurence Emms 2017
 
 #pragma once
+#include "channels.h"
 #include "op.h"
 #include "layer.h"
 
@@ -14,8 +15,15 @@ namespace bluedot {
                          Real scale = static_cast<Real>(1.0),
                          Real offset = static_cast<Real>(0.0));
         virtual auto operator()(Layer<Real>& layer0, Layer<Real>& layer1) -> bool;
-        virtual auto operator()(Layer<Real>& layer0, Layer<Real>& layer1, Layer<Real>& mask) -> bool;
+        virtual auto operator()(Layer<Real>& layer0, Layer<Real>& layer1, const MaskView<Real>& mask) -> bool;
+        virtual auto uniform(const Layer<Real>& layer0, const Layer<Real>& layer1) const -> bool;
+        virtual auto reads_uniform1() const -> bool;
     private:
+        // Applied with the channel count of the layers, fixed at compile time for the common counts
+        template <typename Count>
+        auto apply(Layer<Real>& layer0, Layer<Real>& layer1, Count channels) -> bool;
+        template <typename Count>
+        auto apply(Layer<Real>& layer0, Layer<Real>& layer1, const MaskView<Real>& mask, Count channels) -> bool;
         std::vector<Real> _multiplier;
         Real _scale;
         Real _offset;
@@ -1,6 +1,10 @@
 // multiplyop.hpp
 // Copyright Laurence Emms 2017
 
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
 namespace bluedot {
     template <typename Real>
     MultiplyOperator<Real>::MultiplyOperator(const std::vector<Real>& multiplier, Real scale, Real offset) : _multiplier(multiplier), _scale(scale), _offset(offset)
@@ -15,21 +19,49 @@ namespace bluedot {
         if (layer0.channels() != layer1.channels())
             return false;
 
-        int num_samples = static_cast<int>(layer0.width() * layer0.height());
-#pragma omp parallel for schedule(guided)
-        for (int s{0}; s < num_samples; ++s)
+        if (layer0.uniform() && layer1.uniform())
         {
-            size_t x = static_cast<size_t>(s) % layer0.width();
-            size_t y = static_cast<size_t>(s) / layer0.width();
+            std::vector<Real> values(layer0.channels());
             for (size_t c{0}; c < layer0.channels(); ++c)
             {
-                Real value{_scale * layer1(x, y, c)};
+                Real value{_scale * layer1.value(c)};
                 if (c < _multiplier.size())
                 {
                     value *= _multiplier[c];
                 }
                 value += _offset;
-                layer0(x, y, c) = layer0(x, y, c) * value;
+                values[c] = layer0.value(c) * value;
+            }
+            layer0.fill(values);
+            return true;
+        }
+
+        return dispatch_channels(layer0.channels(), [&](auto channels) { return this->apply(layer0, layer1, channels); });
+    }
+
+    template <typename Real>
+    template <typename Count>
+    auto MultiplyOperator<Real>::apply(Layer<Real>& layer0, Layer<Real>& layer1, Count channels) -> bool
+    {
+        const auto multiplier = expand_multiplier(_multiplier, channels);
+        // A uniform layer1 is read through its values
+        const bool uniform1{layer1.uniform()};
+        const size_t width{layer0.width()};
+        const int64_t height{static_cast<int64_t>(layer0.height())};
+        const auto live = this->live_list(channels);
+#pragma omp parallel for schedule(static)
+        for (int64_t row = 0; row < height; ++row)
+        {
+            size_t y{static_cast<size_t>(row)};
+            for (size_t x{0}; x < width; ++x)
+            {
+                for (const size_t c : live)
+                {
+                    Real value{_scale * (uniform1 ? layer1.value(c) : layer1(x, y, c))};
+                    value *= multiplier[c];
+                    value += _offset;
+                    layer0(x, y, c) = layer0(x, y, c) * value;
+                }
             }
         }
 
@@ -37,33 +69,72 @@ namespace bluedot {
     }
 
     template <typename Real>
-    auto MultiplyOperator<Real>::operator()(Layer<Real>& layer0, Layer<Real>& layer1, Layer<Real>& mask) -> bool
+    auto MultiplyOperator<Real>::operator()(Layer<Real>& layer0, Layer<Real>& layer1, const MaskView<Real>& mask) -> bool
     {
-        assert(mask.channels() > 0);
         assert(layer0.width() == layer1.width());
         assert(layer0.height() == layer1.height());
         if (layer0.channels() != layer1.channels())
             return false;
 
-        int num_samples = static_cast<int>(layer0.width() * layer0.height());
-#pragma omp parallel for schedule(guided)
-        for (int s{0}; s < num_samples; ++s)
+        return dispatch_channels(layer0.channels(), [&](auto channels) { return this->apply(layer0, layer1, mask, channels); });
+    }
+
+    template <typename Real>
+    template <typename Count>
+    auto MultiplyOperator<Real>::apply(Layer<Real>& layer0, Layer<Real>& layer1, const MaskView<Real>& mask, Count channels) -> bool
+    {
+        const auto multiplier = expand_multiplier(_multiplier, channels);
+        const Tiles<Real>& tiles{mask.tiles()};
+        const bool uniform1{layer1.uniform()};
+        const size_t width{layer0.width()};
+        const int64_t height{static_cast<int64_t>(layer0.height())};
+        const auto live = this->live_list(channels);
+#pragma omp parallel for schedule(static)
+        for (int64_t row = 0; row < height; ++row)
         {
-            size_t x = static_cast<size_t>(s) % layer0.width();
-            size_t y = static_cast<size_t>(s) / layer0.width();
-            for (size_t c{0}; c < layer0.channels(); ++c)
+            size_t y{static_cast<size_t>(row)};
+            for (size_t begin{0}; begin < width; begin += Tiles<Real>::size)
             {
-                Real value{_scale * layer1(x, y, c)};
-                if (c < _multiplier.size())
+                const Coverage coverage{tiles.coverage(begin, y)};
+                if (coverage == Coverage::none)
                 {
-                    value *= _multiplier[c];
+                    continue;
+                }
+                const size_t end{std::min(width, begin + Tiles<Real>::size)};
+                for (size_t x{begin}; x < end; ++x)
+                {
+                    // The mask weight is the same for every channel
+                    const Real t{coverage == Coverage::full ? static_cast<Real>(1.0) : mask(x, y)};
+                    for (const size_t c : live)
+                    {
+                        Real value{_scale * (uniform1 ? layer1.value(c) : layer1(x, y, c))};
+                        value *= multiplier[c];
+                        value += _offset;
+                        if (coverage == Coverage::full)
+                        {
+                            layer0(x, y, c) = layer0(x, y, c) * value;
+                        }
+                        else
+                        {
+                            layer0(x, y, c) = (static_cast<Real>(1.0) - t) * layer0(x, y, c) + t * layer0(x, y, c) * value;
+                        }
+                    }
                 }
-                value += _offset;
-                Real t{mask(x, y, 0)};
-                layer0(x, y, c) = (static_cast<Real>(1.0) - t) * layer0(x, y, c) + t * layer0(x, y, c) * value;
             }
         }
 
         return true;
     }
+
+    template <typename Real>
+    auto MultiplyOperator<Real>::uniform(const Layer<Real>& layer0, const Layer<Real>& layer1) const -> bool
+    {
+        return layer0.uniform() && layer1.uniform();
+    }
+
+    template <typename Real>
+    auto MultiplyOperator<Real>::reads_uniform1() const -> bool
+    {
+        return true;
+    }
 }
@@ -5,6 +5,7 @@
 #pragma once
 #include "op.h"
 #include "layer.h"
+#include "window.h"
 
 namespace bluedot {
     template <typename Real, typename RNG>
@@ -13,14 +14,18 @@ namespace bluedot {
         NoiseOperator(RNG& rng,
                       const std::vector<Real>& multiplier = {static_cast<Real>(0.0), static_cast<Real>(0.0), static_cast<Real>(0.0), static_cast<Real>(0.0)},
                       Real scale = static_cast<Real>(1.0),
-                      Real offset = static_cast<Real>(0.0));
+                      Real offset = static_cast<Real>(0.0),
+                      const Window& window = Window{0, 0, 0, 0});
         virtual auto operator()(Layer<Real>& layer) -> bool;
-        virtual auto operator()(Layer<Real>& layer, Layer<Real>& mask) -> bool;
+        virtual auto operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool;
+        virtual auto reads(const std::vector<bool>& needed) const -> std::vector<bool>;
     private:
+        auto skip(size_t count) -> void;
         RNG& _rng;
         std::vector<Real> _multiplier;
         Real _scale;
         Real _offset;
+        Window _window;
     };
 }
 
@@ -1,33 +1,55 @@
 // noiseop.hpp
 // Copyright Laurence Emms 2017
 
+#include <algorithm>
+#include <cassert>
 #include <boost/random.hpp>
 #include <omp.h>
 
 namespace bluedot {
     template <typename Real, typename RNG>
-    NoiseOperator<Real, RNG>::NoiseOperator(RNG& rng, const std::vector<Real>& multiplier, Real scale, Real offset) :
-        _rng(rng), _multiplier(multiplier), _scale(scale), _offset(offset)
+    NoiseOperator<Real, RNG>::NoiseOperator(RNG& rng, const std::vector<Real>& multiplier, Real scale, Real offset, const Window& window) :
+        _rng(rng), _multiplier(multiplier), _scale(scale), _offset(offset), _window(window)
     {
     }
 
     template <typename Real, typename RNG>
     auto NoiseOperator<Real, RNG>::operator()(Layer<Real>& layer) -> bool
     {
-        int num_samples = static_cast<int>(layer.width() * layer.height());
-        for (int s{0}; s < num_samples; ++s)
+        const Window window{_window.resolve(layer.width(), layer.height())};
+        const size_t width{layer.width()};
+        const size_t channels{layer.channels()};
+        // Samples are drawn serially, in row order over the whole map, so the result only depends on the seed
+        // Samples outside the layer's window are still drawn, so a window gets the same samples as the whole map
+        for (size_t map_y{0}; map_y < window.map_height; ++map_y)
         {
-            size_t x = static_cast<size_t>(s) % layer.width();
-            size_t y = static_cast<size_t>(s) / layer.width();
-            for (size_t c{0}; c < layer.channels(); ++c)
+            const size_t y{map_y - window.y};
+            if (map_y < window.y || y >= layer.height())
             {
-                Real value{static_cast<Real>(_rng()) * _scale};
-                if (c < _multiplier.size())
+                skip(window.map_width * channels);
+                continue;
+            }
+            size_t x{window.column(0)};
+            for (size_t map_x{0}; map_x < window.map_width; ++map_x)
+            {
+                if (x < width)
                 {
-                    value *= _multiplier[c];
+                    for (size_t c{0}; c < channels; ++c)
+                    {
+                        Real value{static_cast<Real>(_rng()) * _scale};
+                        if (c < _multiplier.size())
+                        {
+                            value *= _multiplier[c];
+                        }
+                        value += _offset;
+                        layer(x, y, c) = value;
+                    }
                 }
-                value += _offset;
-                layer(x, y, c) = value;
+                else
+                {
+                    skip(channels);
+                }
+                x = (x + 1 == window.map_width) ? 0 : x + 1;
             }
         }
 
@@ -35,28 +57,72 @@ namespace bluedot {
     }
 
     template <typename Real, typename RNG>
-    auto NoiseOperator<Real, RNG>::operator()(Layer<Real>& layer, Layer<Real>& mask) -> bool
+    auto NoiseOperator<Real, RNG>::operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool
     {
-        assert(mask.channels() > 0);
-
-        int num_samples = static_cast<int>(layer.width() * layer.height());
-        for (int s{0}; s < num_samples; ++s)
+        const Tiles<Real>& tiles{mask.tiles()};
+        const Window window{_window.resolve(layer.width(), layer.height())};
+        const size_t width{layer.width()};
+        const size_t channels{layer.channels()};
+        // Samples are drawn serially, in row order over the whole map, so the result only depends on the seed
+        // Samples outside the window or under tiles the mask leaves untouched are still drawn,
+        // so the sequence does not depend on the mask or the window
+        for (size_t map_y{0}; map_y < window.map_height; ++map_y)
         {
-            size_t x = static_cast<size_t>(s) % layer.width();
-            size_t y = static_cast<size_t>(s) / layer.width();
-            for (size_t c{0}; c < layer.channels(); ++c)
+            const size_t y{map_y - window.y};
+            if (map_y < window.y || y >= layer.height())
             {
-                Real value{static_cast<Real>(_rng()) * _scale};
-                if (c < _multiplier.size())
+                skip(window.map_width * channels);
+                continue;
+            }
+            size_t x{window.column(0)};
+            for (size_t map_x{0}; map_x < window.map_width; ++map_x)
+            {
+                const Coverage coverage{x < width ? tiles.coverage(x, y) : Coverage::none};
+                if (coverage == Coverage::none)
                 {
-                    value *= _multiplier[c];
+                    skip(channels);
                 }
-                value += _offset;
-                Real t{mask(x, y, 0)};
-                layer(x, y, c) = (static_cast<Real>(1.0) - t) * layer(x, y, c) + t * value;
+                else
+                {
+                    for (size_t c{0}; c < channels; ++c)
+                    {
+                        Real value{static_cast<Real>(_rng()) * _scale};
+                        if (c < _multiplier.size())
+                        {
+                            value *= _multiplier[c];
+                        }
+                        value += _offset;
+                        if (coverage == Coverage::full)
+                        {
+                            layer(x, y, c) = value;
+                        }
+                        else
+                        {
+                            Real t{mask(x, y)};
+                            layer(x, y, c) = (static_cast<Real>(1.0) - t) * layer(x, y, c) + t * value;
+                        }
+                    }
+                }
+                x = (x + 1 == window.map_width) ? 0 : x + 1;
             }
         }
 
         return true;
     }
+
+    template <typename Real, typename RNG>
+    auto NoiseOperator<Real, RNG>::skip(size_t count) -> void
+    {
+        for (size_t i{0}; i < count; ++i)
+        {
+            _rng();
+        }
+    }
+
+    template <typename Real, typename RNG>
+    auto NoiseOperator<Real, RNG>::reads(const std::vector<bool>& needed) const -> std::vector<bool>
+    {
+        // Every channel is overwritten without being read, though samples are still drawn for every channel
+        return std::vector<bool>(needed.size(), false);
+    }
 }
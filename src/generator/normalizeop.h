@@ -13,7 +13,12 @@ namespace bluedot {
     public:
         NormalizeOperator();
         virtual auto operator()(Layer<Real>& layer) -> bool;
-        virtual auto operator()(Layer<Real>& layer, Layer<Real>& mask) -> bool;
+        virtual auto operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool;
+        virtual auto footprint() const -> Footprint;
+        virtual auto writes(size_t channels) const -> std::vector<bool>;
+        virtual auto reads(const std::vector<bool>& needed) const -> std::vector<bool>;
+    private:
+        auto find_range(Layer<Real>& layer, Real& min_value, Real& max_value) const -> void;
     };
 }
 
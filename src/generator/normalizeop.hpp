@@ -1,6 +1,11 @@
 // normalizeop.hpp
 // Copyright Laurence Emms 2017
 
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+
 namespace bluedot {
     template <typename Real>
     NormalizeOperator<Real>::NormalizeOperator()
@@ -10,29 +15,24 @@ namespace bluedot {
     template <typename Real>
     auto NormalizeOperator<Real>::operator()(Layer<Real>& layer) -> bool
     {
-        int num_samples = static_cast<int>(layer.width() * layer.height());
         Real min_value{std::numeric_limits<Real>::max()};
         Real max_value{-std::numeric_limits<Real>::max()};
-        for (int s{0}; s < num_samples; ++s)
-        {
-            size_t x = static_cast<size_t>(s) % layer.width();
-            size_t y = static_cast<size_t>(s) / layer.width();
-            for (size_t c{1}; c < layer.channels(); ++c)
-            {
-                min_value = std::min(min_value, layer(x, y, c));
-                max_value = std::max(max_value, layer(x, y, c));
-            }
-        }
+        find_range(layer, min_value, max_value);
 
         Real range{static_cast<Real>(1.0) / (max_value - min_value)};
-#pragma omp parallel for schedule(guided)
-        for (int s{0}; s < num_samples; ++s)
+        const size_t width{layer.width()};
+        const int64_t height{static_cast<int64_t>(layer.height())};
+        const auto live = this->live_list(layer.channels(), 1);
+#pragma omp parallel for schedule(static)
+        for (int64_t row = 0; row < height; ++row)
         {
-            size_t x = static_cast<size_t>(s) % layer.width();
-            size_t y = static_cast<size_t>(s) / layer.width();
-            for (size_t c{1}; c < layer.channels(); ++c)
+            size_t y{static_cast<size_t>(row)};
+            for (size_t x{0}; x < width; ++x)
             {
-                layer(x, y, c) = (layer(x, y, c) - min_value) * range;
+                for (const size_t c : live)
+                {
+                    layer(x, y, c) = (layer(x, y, c) - min_value) * range;
+                }
             }
         }
 
@@ -40,37 +40,97 @@ namespace bluedot {
     }
 
     template <typename Real>
-    auto NormalizeOperator<Real>::operator()(Layer<Real>& layer, Layer<Real>& mask) -> bool
+    auto NormalizeOperator<Real>::operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool
     {
-        assert(mask.channels() > 0);
-
-        int num_samples = static_cast<int>(layer.width() * layer.height());
         Real min_value{std::numeric_limits<Real>::max()};
         Real max_value{-std::numeric_limits<Real>::max()};
-        for (int s{0}; s < num_samples; ++s)
+        find_range(layer, min_value, max_value);
+
+        Real range{static_cast<Real>(1.0) / (max_value - min_value)};
+        const Tiles<Real>& tiles{mask.tiles()};
+        const size_t width{layer.width()};
+        const int64_t height{static_cast<int64_t>(layer.height())};
+        const auto live = this->live_list(layer.channels(), 1);
+#pragma omp parallel for schedule(static)
+        for (int64_t row = 0; row < height; ++row)
         {
-            size_t x = static_cast<size_t>(s) % layer.width();
-            size_t y = static_cast<size_t>(s) / layer.width();
-            for (size_t c{1}; c < layer.channels(); ++c)
+            size_t y{static_cast<size_t>(row)};
+            for (size_t begin{0}; begin < width; begin += Tiles<Real>::size)
             {
-                min_value = std::min(min_value, layer(x, y, c));
-                max_value = std::max(max_value, layer(x, y, c));
+                const Coverage coverage{tiles.coverage(begin, y)};
+                if (coverage == Coverage::none)
+                {
+                    continue;
+                }
+                const size_t end{std::min(width, begin + Tiles<Real>::size)};
+                for (size_t x{begin}; x < end; ++x)
+                {
+                    for (const size_t c : live)
+                    {
+                        if (coverage == Coverage::full)
+                        {
+                            layer(x, y, c) = (layer(x, y, c) - min_value) * range;
+                        }
+                        else
+                        {
+                            Real t{mask(x, y)};
+                            layer(x, y, c) = (static_cast<Real>(1.0) - t) * layer(x, y, c) + t * (layer(x, y, c) - min_value) * range;
+                        }
+                    }
+                }
             }
         }
 
-        Real range{static_cast<Real>(1.0) / (max_value - min_value)};
-#pragma omp parallel for schedule(guided)
-        for (int s{0}; s < num_samples; ++s)
+        return true;
+    }
+
+    template <typename Real>
+    auto NormalizeOperator<Real>::find_range(Layer<Real>& layer, Real& min_value, Real& max_value) const -> void
+    {
+        const size_t width{layer.width()};
+        const int64_t height{static_cast<int64_t>(layer.height())};
+#pragma omp parallel
         {
-            size_t x = static_cast<size_t>(s) % layer.width();
-            size_t y = static_cast<size_t>(s) / layer.width();
-            for (size_t c{1}; c < layer.channels(); ++c)
+            Real thread_min{std::numeric_limits<Real>::max()};
+            Real thread_max{-std::numeric_limits<Real>::max()};
+#pragma omp for schedule(static)
+            for (int64_t row = 0; row < height; ++row)
             {
-                Real t{mask(x, y, 0)};
-                layer(x, y, c) = (static_cast<Real>(1.0) - t) * layer(x, y, c) + t * (layer(x, y, c) - min_value) * range;
+                size_t y{static_cast<size_t>(row)};
+                for (size_t x{0}; x < width; ++x)
+                {
+                    for (size_t c{1}; c < layer.channels(); ++c)
+                    {
+                        thread_min = std::min(thread_min, layer(x, y, c));
+                        thread_max = std::max(thread_max, layer(x, y, c));
+                    }
+                }
+            }
+#pragma omp critical
+            {
+                min_value = std::min(min_value, thread_min);
+                max_value = std::max(max_value, thread_max);
             }
         }
+    }
 
-        return true;
+    template <typename Real>
+    auto NormalizeOperator<Real>::footprint() const -> Footprint
+    {
+        // The range is found over the whole layer
+        return Footprint{0, true, true};
+    }
+
+    template <typename Real>
+    auto NormalizeOperator<Real>::writes(size_t channels) const -> std::vector<bool>
+    {
+        return channel_range(channels, 1, channels);
+    }
+
+    template <typename Real>
+    auto NormalizeOperator<Real>::reads(const std::vector<bool>& needed) const -> std::vector<bool>
+    {
+        // The range is found over all color channels
+        return channel_range(needed.size(), 1, any_channel(needed) ? needed.size() : 0);
     }
-}
\ No newline at end of file
+}
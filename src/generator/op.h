@@ -3,20 +3,143 @@
 // Copyright Laurence Emms 2017
 
 #pragma once
+#include <vector>
+#include "channels.h"
 #include "layer.h"
+#include "mask.h"
 
 namespace bluedot {
+    // The samples an operator reads to compute each sample it writes
+    struct Footprint {
+        // Distance in x and in y from the sample
+        size_t radius;
+        // Whether neighbours wrap around in x, rather than clamping to the edge
+        bool spherical;
+        // Whether the operator reads the whole layer, as operators using statistics of the layer do
+        bool whole;
+    };
+
+    // Flags for the channels from first up to last of a layer with the given number of channels
+    inline auto channel_range(size_t channels, size_t first, size_t last) -> std::vector<bool>
+    {
+        std::vector<bool> range(channels, false);
+        for (size_t c{first}; c < last && c < channels; ++c)
+        {
+            range[c] = true;
+        }
+        return range;
+    }
+
+    inline auto any_channel(const std::vector<bool>& channels) -> bool
+    {
+        for (bool channel : channels)
+        {
+            if (channel)
+                return true;
+        }
+        return false;
+    }
+
+    // Channels are given as a flag per channel of the layer.
+    // An operator told which channels are live, meaning read after it, may leave the others uncomputed.
     template <typename Real>
     class UnaryOperator {
     public:
         virtual auto operator()(Layer<Real>& layer) -> bool = 0;
-        virtual auto operator()(Layer<Real>& layer, Layer<Real>& mask) -> bool = 0;
+        virtual auto operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool = 0;
+        // Operators that only read the samples they write keep the default
+        virtual auto footprint() const -> Footprint { return Footprint{0, true, false}; }
+        // Channels the operator may change, of a layer with the given number of channels
+        virtual auto writes(size_t channels) const -> std::vector<bool> { return std::vector<bool>(channels, true); }
+        // Channels read to compute the needed channels among those written,
+        // which for operators working on each channel on its own are the needed channels
+        virtual auto reads(const std::vector<bool>& needed) const -> std::vector<bool> { return needed; }
+        // Whether, without a mask, the operator applies to the layer by changing its uniform values rather than its samples
+        virtual auto uniform(const Layer<Real>&) const -> bool { return false; }
+        // Every channel is live until the operator is told otherwise
+        auto live_channels(const std::vector<bool>& channels) -> void { _live = channels; }
+    protected:
+        auto live(size_t channel) const -> bool { return channel >= _live.size() || _live[channel]; }
+        // Live channels from first up to the given number of channels, found once per application rather than per sample
+        template <typename Count>
+        auto live_list(Count channels, size_t first = 0) const -> decltype(channel_list(std::vector<bool>{}, channels)) { return channel_list(_live, channels, first); }
+    private:
+        std::vector<bool> _live;
     };
 
+    // Binary operators write layer0 and read layer1, unless they say they write layer1 as well
     template <typename Real>
     class BinaryOperator {
     public:
         virtual auto operator()(Layer<Real>& layer0, Layer<Real>& layer1) -> bool = 0;
-        virtual auto operator()(Layer<Real>& layer0, Layer<Real>& layer1, Layer<Real>& mask) -> bool = 0;
+        virtual auto operator()(Layer<Real>& layer0, Layer<Real>& layer1, const MaskView<Real>& mask) -> bool = 0;
+        virtual auto footprint() const -> Footprint { return Footprint{0, true, false}; }
+        virtual auto writes(size_t channels) const -> std::vector<bool> { return std::vector<bool>(channels, true); }
+        virtual auto writes_layer1() const -> bool { return false; }
+        // Whether, without a mask, the operator exchanges or shares the storage of its layers rather than writing samples,
+        // so layers sharing storage need not be given their own first
+        virtual auto moves_storage() const -> bool { return false; }
+        // Channels of layer0 and of layer1 read to compute the needed channels of layer0
+        virtual auto reads0(const std::vector<bool>& needed) const -> std::vector<bool> { return needed; }
+        virtual auto reads1(const std::vector<bool>& needed) const -> std::vector<bool> { return needed; }
+        // Whether, without a mask, the operator applies to the layers by changing the uniform values of layer0 rather than its samples
+        virtual auto uniform(const Layer<Real>&, const Layer<Real>&) const -> bool { return false; }
+        // Whether the operator reads a uniform layer1 through its values, so its samples need not be stored
+        virtual auto reads_uniform1() const -> bool { return false; }
+        // Live channels of layer0
+        auto live_channels(const std::vector<bool>& channels) -> void { _live = channels; }
+    protected:
+        auto live(size_t channel) const -> bool { return channel >= _live.size() || _live[channel]; }
+        template <typename Count>
+        auto live_list(Count channels, size_t first = 0) const -> decltype(channel_list(std::vector<bool>{}, channels)) { return channel_list(_live, channels, first); }
+    private:
+        std::vector<bool> _live;
+    };
+
+    // Before an operator is applied, layers sharing storage are given their own if the operator writes them,
+    // and uniform layers store their samples unless the operator works on their values.
+    // Nothing is copied or stored for an unmasked operator that reads none of the layer.
+    template <typename Real>
+    auto prepare_layers(Layer<Real>& layer, const UnaryOperator<Real>& op, bool masked) -> void
+    {
+        if (!masked && op.uniform(layer))
+            return;
+        const size_t channels{layer.channels()};
+        const bool keep{masked || any_channel(op.reads(std::vector<bool>(channels, true)))};
+        if (any_channel(op.writes(channels)))
+            layer.detach(keep);
+        layer.materialize(keep);
+    }
+
+    template <typename Real>
+    auto prepare_layers(Layer<Real>& layer0, Layer<Real>& layer1, const BinaryOperator<Real>& op, bool masked) -> void
+    {
+        if (!masked && (op.moves_storage() || op.uniform(layer0, layer1)))
+            return;
+        const size_t channels{layer0.channels()};
+        const bool keep{masked || any_channel(op.reads0(std::vector<bool>(channels, true)))};
+        if (any_channel(op.writes(channels)))
+            layer0.detach(keep);
+        layer0.materialize(keep);
+        if (op.writes_layer1())
+            layer1.detach();
+        if (op.writes_layer1() || !op.reads_uniform1() || layer1.compressed())
+            layer1.materialize();
+    }
+
+    // Operations that select samples of a layer into a mask
+    template <typename Real>
+    class MaskOperator {
+    public:
+        virtual auto operator()(const Layer<Real>& layer, MaskLayer<Real>& mask) -> bool = 0;
+    };
+
+    // Operations on any number of layers, which may read and write each of them
+    template <typename Real>
+    class NaryOperator {
+    public:
+        virtual auto operator()(const std::vector<Layer<Real>*>& layers) -> bool = 0;
+        virtual auto operator()(const std::vector<Layer<Real>*>& layers, const MaskView<Real>& mask) -> bool = 0;
+        virtual auto footprint() const -> Footprint { return Footprint{0, true, false}; }
     };
 }
\ No newline at end of file
@@ -0,0 +1,52 @@
+// output.h
+// Writing layers to files
+// Real samples are written raw, straight from the memory of the layer where the channels allow,
+// row by row from the top with channels interleaved, in the byte order of the machine.
+// 8 and 16 bit samples are clamped to [0, 1] and written as a binary PGM for one channel,
+// a PPM for three channels, or a PAM for any other number of channels.
+// Copyright Laurence Emms 2017
+
+#pragma once
+#include <future>
+#include <string>
+#include <vector>
+#include "layer.h"
+#include "window.h"
+
+namespace bluedot {
+    enum class OutputFormat {
+        real,
+        sixteen_bit,
+        eight_bit
+    };
+
+    // Writes channels of the width by height window of the layer whose top left sample is (x, y)
+    // Every channel is written when none are given, and a width or height of zero extends the window to the edge of the layer
+    // Fails if the window or a channel is outside the layer, or the file cannot be written
+    template <typename Real>
+    auto write_layer(const Layer<Real>& layer, const std::string& file, OutputFormat format, const std::vector<size_t>& channels = {},
+                     size_t x = 0, size_t y = 0, size_t width = 0, size_t height = 0) -> bool;
+
+    // Writes the same window of the layer as write_layer over the part of the map it covers in a file of the whole map,
+    // which write_layer wrote before. window places the layer within the map, as for the operators.
+    // Fails if the file does not hold an image of the map in the format with the number of channels written
+    template <typename Real>
+    auto patch_layer(const Layer<Real>& layer, const std::string& file, OutputFormat format, const std::vector<size_t>& channels, const Window& window,
+                     size_t x, size_t y, size_t width, size_t height) -> bool;
+
+    // Writes layers on background threads, so that a layer is encoded and written while the operators
+    // carry on with other layers. Background writes convert samples on a single thread to leave the cores to the operators.
+    // A layer must not change until finish returns, and destroying the queue waits for the writes still running.
+    template <typename Real>
+    class OutputQueue {
+    public:
+        auto write(const Layer<Real>& layer, const std::string& file, OutputFormat format, const std::vector<size_t>& channels = {},
+                   size_t x = 0, size_t y = 0, size_t width = 0, size_t height = 0) -> void;
+        // Waits for every write, and returns the files that could not be written
+        auto finish() -> std::vector<std::string>;
+    private:
+        std::vector<std::pair<std::string, std::future<bool>>> _writes;
+    };
+}
+
+#include "output.hpp"
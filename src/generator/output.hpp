@@ -0,0 +1,280 @@
+// output.hpp
+// Copyright Laurence Emms 2017
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <utility>
+#include <omp.h>
+
+namespace bluedot {
+    // Channels to write, every channel of the layer when none are given, or empty if a channel is outside the layer
+    template <typename Real>
+    auto selected_channels(const Layer<Real>& layer, const std::vector<size_t>& channels) -> std::vector<size_t>
+    {
+        std::vector<size_t> selected{channels};
+        if (selected.empty())
+        {
+            for (size_t c{0}; c < layer.channels(); ++c)
+            {
+                selected.push_back(c);
+            }
+        }
+        for (size_t c : selected)
+        {
+            if (c >= layer.channels())
+                return {};
+        }
+        return selected;
+    }
+
+    // Bytes of a sample in the file
+    template <typename Real>
+    auto sample_bytes(OutputFormat format) -> size_t
+    {
+        return format == OutputFormat::real ? sizeof(Real) : format == OutputFormat::sixteen_bit ? static_cast<size_t>(2) : static_cast<size_t>(1);
+    }
+
+    // Header of a PGM, PPM or PAM image
+    inline auto image_header(const std::string& file, OutputFormat format, size_t depth, size_t width, size_t height) -> std::string
+    {
+        const int maximum{format == OutputFormat::sixteen_bit ? 65535 : 255};
+        std::ostringstream header;
+        if (depth == 1 || depth == 3)
+        {
+            header << (depth == 1 ? "P5\n" : "P6\n");
+            header << "# " << file << "\n";
+            header << width << " " << height << " " << maximum << " ";
+        }
+        else
+        {
+            header << "P7\n";
+            header << "WIDTH " << width << "\nHEIGHT " << height << "\nDEPTH " << depth << "\n";
+            header << "MAXVAL " << maximum << "\nENDHDR\n";
+        }
+        return header.str();
+    }
+
+    // Converts the width samples of the selected channels from (x, y) along a row of the layer to the bytes of the file
+    template <typename Real>
+    auto encode_row(const Layer<Real>& layer, const std::vector<size_t>& selected, OutputFormat format, size_t x, size_t y, size_t width, unsigned char* bytes_out) -> void
+    {
+        const size_t depth{selected.size()};
+        if (format == OutputFormat::real)
+        {
+            for (size_t i{0}; i < width; ++i)
+            {
+                for (size_t k{0}; k < depth; ++k)
+                {
+                    std::memcpy(bytes_out + (i * depth + k) * sizeof(Real), &layer(x + i, y, selected[k]), sizeof(Real));
+                }
+            }
+            return;
+        }
+        const size_t bytes{sample_bytes<Real>(format)};
+        const Real maximum{format == OutputFormat::sixteen_bit ? static_cast<Real>(65535.0) : static_cast<Real>(255.0)};
+        for (size_t i{0}; i < width; ++i)
+        {
+            for (size_t k{0}; k < depth; ++k)
+            {
+                Real value{std::max(static_cast<Real>(0.0), std::min(static_cast<Real>(1.0), layer(x + i, y, selected[k]))) * maximum};
+                size_t n{i * depth + k};
+                if (bytes == 1)
+                {
+                    bytes_out[n] = static_cast<unsigned char>(value);
+                }
+                else
+                {
+                    // 16 bit samples are big endian
+                    uint16_t sample{static_cast<uint16_t>(value)};
+                    bytes_out[2 * n] = static_cast<unsigned char>(sample >> 8);
+                    bytes_out[2 * n + 1] = static_cast<unsigned char>(sample & 0xff);
+                }
+            }
+        }
+    }
+
+    template <typename Real>
+    auto write_layer(const Layer<Real>& layer, const std::string& file, OutputFormat format, const std::vector<size_t>& channels,
+                     size_t x, size_t y, size_t width, size_t height) -> bool
+    {
+        if (x > layer.width() || y > layer.height())
+            return false;
+        if (width == 0)
+            width = layer.width() - x;
+        if (height == 0)
+            height = layer.height() - y;
+        if (x + width > layer.width() || y + height > layer.height())
+            return false;
+
+        const std::vector<size_t> selected{selected_channels(layer, channels)};
+        if (selected.empty())
+            return false;
+        // All channels in order can be written straight from the layer
+        bool contiguous{selected.size() == layer.channels()};
+        for (size_t i{0}; i < selected.size(); ++i)
+        {
+            contiguous = contiguous && selected[i] == i;
+        }
+        const size_t depth{selected.size()};
+
+        std::ofstream out{file, std::ios::out | std::ios::binary};
+        if (!out)
+            return false;
+
+        if (format == OutputFormat::real)
+        {
+            if (contiguous && width == layer.width())
+            {
+                // The rows are adjacent in the layer, so they go out in a single write
+                out.write(reinterpret_cast<const char*>(&layer(0, y, 0)), static_cast<std::streamsize>(width * height * depth * sizeof(Real)));
+            }
+            else if (contiguous)
+            {
+                for (size_t j{0}; j < height; ++j)
+                {
+                    out.write(reinterpret_cast<const char*>(&layer(x, y + j, 0)), static_cast<std::streamsize>(width * depth * sizeof(Real)));
+                }
+            }
+            else
+            {
+                std::vector<Real> row(width * depth);
+                for (size_t j{0}; j < height; ++j)
+                {
+                    for (size_t i{0}; i < width; ++i)
+                    {
+                        for (size_t k{0}; k < depth; ++k)
+                        {
+                            row[i * depth + k] = layer(x + i, y + j, selected[k]);
+                        }
+                    }
+                    out.write(reinterpret_cast<const char*>(row.data()), static_cast<std::streamsize>(row.size() * sizeof(Real)));
+                }
+            }
+            return static_cast<bool>(out);
+        }
+
+        const size_t bytes{sample_bytes<Real>(format)};
+        out << image_header(file, format, depth, width, height);
+
+        // Bands of rows are converted in parallel and written with one write per band,
+        // each on a background thread while the next band is converted into the other buffer
+        const size_t band_rows{64};
+        const size_t row_bytes{width * depth * bytes};
+        std::vector<unsigned char> buffers[2];
+        buffers[0].resize(row_bytes * std::min(band_rows, height));
+        buffers[1].resize(buffers[0].size());
+        std::future<void> pending;
+        for (size_t top{0}; top < height; top += band_rows)
+        {
+            const int64_t rows{static_cast<int64_t>(std::min(band_rows, height - top))};
+            std::vector<unsigned char>& band{buffers[(top / band_rows) % 2]};
+#pragma omp parallel for schedule(static)
+            for (int64_t row = 0; row < rows; ++row)
+            {
+                size_t j{static_cast<size_t>(row)};
+                encode_row(layer, selected, format, x, y + top + j, width, &band[j * row_bytes]);
+            }
+            if (pending.valid())
+                pending.wait();
+            const std::streamsize size{static_cast<std::streamsize>(static_cast<size_t>(rows) * row_bytes)};
+            pending = std::async(std::launch::async, [&out, &band, size]() { out.write(reinterpret_cast<const char*>(band.data()), size); });
+        }
+        if (pending.valid())
+            pending.wait();
+        return static_cast<bool>(out);
+    }
+
+    template <typename Real>
+    auto patch_layer(const Layer<Real>& layer, const std::string& file, OutputFormat format, const std::vector<size_t>& channels, const Window& window,
+                     size_t x, size_t y, size_t width, size_t height) -> bool
+    {
+        const Window placement{window.resolve(layer.width(), layer.height())};
+        const std::vector<size_t> selected{selected_channels(layer, channels)};
+        if (selected.empty() || x + width > layer.width() || y + height > layer.height() || width > placement.map_width ||
+            placement.y + y + height > placement.map_height)
+            return false;
+        const size_t depth{selected.size()};
+
+        // The samples end the file, and what comes before them must be the header of an image of the whole map
+        std::fstream io{file, std::ios::in | std::ios::out | std::ios::binary};
+        io.seekg(0, std::ios::end);
+        const std::streamoff length{io.tellg()};
+        const std::streamoff samples{static_cast<std::streamoff>(placement.map_width * placement.map_height * depth * sample_bytes<Real>(format))};
+        if (!io || length < samples)
+            return false;
+        const std::streamoff offset{length - samples};
+        if (format != OutputFormat::real)
+        {
+            std::string header(static_cast<size_t>(offset), '\0');
+            io.seekg(0);
+            io.read(&header[0], offset);
+            // PGM and PPM headers name the file they were written as, which may since have moved, so only the rest must match
+            const std::string expected{image_header("", format, depth, placement.map_width, placement.map_height)};
+            const size_t name{expected.find("# ")};
+            const std::string prefix{name == std::string::npos ? expected : expected.substr(0, name + 2)};
+            const std::string suffix{name == std::string::npos ? std::string{} : expected.substr(name + 2)};
+            const bool matches{header.size() >= expected.size() && header.compare(0, prefix.size(), prefix) == 0 &&
+                               header.compare(header.size() - suffix.size(), suffix.size(), suffix) == 0 &&
+                               (name != std::string::npos || header.size() == expected.size())};
+            if (!io || !matches)
+                return false;
+        }
+        else if (offset != 0)
+        {
+            return false;
+        }
+
+        const size_t row_bytes{width * depth * sample_bytes<Real>(format)};
+        std::vector<unsigned char> rows(row_bytes * height);
+        const int64_t count{static_cast<int64_t>(height)};
+#pragma omp parallel for schedule(static)
+        for (int64_t row = 0; row < count; ++row)
+        {
+            encode_row(layer, selected, format, x, y + static_cast<size_t>(row), width, &rows[static_cast<size_t>(row) * row_bytes]);
+        }
+
+        // Rows of a window wrapping around the seam are written in two parts
+        const size_t first{(placement.x + x) % placement.map_width};
+        const size_t before_seam{std::min(width, placement.map_width - first)};
+        const size_t sample_size{depth * sample_bytes<Real>(format)};
+        for (size_t j{0}; j < height; ++j)
+        {
+            const size_t map_row{placement.y + y + j};
+            const char* row{reinterpret_cast<const char*>(&rows[j * row_bytes])};
+            io.seekp(offset + static_cast<std::streamoff>((map_row * placement.map_width + first) * sample_size));
+            io.write(row, static_cast<std::streamsize>(before_seam * sample_size));
+            if (before_seam < width)
+            {
+                io.seekp(offset + static_cast<std::streamoff>(map_row * placement.map_width * sample_size));
+                io.write(row + before_seam * sample_size, static_cast<std::streamsize>((width - before_seam) * sample_size));
+            }
+        }
+        return static_cast<bool>(io);
+    }
+
+    template <typename Real>
+    auto OutputQueue<Real>::write(const Layer<Real>& layer, const std::string& file, OutputFormat format, const std::vector<size_t>& channels,
+                                  size_t x, size_t y, size_t width, size_t height) -> void
+    {
+        _writes.emplace_back(file, std::async(std::launch::async, [&layer, file, format, channels, x, y, width, height]() {
+            omp_set_num_threads(1);
+            return write_layer(layer, file, format, channels, x, y, width, height);
+        }));
+    }
+
+    template <typename Real>
+    auto OutputQueue<Real>::finish() -> std::vector<std::string>
+    {
+        std::vector<std::string> failed;
+        for (std::pair<std::string, std::future<bool>>& write : _writes)
+        {
+            if (!write.second.get())
+                failed.push_back(write.first);
+        }
+        _writes.clear();
+        return failed;
+    }
+}
@@ -0,0 +1,30 @@
+// percentilenormalizeop.h
+// Percentile normalize operator
+// Normalizes the color channels into the range 0-1 between two percentiles of their histogram,
+// clamping the samples outside, so that a few outliers do not squash the range
+// Copyright Laurence Emms 2017
+
+#pragma once
+#include "op.h"
+#include "layer.h"
+#include "histogram.h"
+
+namespace bluedot {
+    template <typename Real>
+    class PercentileNormalizeOperator : public UnaryOperator<Real> {
+    public:
+        PercentileNormalizeOperator(Real low = static_cast<Real>(0.01), Real high = static_cast<Real>(0.99), size_t bins = 4096);
+        virtual auto operator()(Layer<Real>& layer) -> bool;
+        virtual auto operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool;
+        virtual auto footprint() const -> Footprint;
+        virtual auto writes(size_t channels) const -> std::vector<bool>;
+        virtual auto reads(const std::vector<bool>& needed) const -> std::vector<bool>;
+    private:
+        auto normalize(Layer<Real>& layer, const MaskView<Real>* mask) const -> void;
+        Real _low;
+        Real _high;
+        size_t _bins;
+    };
+}
+
+#include "percentilenormalizeop.hpp"
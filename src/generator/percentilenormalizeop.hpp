@@ -0,0 +1,92 @@
+// percentilenormalizeop.hpp
+// Copyright Laurence Emms 2017
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+namespace bluedot {
+    template <typename Real>
+    PercentileNormalizeOperator<Real>::PercentileNormalizeOperator(Real low, Real high, size_t bins) : _low(low), _high(high), _bins(bins)
+    {
+    }
+
+    template <typename Real>
+    auto PercentileNormalizeOperator<Real>::operator()(Layer<Real>& layer) -> bool
+    {
+        normalize(layer, nullptr);
+        return true;
+    }
+
+    template <typename Real>
+    auto PercentileNormalizeOperator<Real>::operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool
+    {
+        normalize(layer, &mask);
+        return true;
+    }
+
+    template <typename Real>
+    auto PercentileNormalizeOperator<Real>::normalize(Layer<Real>& layer, const MaskView<Real>* mask) const -> void
+    {
+        const Tiles<Real>* tiles{mask ? &mask->tiles() : nullptr};
+        Histogram<Real> histogram{_bins};
+        histogram.build(layer, 1, layer.channels());
+        const Real min_value{histogram.percentile(_low)};
+        const Real max_value{histogram.percentile(_high)};
+        const Real range{max_value > min_value ? static_cast<Real>(1.0) / (max_value - min_value) : static_cast<Real>(0.0)};
+
+        const size_t width{layer.width()};
+        const int64_t height{static_cast<int64_t>(layer.height())};
+        const auto live = this->live_list(layer.channels(), 1);
+#pragma omp parallel for schedule(static)
+        for (int64_t row = 0; row < height; ++row)
+        {
+            size_t y{static_cast<size_t>(row)};
+            for (size_t begin{0}; begin < width; begin += Tiles<Real>::size)
+            {
+                const Coverage coverage{tiles ? tiles->coverage(begin, y) : Coverage::full};
+                if (coverage == Coverage::none)
+                {
+                    continue;
+                }
+                const size_t end{std::min(width, begin + Tiles<Real>::size)};
+                for (size_t x{begin}; x < end; ++x)
+                {
+                    for (const size_t c : live)
+                    {
+                        Real value{std::max(static_cast<Real>(0.0), std::min(static_cast<Real>(1.0), (layer(x, y, c) - min_value) * range))};
+                        if (coverage == Coverage::partial)
+                        {
+                            Real t{(*mask)(x, y)};
+                            layer(x, y, c) = (static_cast<Real>(1.0) - t) * layer(x, y, c) + t * value;
+                        }
+                        else
+                        {
+                            layer(x, y, c) = value;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    template <typename Real>
+    auto PercentileNormalizeOperator<Real>::footprint() const -> Footprint
+    {
+        // The percentiles are found over the whole layer
+        return Footprint{0, true, true};
+    }
+
+    template <typename Real>
+    auto PercentileNormalizeOperator<Real>::writes(size_t channels) const -> std::vector<bool>
+    {
+        return channel_range(channels, 1, channels);
+    }
+
+    template <typename Real>
+    auto PercentileNormalizeOperator<Real>::reads(const std::vector<bool>& needed) const -> std::vector<bool>
+    {
+        // The histogram is built over all color channels
+        return channel_range(needed.size(), 1, any_channel(needed) ? needed.size() : 0);
+    }
+}
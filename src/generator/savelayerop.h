@@ -0,0 +1,27 @@
+// savelayerop.h
+// Save layer operator
+// Writes the layer to a binary layer file, which the LoadLayerOperator reads in later runs
+// The layer must hold the whole map, and is saved whole even when a mask is given
+// Copyright Laurence Emms 2017
+
+#pragma once
+#include <string>
+#include "op.h"
+#include "layer.h"
+
+namespace bluedot {
+    template <typename Real>
+    class SaveLayerOperator : public UnaryOperator<Real> {
+    public:
+        SaveLayerOperator(const std::string& file);
+        virtual auto operator()(Layer<Real>& layer) -> bool;
+        virtual auto operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool;
+        virtual auto footprint() const -> Footprint;
+        virtual auto writes(size_t channels) const -> std::vector<bool>;
+        virtual auto reads(const std::vector<bool>& needed) const -> std::vector<bool>;
+    private:
+        std::string _file;
+    };
+}
+
+#include "savelayerop.hpp"
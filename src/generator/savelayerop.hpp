@@ -0,0 +1,44 @@
+// savelayerop.hpp
+// Copyright Laurence Emms 2017
+
+#include "layerfile.h"
+
+namespace bluedot {
+    template <typename Real>
+    SaveLayerOperator<Real>::SaveLayerOperator(const std::string& file) : _file(file)
+    {
+    }
+
+    template <typename Real>
+    auto SaveLayerOperator<Real>::operator()(Layer<Real>& layer) -> bool
+    {
+        return save_layer(layer, _file);
+    }
+
+    template <typename Real>
+    auto SaveLayerOperator<Real>::operator()(Layer<Real>& layer, const MaskView<Real>&) -> bool
+    {
+        // A mask does not limit what is saved, as layer files always hold the whole layer
+        return save_layer(layer, _file);
+    }
+
+    template <typename Real>
+    auto SaveLayerOperator<Real>::footprint() const -> Footprint
+    {
+        // Saved layers hold the whole map, so a region is rendered on the whole map when a layer is saved
+        return Footprint{0, true, true};
+    }
+
+    template <typename Real>
+    auto SaveLayerOperator<Real>::writes(size_t channels) const -> std::vector<bool>
+    {
+        return std::vector<bool>(channels, false);
+    }
+
+    template <typename Real>
+    auto SaveLayerOperator<Real>::reads(const std::vector<bool>& needed) const -> std::vector<bool>
+    {
+        // The whole layer is saved
+        return std::vector<bool>(needed.size(), true);
+    }
+}
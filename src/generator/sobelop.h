@@ -0,0 +1,34 @@
+// sobelop.h
+// Compute the Sobel gradient of the alpha channel
+// Stores the gradient in the R and G channels, in the same units as GradientOperator
+// Copyright Laurence Emms 2017
+
+#pragma once
+#include "op.h"
+#include "layer.h"
+#include "stencil.h"
+
+namespace bluedot {
+    template <typename Real>
+    class SobelOperator : public UnaryOperator<Real> {
+    public:
+        SobelOperator(const std::vector<Real>& multiplier = {static_cast<Real>(0.0), static_cast<Real>(0.0), static_cast<Real>(0.0), static_cast<Real>(0.0)},
+                      Real scale = static_cast<Real>(1.0),
+                      Real offset = static_cast<Real>(0.0),
+                      bool spherical = true);
+        virtual auto operator()(Layer<Real>& layer) -> bool;
+        virtual auto operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool;
+        virtual auto footprint() const -> Footprint;
+        virtual auto writes(size_t channels) const -> std::vector<bool>;
+        virtual auto reads(const std::vector<bool>& needed) const -> std::vector<bool>;
+    private:
+        auto sobel(Layer<Real>& layer, const MaskView<Real>* mask) const -> void;
+        Stencil<Real> _derivative;
+        Stencil<Real> _smooth;
+        std::vector<Real> _multiplier;
+        Real _scale;
+        Real _offset;
+    };
+}
+
+#include "sobelop.hpp"
@@ -0,0 +1,118 @@
+// sobelop.hpp
+// Copyright Laurence Emms 2017
+
+#include <algorithm>
+#include <cstdint>
+
+namespace bluedot {
+    template <typename Real>
+    SobelOperator<Real>::SobelOperator(const std::vector<Real>& multiplier, Real scale, Real offset, bool spherical) :
+        _derivative({static_cast<Real>(-0.5), static_cast<Real>(0.0), static_cast<Real>(0.5)}, spherical),
+        _smooth({static_cast<Real>(0.25), static_cast<Real>(0.5), static_cast<Real>(0.25)}, spherical),
+        _multiplier(multiplier), _scale(scale), _offset(offset)
+    {
+    }
+
+    template <typename Real>
+    auto SobelOperator<Real>::operator()(Layer<Real>& layer) -> bool
+    {
+        if (layer.channels() < 3)
+        {
+            return false;
+        }
+        if (!this->live(1) && !this->live(2))
+        {
+            return true;
+        }
+        sobel(layer, nullptr);
+        return true;
+    }
+
+    template <typename Real>
+    auto SobelOperator<Real>::operator()(Layer<Real>& layer, const MaskView<Real>& mask) -> bool
+    {
+        if (layer.channels() < 3)
+        {
+            return false;
+        }
+        if (!this->live(1) && !this->live(2))
+        {
+            return true;
+        }
+        sobel(layer, &mask);
+        return true;
+    }
+
+    template <typename Real>
+    auto SobelOperator<Real>::sobel(Layer<Real>& layer, const MaskView<Real>* mask) const -> void
+    {
+        const Tiles<Real>* tiles{mask ? &mask->tiles() : nullptr};
+        const size_t width{layer.width()};
+        Layer<Real> scratch{width, layer.height(), 1};
+        Layer<Real> x_gradient{width, layer.height(), 1};
+        Layer<Real> y_gradient{width, layer.height(), 1};
+        ChannelView<Real> alpha{layer, 0};
+        ChannelView<Real> scratch_view{scratch, 0};
+        ChannelView<Real> x_view{x_gradient, 0};
+        ChannelView<Real> y_view{y_gradient, 0};
+
+        // Both Sobel kernels are separable into a central difference and a [1 2 1] smoothing
+        _derivative.horizontal(alpha, scratch_view);
+        _smooth.vertical(scratch_view, x_view);
+        _smooth.horizontal(alpha, scratch_view);
+        _derivative.vertical(scratch_view, y_view);
+
+        Real x_multiplier{_multiplier.size() > 1 ? _multiplier[1] : static_cast<Real>(1.0)};
+        Real y_multiplier{_multiplier.size() > 2 ? _multiplier[2] : static_cast<Real>(1.0)};
+        const int64_t height{static_cast<int64_t>(layer.height())};
+#pragma omp parallel for schedule(static)
+        for (int64_t row = 0; row < height; ++row)
+        {
+            size_t y{static_cast<size_t>(row)};
+            for (size_t begin{0}; begin < width; begin += Tiles<Real>::size)
+            {
+                const Coverage coverage{tiles ? tiles->coverage(begin, y) : Coverage::full};
+                if (coverage == Coverage::none)
+                {
+                    continue;
+                }
+                const size_t end{std::min(width, begin + Tiles<Real>::size)};
+                for (size_t x{begin}; x < end; ++x)
+                {
+                    Real dx{x_gradient(x, y, 0) * _scale * x_multiplier + _offset};
+                    Real dy{y_gradient(x, y, 0) * _scale * y_multiplier + _offset};
+                    if (coverage == Coverage::partial)
+                    {
+                        Real t{(*mask)(x, y)};
+                        layer(x, y, 1) = (static_cast<Real>(1.0) - t) * layer(x, y, 1) + t * dx;
+                        layer(x, y, 2) = (static_cast<Real>(1.0) - t) * layer(x, y, 2) + t * dy;
+                    }
+                    else
+                    {
+                        layer(x, y, 1) = dx;
+                        layer(x, y, 2) = dy;
+                    }
+                }
+            }
+        }
+    }
+
+    template <typename Real>
+    auto SobelOperator<Real>::footprint() const -> Footprint
+    {
+        return Footprint{std::max(_derivative.radius(), _smooth.radius()), _derivative.spherical(), false};
+    }
+
+    template <typename Real>
+    auto SobelOperator<Real>::writes(size_t channels) const -> std::vector<bool>
+    {
+        return channel_range(channels, 1, 3);
+    }
+
+    template <typename Real>
+    auto SobelOperator<Real>::reads(const std::vector<bool>& needed) const -> std::vector<bool>
+    {
+        // The gradient is taken of alpha
+        return channel_range(needed.size(), 0, any_channel(needed) ? 1 : 0);
+    }
+}
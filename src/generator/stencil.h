@@ -0,0 +1,53 @@
+// stencil.h
+// Separable stencil and convolution passes over a single channel
+// Rows are copied into padded buffers whose halos are precomputed once per pass,
+// so the inner loops are branch free and contiguous.
+// In x the halo wraps around when spherical is set and clamps to the edge otherwise.
+// In y the halo always clamps to the poles.
+// Copyright Laurence Emms 2017
+
+#pragma once
+#include <vector>
+#include "layer.h"
+
+namespace bluedot {
+    // A single channel of a layer addressed by (x, y)
+    template <typename Real>
+    class ChannelView {
+    public:
+        ChannelView(Layer<Real>& layer, size_t channel);
+        inline auto operator()(size_t x, size_t y) -> Real&;
+        inline auto operator()(size_t x, size_t y) const -> const Real&;
+        inline auto row(size_t y) const -> Real*;
+        inline auto width() const -> size_t;
+        inline auto height() const -> size_t;
+        inline auto stride() const -> size_t;
+    private:
+        Real* _data;
+        size_t _width;
+        size_t _height;
+        size_t _stride;
+    };
+
+    template <typename Real>
+    class Stencil {
+    public:
+        // taps must have an odd number of entries, centered on the middle tap
+        Stencil(const std::vector<Real>& taps, bool spherical = true);
+        auto radius() const -> size_t;
+        auto spherical() const -> bool;
+        // Convolves each row of source with the taps
+        // source and destination may be the same view
+        auto horizontal(const ChannelView<Real>& source, ChannelView<Real>& destination) const -> void;
+        // Convolves each column of source with the taps
+        // source and destination must not overlap
+        auto vertical(const ChannelView<Real>& source, ChannelView<Real>& destination) const -> void;
+        // Normalized gaussian taps with the given radius
+        static auto gaussian(size_t radius, Real sigma) -> std::vector<Real>;
+    private:
+        std::vector<Real> _taps;
+        bool _spherical;
+    };
+}
+
+#include "stencil.hpp"
@@ -0,0 +1,212 @@
+// stencil.hpp
+// Copyright Laurence Emms 2017
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+
+namespace bluedot {
+    template <typename Real>
+    ChannelView<Real>::ChannelView(Layer<Real>& layer, size_t channel) :
+        _data(&layer(0, 0, channel)), _width(layer.width()), _height(layer.height()), _stride(layer.channels())
+    {
+        assert(channel < layer.channels());
+    }
+
+    template <typename Real>
+    auto ChannelView<Real>::operator()(size_t x, size_t y) -> Real&
+    {
+        return _data[(x + y * _width) * _stride];
+    }
+
+    template <typename Real>
+    auto ChannelView<Real>::operator()(size_t x, size_t y) const -> const Real&
+    {
+        return _data[(x + y * _width) * _stride];
+    }
+
+    template <typename Real>
+    auto ChannelView<Real>::row(size_t y) const -> Real*
+    {
+        return _data + y * _width * _stride;
+    }
+
+    template <typename Real>
+    auto ChannelView<Real>::width() const -> size_t
+    {
+        return _width;
+    }
+
+    template <typename Real>
+    auto ChannelView<Real>::height() const -> size_t
+    {
+        return _height;
+    }
+
+    template <typename Real>
+    auto ChannelView<Real>::stride() const -> size_t
+    {
+        return _stride;
+    }
+
+    template <typename Real>
+    Stencil<Real>::Stencil(const std::vector<Real>& taps, bool spherical) : _taps(taps), _spherical(spherical)
+    {
+        assert(_taps.size() % 2 == 1);
+    }
+
+    template <typename Real>
+    auto Stencil<Real>::radius() const -> size_t
+    {
+        return _taps.size() / 2;
+    }
+
+    template <typename Real>
+    auto Stencil<Real>::spherical() const -> bool
+    {
+        return _spherical;
+    }
+
+    template <typename Real>
+    auto Stencil<Real>::horizontal(const ChannelView<Real>& source, ChannelView<Real>& destination) const -> void
+    {
+        assert(source.width() == destination.width());
+        assert(source.height() == destination.height());
+
+        const size_t width{source.width()};
+        const size_t radius{this->radius()};
+        const size_t taps{_taps.size()};
+        const size_t source_stride{source.stride()};
+        const size_t destination_stride{destination.stride()};
+
+        // Source columns of the left and right halos, shared by every row
+        std::vector<size_t> left_halo(radius);
+        std::vector<size_t> right_halo(radius);
+        for (size_t i{0}; i < radius; ++i)
+        {
+            size_t distance{radius - i};
+            if (_spherical)
+            {
+                left_halo[i] = (width - distance % width) % width;
+                right_halo[i] = i % width;
+            }
+            else
+            {
+                left_halo[i] = 0;
+                right_halo[i] = width - 1;
+            }
+        }
+
+        const int64_t height{static_cast<int64_t>(source.height())};
+#pragma omp parallel
+        {
+            std::vector<Real> padded(width + 2 * radius);
+            std::vector<Real> result(width);
+#pragma omp for schedule(static)
+            for (int64_t y = 0; y < height; ++y)
+            {
+                const Real* in{source.row(static_cast<size_t>(y))};
+                for (size_t i{0}; i < radius; ++i)
+                {
+                    padded[i] = in[left_halo[i] * source_stride];
+                    padded[radius + width + i] = in[right_halo[i] * source_stride];
+                }
+                for (size_t x{0}; x < width; ++x)
+                {
+                    padded[radius + x] = in[x * source_stride];
+                }
+
+                Real* r{result.data()};
+                std::fill(result.begin(), result.end(), static_cast<Real>(0.0));
+                for (size_t k{0}; k < taps; ++k)
+                {
+                    const Real t{_taps[k]};
+                    const Real* p{padded.data() + k};
+#pragma omp simd
+                    for (size_t x = 0; x < width; ++x)
+                    {
+                        r[x] += t * p[x];
+                    }
+                }
+
+                Real* out{destination.row(static_cast<size_t>(y))};
+                for (size_t x{0}; x < width; ++x)
+                {
+                    out[x * destination_stride] = r[x];
+                }
+            }
+        }
+    }
+
+    template <typename Real>
+    auto Stencil<Real>::vertical(const ChannelView<Real>& source, ChannelView<Real>& destination) const -> void
+    {
+        assert(source.width() == destination.width());
+        assert(source.height() == destination.height());
+        assert(source.row(0) != destination.row(0));
+
+        const size_t width{source.width()};
+        const int64_t radius{static_cast<int64_t>(this->radius())};
+        const size_t taps{_taps.size()};
+        const size_t source_stride{source.stride()};
+        const size_t destination_stride{destination.stride()};
+
+        const int64_t height{static_cast<int64_t>(source.height())};
+#pragma omp parallel
+        {
+            std::vector<Real> gathered(source_stride == 1 ? 0 : width);
+            std::vector<Real> result(width);
+#pragma omp for schedule(static)
+            for (int64_t y = 0; y < height; ++y)
+            {
+                Real* r{result.data()};
+                std::fill(result.begin(), result.end(), static_cast<Real>(0.0));
+                for (size_t k{0}; k < taps; ++k)
+                {
+                    int64_t sy{std::min(height - 1, std::max(static_cast<int64_t>(0), y + static_cast<int64_t>(k) - radius))};
+                    const Real* p{source.row(static_cast<size_t>(sy))};
+                    if (source_stride != 1)
+                    {
+                        for (size_t x{0}; x < width; ++x)
+                        {
+                            gathered[x] = p[x * source_stride];
+                        }
+                        p = gathered.data();
+                    }
+                    const Real t{_taps[k]};
+#pragma omp simd
+                    for (size_t x = 0; x < width; ++x)
+                    {
+                        r[x] += t * p[x];
+                    }
+                }
+
+                Real* out{destination.row(static_cast<size_t>(y))};
+                for (size_t x{0}; x < width; ++x)
+                {
+                    out[x * destination_stride] = r[x];
+                }
+            }
+        }
+    }
+
+    template <typename Real>
+    auto Stencil<Real>::gaussian(size_t radius, Real sigma) -> std::vector<Real>
+    {
+        assert(sigma > static_cast<Real>(0.0));
+        std::vector<Real> taps(2 * radius + 1);
+        Real sum{static_cast<Real>(0.0)};
+        for (size_t k{0}; k < taps.size(); ++k)
+        {
+            Real d{static_cast<Real>(k) - static_cast<Real>(radius)};
+            taps[k] = std::exp(-d * d / (static_cast<Real>(2.0) * sigma * sigma));
+            sum += taps[k];
+        }
+        for (Real& t : taps)
+        {
+            t /= sum;
+        }
+        return taps;
+    }
+}
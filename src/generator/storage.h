@@ -0,0 +1,42 @@
+// storage.h
+// Samples held by one or more layers
+// Layers share samples until one of them is written, which it may only do in place once no other layer holds them.
+// Sweep points hold the same samples on different threads, so the check must also order every access the other holders
+// made before letting go ahead of the writes that follow. std::shared_ptr::use_count is a relaxed load that orders nothing,
+// so holders are counted here instead: letting go is a release, and finding no other holder is an acquire.
+// Copyright Laurence Emms 2017
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include "allocator.h"
+
+namespace bluedot {
+    template <typename Real>
+    class Storage {
+    public:
+        Storage() = default;
+        // Takes ownership of the samples, which the deallocator frees once no layer holds them
+        Storage(Real* samples, Deallocator deallocator);
+        Storage(const Storage& storage);
+        Storage(Storage&& storage) noexcept;
+        ~Storage();
+        auto operator=(const Storage& storage) -> Storage&;
+        auto operator=(Storage&& storage) noexcept -> Storage&;
+        inline auto get() const -> Real*;
+        inline explicit operator bool() const;
+        // Whether other holders share the samples; once it returns false their accesses happen before the caller's
+        inline auto shared() const -> bool;
+        // Lets go of the samples, freeing them if no other holder is left
+        auto reset() -> void;
+    private:
+        struct Block {
+            std::unique_ptr<Real[], Deallocator> samples;
+            std::atomic<size_t> holders;
+        };
+        Block* _block{nullptr};
+    };
+}
+
+#include "storage.hpp"
\ No newline at end of file
@@ -0,0 +1,81 @@
+// storage.hpp
+// Copyright Laurence Emms 2017
+
+#include <utility>
+
+namespace bluedot {
+    template <typename Real>
+    Storage<Real>::Storage(Real* samples, Deallocator deallocator) :
+        _block(samples ? new Block{std::unique_ptr<Real[], Deallocator>{samples, deallocator}, {1}} : nullptr)
+    {
+    }
+
+    template <typename Real>
+    Storage<Real>::Storage(const Storage<Real>& storage) : _block(storage._block)
+    {
+        // A new holder needs no ordering, as it is made from one that already holds the samples
+        if (_block)
+            _block->holders.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    template <typename Real>
+    Storage<Real>::Storage(Storage<Real>&& storage) noexcept : _block(storage._block)
+    {
+        storage._block = nullptr;
+    }
+
+    template <typename Real>
+    Storage<Real>::~Storage()
+    {
+        reset();
+    }
+
+    template <typename Real>
+    auto Storage<Real>::operator=(const Storage<Real>& storage) -> Storage<Real>&
+    {
+        Storage<Real> copy{storage};
+        *this = std::move(copy);
+        return *this;
+    }
+
+    template <typename Real>
+    auto Storage<Real>::operator=(Storage<Real>&& storage) noexcept -> Storage<Real>&
+    {
+        if (this != &storage)
+        {
+            reset();
+            _block = storage._block;
+            storage._block = nullptr;
+        }
+        return *this;
+    }
+
+    template <typename Real>
+    auto Storage<Real>::get() const -> Real*
+    {
+        return _block ? _block->samples.get() : nullptr;
+    }
+
+    template <typename Real>
+    Storage<Real>::operator bool() const
+    {
+        return _block != nullptr;
+    }
+
+    template <typename Real>
+    auto Storage<Real>::shared() const -> bool
+    {
+        return _block && _block->holders.load(std::memory_order_acquire) > 1;
+    }
+
+    template <typename Real>
+    auto Storage<Real>::reset() -> void
+    {
+        if (!_block)
+            return;
+        // The last holder to let go acquires the accesses of the others before freeing the samples
+        if (_block->holders.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            delete _block;
+        _block = nullptr;
+    }
+}
@@ -1,5 +1,6 @@
 // swapop.h
 // Layer swap operation
+// Without a mask the layers exchange their storage, which takes constant time
 // Copyright Laurence Emms 2017
 
 #pragma once
@@ -11,7 +12,9 @@ namespace bluedot {
     class SwapOperator : public BinaryOperator<Real> {
     public:
         virtual auto operator()(Layer<Real>& layer0, Layer<Real>& layer1) -> bool;
-        virtual auto operator()(Layer<Real>& layer0, Layer<Real>& layer1, Layer<Real>& mask) -> bool;
+        virtual auto operator()(Layer<Real>& layer0, Layer<Real>& layer1, const MaskView<Real>& mask) -> bool;
+        virtual auto writes_layer1() const -> bool;
+        virtual auto moves_storage() const -> bool;
     };
 }
 
@@ -1,6 +1,10 @@
 // swapop.hpp
 // Copyright Laurence Emms 2017
 
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
 namespace bluedot {
     template <typename Real>
     auto SwapOperator<Real>::operator()(Layer<Real>& layer0, Layer<Real>& layer1) -> bool
@@ -10,47 +14,65 @@ namespace bluedot {
         if (layer0.channels() != layer1.channels())
             return false;
 
-        int num_samples = static_cast<int>(layer0.width() * layer0.height());
-#pragma omp parallel for schedule(guided)
-        for (int s{0}; s < num_samples; ++s)
-        {
-            size_t x = static_cast<size_t>(s) % layer0.width();
-            size_t y = static_cast<size_t>(s) / layer0.width();
-            for (size_t c{0}; c < layer0.channels(); ++c)
-            {
-                Real value{layer0(x, y, c)};
-                layer0(x, y, c) = layer1(x, y, c);
-                layer1(x, y, c) = value;
-            }
-        }
-
-        return true;
+        return layer0.swap(layer1);
     }
 
     template <typename Real>
-    auto SwapOperator<Real>::operator()(Layer<Real>& layer0, Layer<Real>& layer1, Layer<Real>& mask) -> bool
+    auto SwapOperator<Real>::operator()(Layer<Real>& layer0, Layer<Real>& layer1, const MaskView<Real>& mask) -> bool
     {
-        assert(mask.channels() > 0);
         assert(layer0.width() == layer1.width());
         assert(layer0.height() == layer1.height());
         if (layer0.channels() != layer1.channels())
             return false;
 
-        int num_samples = static_cast<int>(layer0.width() * layer0.height());
-#pragma omp parallel for schedule(guided)
-        for (int s{0}; s < num_samples; ++s)
+        const Tiles<Real>& tiles{mask.tiles()};
+        const size_t width{layer0.width()};
+        const int64_t height{static_cast<int64_t>(layer0.height())};
+#pragma omp parallel for schedule(static)
+        for (int64_t row = 0; row < height; ++row)
         {
-            size_t x = static_cast<size_t>(s) % layer0.width();
-            size_t y = static_cast<size_t>(s) / layer0.width();
-            for (size_t c{0}; c < layer0.channels(); ++c)
+            size_t y{static_cast<size_t>(row)};
+            for (size_t begin{0}; begin < width; begin += Tiles<Real>::size)
             {
-                Real t{mask(x, y, 0)};
-                Real value{layer0(x, y, c)};
-                layer0(x, y, c) = (static_cast<Real>(1.0) - t) * layer0(x, y, c) + t * layer1(x, y, c);
-                layer1(x, y, c) = (static_cast<Real>(1.0) - t) * layer1(x, y, c) + t * value;
+                const Coverage coverage{tiles.coverage(begin, y)};
+                if (coverage == Coverage::none)
+                {
+                    continue;
+                }
+                const size_t end{std::min(width, begin + Tiles<Real>::size)};
+                for (size_t x{begin}; x < end; ++x)
+                {
+                    for (size_t c{0}; c < layer0.channels(); ++c)
+                    {
+                        Real value{layer0(x, y, c)};
+                        if (coverage == Coverage::full)
+                        {
+                            layer0(x, y, c) = layer1(x, y, c);
+                            layer1(x, y, c) = value;
+                        }
+                        else
+                        {
+                            Real t{mask(x, y)};
+                            layer0(x, y, c) = (static_cast<Real>(1.0) - t) * layer0(x, y, c) + t * layer1(x, y, c);
+                            layer1(x, y, c) = (static_cast<Real>(1.0) - t) * layer1(x, y, c) + t * value;
+                        }
+                    }
+                }
             }
         }
 
         return true;
     }
+
+    template <typename Real>
+    auto SwapOperator<Real>::writes_layer1() const -> bool
+    {
+        return true;
+    }
+
+    template <typename Real>
+    auto SwapOperator<Real>::moves_storage() const -> bool
+    {
+        return true;
+    }
 }
@@ -0,0 +1,39 @@
+// tiles.h
+// Minimum and maximum of channel 0 over square tiles of a layer or mask
+// Masked operators use the summary of the mask to skip tiles it leaves untouched,
+// and to write without blending where it fully selects the operator's result.
+// Copyright Laurence Emms 2017
+
+#pragma once
+#include <cstddef>
+#include <vector>
+
+namespace bluedot {
+    // How channel 0 of a tile weights an operator's result against the existing samples
+    enum class Coverage {
+        none,
+        partial,
+        full
+    };
+
+    template <typename Real>
+    class Tiles {
+    public:
+        static constexpr size_t size{64};
+        // sample(x, y) gives the value of channel 0 at (x, y)
+        template <typename Sample>
+        Tiles(size_t width, size_t height, Sample sample);
+        // Extremes of channel 0 over the tile containing (x, y)
+        inline auto minimum(size_t x, size_t y) const -> Real;
+        inline auto maximum(size_t x, size_t y) const -> Real;
+        // Coverage of the tile containing (x, y) when channel 0 is a blend weight
+        // Clamped weights are limited to [0, 1] before blending, as alpha is
+        inline auto coverage(size_t x, size_t y, bool clamped = false) const -> Coverage;
+    private:
+        size_t _columns;
+        std::vector<Real> _minimum;
+        std::vector<Real> _maximum;
+    };
+}
+
+#include "tiles.hpp"
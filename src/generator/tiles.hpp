@@ -0,0 +1,74 @@
+// tiles.hpp
+// Copyright Laurence Emms 2017
+
+#include <algorithm>
+#include <cstdint>
+
+namespace bluedot {
+    template <typename Real>
+    constexpr size_t Tiles<Real>::size;
+
+    template <typename Real>
+    template <typename Sample>
+    Tiles<Real>::Tiles(size_t width, size_t height, Sample sample) :
+        _columns((width + size - 1) / size),
+        _minimum(_columns * ((height + size - 1) / size)),
+        _maximum(_minimum.size())
+    {
+        const int64_t rows{static_cast<int64_t>((height + size - 1) / size)};
+#pragma omp parallel for schedule(static)
+        for (int64_t row = 0; row < rows; ++row)
+        {
+            const size_t ty{static_cast<size_t>(row)};
+            const size_t y_end{std::min(height, (ty + 1) * size)};
+            for (size_t tx{0}; tx < _columns; ++tx)
+            {
+                const size_t x_end{std::min(width, (tx + 1) * size)};
+                Real minimum{sample(tx * size, ty * size)};
+                Real maximum{minimum};
+                for (size_t y{ty * size}; y < y_end; ++y)
+                {
+                    for (size_t x{tx * size}; x < x_end; ++x)
+                    {
+                        const Real value{sample(x, y)};
+                        minimum = std::min(minimum, value);
+                        maximum = std::max(maximum, value);
+                    }
+                }
+                _minimum[tx + ty * _columns] = minimum;
+                _maximum[tx + ty * _columns] = maximum;
+            }
+        }
+    }
+
+    template <typename Real>
+    auto Tiles<Real>::minimum(size_t x, size_t y) const -> Real
+    {
+        return _minimum[x / size + (y / size) * _columns];
+    }
+
+    template <typename Real>
+    auto Tiles<Real>::maximum(size_t x, size_t y) const -> Real
+    {
+        return _maximum[x / size + (y / size) * _columns];
+    }
+
+    template <typename Real>
+    auto Tiles<Real>::coverage(size_t x, size_t y, bool clamped) const -> Coverage
+    {
+        const Real minimum{this->minimum(x, y)};
+        const Real maximum{this->maximum(x, y)};
+        const Real zero{static_cast<Real>(0.0)};
+        const Real one{static_cast<Real>(1.0)};
+        // Unclamped weights must be exactly 0 or 1 for skipping or overwriting to match the blend
+        if (clamped ? maximum <= zero : (minimum == zero && maximum == zero))
+        {
+            return Coverage::none;
+        }
+        if (clamped ? minimum >= one : (minimum == one && maximum == one))
+        {
+            return Coverage::full;
+        }
+        return Coverage::partial;
+    }
+}
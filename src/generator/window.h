@@ -0,0 +1,30 @@
+// window.h
+// Placement of a layer within a larger map, so that a window of the map can be rendered on its own
+// Copyright Laurence Emms 2017
+
+#pragma once
+#include <cstddef>
+
+namespace bluedot {
+    // Layer row j is map row y + j, and layer column i is map column (x + i) % map_width,
+    // so a window may wrap around the seam of a spherical map.
+    // A map size of zero means the layer is the whole map.
+    struct Window {
+        size_t x;
+        size_t y;
+        size_t map_width;
+        size_t map_height;
+
+        // The window with its map size filled in, for a layer of the given size
+        inline auto resolve(size_t width, size_t height) const -> Window
+        {
+            return map_width == 0 ? Window{0, 0, width, height} : *this;
+        }
+
+        // Layer column of a map column, which is at least the layer width outside the window
+        inline auto column(size_t map_x) const -> size_t
+        {
+            return (map_x + map_width - x % map_width) % map_width;
+        }
+    };
+}